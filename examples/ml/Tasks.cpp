@@ -20,6 +20,8 @@
 #include "Utils.h"
 
 #define READ_AHEAD (3)
+// longest time the PS waits for a gradient in a single request
+#define GRADIENT_WATCH_TIMEOUT_MS (1000)
 
 void LogisticTask::run(const Configuration& config, int worker) {
     std::cout << "[WORKER] "
@@ -79,11 +81,13 @@ void LogisticTask::run(const Configuration& config, int worker) {
     int labels_id  = 0;
     int gradient_id = GRADIENT_BASE + worker;
     uint64_t version = 0;
+    // The model is only sent again once the PS task stores a new one
+    LRModel model(MODEL_GRAD_SIZE);
+    uint64_t model_version = 0;
     while (1) {
         // maybe we can wait a few iterations to get the model
         std::shared_ptr<double> samples;
         std::shared_ptr<double> labels;
-        LRModel model(MODEL_GRAD_SIZE);
         try {
 #ifdef DEBUG
             std::cout << "[WORKER] "
@@ -91,7 +95,7 @@ void LogisticTask::run(const Configuration& config, int worker) {
                 << MODEL_BASE
                 << "\n";
 #endif
-            model = model_store.get(MODEL_BASE);
+            model_store.get_if_newer(MODEL_BASE, &model_version, &model);
 
 #ifdef DEBUG
             std::cout << "[WORKER] "
@@ -292,41 +296,38 @@ void PSTask::run(const Configuration& config) {
     std::vector<unsigned int> gradientVersions;
     gradientVersions.resize(10);
 
-    bool first_time = true;
+    // version in the store of the last gradient read from each worker
+    std::vector<cirrus::ObjectID> gradient_oids;
+    std::vector<uint64_t> store_versions(nworkers, 0);
+    for (int worker = 0; worker < static_cast<int>(nworkers); ++worker) {
+        int gradient_id = GRADIENT_BASE + worker;
+        gradient_oids.push_back(GRADIENT_BASE + gradient_id);
+    }
 
     while (1) {
-        // for every worker, check for a new gradient computed
-        // if there is a new gradient, get it and update the model
+        // wait until a worker stores a new gradient
+        // once there is a new gradient, get it and update the model
         // once model is updated publish it
+        std::vector<bool> written = gradient_store.watch(gradient_oids,
+                store_versions, GRADIENT_WATCH_TIMEOUT_MS);
         for (int worker = 0; worker < static_cast<int>(nworkers); ++worker) {
-            int gradient_id = GRADIENT_BASE + worker;
+            if (!written[worker]) {
+                continue;
+            }
 #ifdef DEBUG
             std::cout << "[PS] "
-                << "PS task checking gradient id: "
-                << gradient_id
+                << "PS task getting gradient id: "
+                << gradient_oids[worker]
                 << std::endl;
 #endif
 
             // get gradient from store
             LRGradient gradient(MODEL_GRAD_SIZE);
-            try {
-                gradient = std::move(
-                        gradient_store.get(GRADIENT_BASE + gradient_id));
-            } catch(const cirrus::NoSuchIDException& e) {
-                if (!first_time) {
-                    std::cout
-                        << "PS task not able to get gradient: "
-                        << std::to_string(GRADIENT_BASE + gradient_id)
-                        << std::endl;
-                }
-                // this happens because the worker task
-                // has not uploaded the gradient yet
-                worker--;
+            if (!gradient_store.get_if_newer(gradient_oids[worker],
+                        &store_versions[worker], &gradient)) {
                 continue;
             }
 
-            first_time = false;
-
 #ifdef DEBUG
             std::cout << "[PS] "
                 << "PS task received gradient with #version: "
@@ -0,0 +1,46 @@
+#include "authentication/KeyAuthenticator.h"
+
+namespace cirrus {
+
+/**
+  * Registers an application, replacing its key if it was registered.
+  * @param app_id the application
+  * @param key the key clients present to act as the application. No client
+  * can act as an application registered with an empty key
+  */
+void KeyAuthenticator::addApplication(const AppId& app_id,
+        const std::string& key) {
+    keys_[app_id] = key;
+}
+
+/**
+  * Tells whether an application is registered.
+  * @param app_id the application
+  * @return true if the application was registered
+  */
+bool KeyAuthenticator::allowApplication(const AppId& app_id) {
+    return keys_.find(app_id) != keys_.end();
+}
+
+/**
+  * Checks the key a client presents for an application. The time taken
+  * does not depend on how much of the key matches.
+  * @param app_id the application
+  * @param key the key presented
+  * @return true if the application is registered with that key
+  */
+bool KeyAuthenticator::checkKey(const AppId& app_id,
+        const std::string& key) const {
+    auto it = keys_.find(app_id);
+    if (it == keys_.end() || it->second.empty()) {
+        return false;
+    }
+    const std::string& expected = it->second;
+    unsigned char diff = expected.size() != key.size();
+    for (size_t i = 0; i < key.size(); ++i) {
+        diff |= key[i] ^ expected[i % expected.size()];
+    }
+    return diff == 0;
+}
+
+}  // namespace cirrus
@@ -0,0 +1,31 @@
+#ifndef SRC_AUTHENTICATION_KEYAUTHENTICATOR_H_
+#define SRC_AUTHENTICATION_KEYAUTHENTICATOR_H_
+
+#include <string>
+#include <unordered_map>
+#include "authentication/Authenticator.h"
+
+namespace cirrus {
+
+/**
+  * Authenticator of the applications sharing a server. Every application
+  * is registered with a secret key, and clients have to present the key to
+  * act as the application. Applications are registered before the server
+  * starts, after that the authenticator is only read.
+  */
+class KeyAuthenticator : public Authenticator {
+ public:
+    void addApplication(const AppId& app_id, const std::string& key);
+
+    bool allowApplication(const AppId& app_id) override;
+
+    bool checkKey(const AppId& app_id, const std::string& key) const;
+
+ private:
+    /** Key of each application registered. */
+    std::unordered_map<AppId, std::string> keys_;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_AUTHENTICATION_KEYAUTHENTICATOR_H_
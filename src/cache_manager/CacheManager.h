@@ -6,6 +6,7 @@
 #include <functional>
 #include <algorithm>
 #include <iostream>
+#include <memory>
 
 
 #include "object_store/ObjectStore.h"
@@ -13,6 +14,7 @@
 #include "cache_manager/PrefetchPolicy.h"
 #include "object_store/FullBladeObjectStore.h"
 #include "common/Exception.h"
+#include "common/Synchronization.h"
 #include "utils/logging.h"
 
 namespace cirrus {
@@ -50,6 +52,8 @@ class CacheManager {
             cirrus::PrefetchPolicy<T> *policy = nullptr);
     void setMode(PrefetchMode mode, ObjectID first, ObjectID last,
             uint64_t read_ahead);
+    void subscribe(ObjectID first, ObjectID last);
+    void unsubscribe(ObjectID first, ObjectID last);
 
  private:
     /**
@@ -135,6 +139,16 @@ class CacheManager {
 
     void evict_vector(const std::vector<ObjectID>& to_remove);
     void evict(ObjectID oid);
+    void drop_invalidated();
+
+    /**
+     * Ids of the objects other clients changed, queued by the thread of the
+     * client and dropped from the cache on the next operation.
+     */
+    struct Invalidations {
+        cirrus::SpinLock lock;
+        std::vector<ObjectID> oids;
+    };
 
     /**
      * Struct that is stored within the cache. Contains a copy of an object
@@ -160,6 +174,16 @@ class CacheManager {
      */
     cirrus::ObjectStore<T> *store;
 
+    /** The same store, for the operations only it has. */
+    cirrus::ostore::FullBladeObjectStoreTempl<T> *blade_store;
+
+    /**
+     * Invalidations not yet applied. Shared with the handler of the client,
+     * which may outlive the cache.
+     */
+    std::shared_ptr<Invalidations> invalidations =
+        std::make_shared<Invalidations>();
+
     /**
      * The map that serves as the actual cache. Maps ObjectIDs to cache
      * entries.
@@ -216,6 +240,7 @@ CacheManager<T>::CacheManager(
                            cirrus::EvictionPolicy *eviction_policy,
                            uint64_t cache_size, bool defer_writes) :
                            store(store),
+                           blade_store(store),
                            max_size(cache_size),
                            eviction_policy(eviction_policy),
                            defer_writes(defer_writes) {
@@ -236,6 +261,7 @@ CacheManager<T>::CacheManager(
   */
 template<class T>
 T CacheManager<T>::get(ObjectID oid) {
+    drop_invalidated();
     std::vector<ObjectID> to_remove = eviction_policy->get(oid);
     evict_vector(to_remove);
     // check if entry exists for the oid in cache
@@ -298,6 +324,7 @@ T CacheManager<T>::get(ObjectID oid) {
   */
 template<class T>
 void CacheManager<T>::put(ObjectID oid, const T& obj) {
+    drop_invalidated();
     std::vector<ObjectID> to_remove = eviction_policy->put(oid);
     evict_vector(to_remove);
 
@@ -377,6 +404,7 @@ void CacheManager<T>::put_bulk(ObjectID start, ObjectID last, T* data) {
   */
 template<class T>
 void CacheManager<T>::prefetch(ObjectID oid) {
+    drop_invalidated();
     std::vector<ObjectID> to_remove = eviction_policy->prefetch(oid);
     evict_vector(to_remove);
     LOG<INFO>("Prefetching oid: ", oid);
@@ -481,6 +509,68 @@ void CacheManager<T>::evict_vector(const std::vector<ObjectID>& to_remove) {
     }
 }
 
+/**
+ * Drops from the cache the objects other clients changed since the last
+ * operation. Objects written locally and not yet written to the store are
+ * kept, as the local write is the last one.
+ */
+template<class T>
+void CacheManager<T>::drop_invalidated() {
+    std::vector<ObjectID> oids;
+    invalidations->lock.wait();
+    oids.swap(invalidations->oids);
+    invalidations->lock.signal();
+
+    for (auto const& oid : oids) {
+        auto it = cache.find(oid);
+        if (it == cache.end() || (defer_writes && it->second.dirty)) {
+            continue;
+        }
+        LOG<INFO>("Dropping oid changed by another client: ", oid);
+        cache.erase(it);
+        eviction_policy->remove(oid);
+    }
+}
+
+/**
+ * Keeps the cached objects with ids first to last coherent with the
+ * store. Objects other clients write or remove are dropped from the cache
+ * and fetched again on their next access, so shared objects can be
+ * cached. Uses the subscriptions of the store, the cache must be the only
+ * user of them.
+ * @param first the first ObjectID of the range.
+ * @param last the last ObjectID of the range.
+ */
+template<class T>
+void CacheManager<T>::subscribe(ObjectID first, ObjectID last) {
+    if (first > last) {
+        throw cirrus::Exception("Last oid must be >= first");
+    }
+    std::weak_ptr<Invalidations> queue = invalidations;
+    bool subscribed = blade_store->subscribe(first, last,
+            [queue](ObjectID oid, uint64_t /* version */) {
+                auto pending = queue.lock();
+                if (pending) {
+                    pending->lock.wait();
+                    pending->oids.push_back(oid);
+                    pending->lock.signal();
+                }
+            });
+    if (!subscribed) {
+        throw cirrus::Exception("Error subscribing to the store.");
+    }
+}
+
+/**
+ * Stops keeping the cached objects with ids first to last coherent.
+ * @param first the first ObjectID of the range.
+ * @param last the last ObjectID of the range.
+ */
+template<class T>
+void CacheManager<T>::unsubscribe(ObjectID first, ObjectID last) {
+    blade_store->unsubscribe(first, last);
+}
+
 /**
  * Sets the prefetching mode for the cache. The default is no prefetching.
  * Note: Ordered prefetching can only be used if all objectIDs are sequential.
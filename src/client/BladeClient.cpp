@@ -1,7 +1,10 @@
 #include "client/BladeClient.h"
 
+#include <cstring>
 #include <string>
 #include <memory>
+#include <numeric>
+#include <vector>
 
 #include "common/Synchronization.h"
 #include "common/Exception.h"
@@ -89,6 +92,30 @@ bool BladeClient::ClientFuture::get() {
         throw cirrus::NoSuchIDException("Call to get was made for id that "
                                         "did not exist on server.");
       }
+      case cirrus::ErrorCodes::kOutOfRangeException: {
+        throw cirrus::OutOfRangeException("Partial read or write past the "
+                                          "end of the object.");
+      }
+      case cirrus::ErrorCodes::kNoSuchFunctionException: {
+        throw cirrus::NoSuchFunctionException("Call to a function that no "
+                                              "plugin of the server defines.");
+      }
+      case cirrus::ErrorCodes::kQuotaExceededException: {
+        throw cirrus::QuotaExceededException("Memory quota of the "
+                                             "application exceeded.");
+      }
+      case cirrus::ErrorCodes::kRateLimitedException: {
+        throw cirrus::RateLimitedException("Request rate or bandwidth of the "
+                                           "application exceeded.");
+      }
+      case cirrus::ErrorCodes::kInvalidArgumentException: {
+        throw cirrus::InvalidArgumentException("Request rejected as "
+                                               "malformed by the server.");
+      }
+      case cirrus::ErrorCodes::kAuthenticationException: {
+        throw cirrus::AuthenticationException("Application or key not "
+                                              "accepted by the server.");
+      }
       default: {
         throw cirrus::Exception("Unrecognized error code during get().");
       }
@@ -111,5 +138,202 @@ BladeClient::ClientFuture::getDataPair() {
     return std::make_pair(fd->data_ptr, fd->data_size);
 }
 
+/**
+ * Returns whether each object of a partial bulk operation was read or
+ * written, in the order of the ids given. Waits for the result and throws
+ * like get() on errors.
+ */
+const std::vector<bool>& BladeClient::ClientFuture::getStatuses() {
+    get();
+    return fd->statuses;
+}
+
+/**
+ * Returns the version of the object read or written, as given by the
+ * server. Versions of an object grow with every write. Waits for the
+ * result and throws like get() on errors.
+ */
+uint64_t BladeClient::ClientFuture::getVersion() {
+    get();
+    return fd->version;
+}
+
+/**
+ * Returns whether a conditional read found the object newer than the
+ * version given, in which case the object was read. Waits for the result
+ * and throws like get() on errors.
+ */
+bool BladeClient::ClientFuture::isModified() {
+    get();
+    return fd->modified;
+}
+
+/**
+ * Returns the versions of the objects of a watch, in the order of the ids
+ * given, 0 for objects that do not exist. Waits for the result and throws
+ * like get() on errors.
+ */
+const std::vector<uint64_t>& BladeClient::ClientFuture::getVersions() {
+    get();
+    return fd->versions;
+}
+
+/**
+ * Returns the cache statistics of the server. Waits for the result and
+ * throws like get() on errors.
+ * @return the statistics.
+ */
+const CacheStats& BladeClient::ClientFuture::getCacheStats() {
+    get();
+    return fd->cache_stats;
+}
+
+/**
+ * Returns the memory statistics of the server. Waits for the result and
+ * throws like get() on errors.
+ * @return the statistics.
+ */
+const MemoryStats& BladeClient::ClientFuture::getMemoryStats() {
+    get();
+    return fd->memory_stats;
+}
+
+/**
+ * Lists the ids of a range.
+ * @param first the first id of the range.
+ * @param last the last id of the range.
+ * @return the ids, in order.
+ */
+static std::vector<ObjectID> range_ids(ObjectID first, ObjectID last) {
+    if (last < first) {
+        throw cirrus::Exception("Last objectID of a range must be greater "
+            "than first objectID.");
+    }
+    std::vector<ObjectID> oids(last - first + 1);
+    std::iota(oids.begin(), oids.end(), first);
+    return oids;
+}
+
+/**
+ * Asynchronously reads the objects with ids first to last. The data is
+ * in the format of read_async_bulk().
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture BladeClient::read_async_range(ObjectID first,
+        ObjectID last) {
+    return read_async_bulk(range_ids(first, last));
+}
+
+/**
+ * Reads the objects with ids first to last.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @return An std pair containing a shared pointer to the buffer that the
+ * serialized objects read from the server reside in as well as the size of
+ * the buffer.
+ */
+std::pair<std::shared_ptr<const char>, unsigned int>
+BladeClient::read_sync_range(ObjectID first, ObjectID last) {
+    return read_async_range(first, last).getDataPair();
+}
+
+/**
+ * Reads part of an object.
+ * @param oid the id of the object.
+ * @param offset the offset of the first byte read.
+ * @param length the number of bytes read.
+ * @return An std pair containing a shared pointer to the bytes read as well
+ * as their number.
+ */
+std::pair<std::shared_ptr<const char>, unsigned int>
+BladeClient::read_sync_partial(ObjectID oid, uint64_t offset,
+        uint64_t length) {
+    return read_async_partial(oid, offset, length).getDataPair();
+}
+
+/**
+ * Overwrites part of an object. The object keeps its size.
+ * @param oid the id of the object.
+ * @param offset the offset of the first byte overwritten.
+ * @param w the bytes written.
+ * @return True if the bytes were written.
+ */
+bool BladeClient::write_sync_partial(ObjectID oid, uint64_t offset,
+        const WriteUnit& w) {
+    return write_async_partial(oid, offset, w).get();
+}
+
+/**
+ * Atomically adds a value to a 64 bit counter. Counters that do not exist
+ * start at 0.
+ * @param oid the id of the counter.
+ * @param value the value added.
+ * @return the value of the counter before the addition.
+ */
+uint64_t BladeClient::fetch_add(ObjectID oid, uint64_t value) {
+    auto future = fetch_add_async(oid, std::vector<uint64_t>{value}, true);
+    auto previous = future.getDataPair();
+    uint64_t old_value = 0;
+    if (previous.second == sizeof(old_value)) {
+        std::memcpy(&old_value, previous.first.get(), sizeof(old_value));
+    }
+    return old_value;
+}
+
+/**
+ * Runs a function of a server plugin on the objects with ids first to last
+ * that exist, and returns its result.
+ * @param function the name of the function.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @param args the arguments of the function.
+ * @return the result of the function.
+ */
+std::string BladeClient::call_sync(const std::string& function,
+        ObjectID first, ObjectID last, const std::string& args) {
+    auto result = call_async(function, first, last, args).getDataPair();
+    return std::string(result.first.get(), result.second);
+}
+
+/**
+ * Asynchronously writes objects under ids first to last.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @param w the objects, one per id of the range.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture BladeClient::write_async_range(ObjectID first,
+        ObjectID last, const WriteUnits& w) {
+    return write_async_bulk(range_ids(first, last), w);
+}
+
+/**
+ * Writes objects under ids first to last.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @param w the objects, one per id of the range.
+ * @return True if all the objects were successfully written.
+ */
+bool BladeClient::write_sync_range(ObjectID first, ObjectID last,
+        const WriteUnits& w) {
+    return write_async_range(first, last, w).get();
+}
+
+/**
+ * Removes the objects with ids first to last. Ids without an object are
+ * skipped.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @return True if the range was processed.
+ */
+bool BladeClient::remove_range(ObjectID first, ObjectID last) {
+    for (const auto& oid : range_ids(first, last)) {
+        remove(oid);
+    }
+    return true;
+}
+
 
 }  // namespace cirrus
@@ -1,6 +1,7 @@
 #ifndef SRC_CLIENT_BLADECLIENT_H_
 #define SRC_CLIENT_BLADECLIENT_H_
 
+#include <functional>
 #include <string>
 #include <memory>
 #include <utility>
@@ -9,12 +10,29 @@
 #include "common/Serializer.h"
 #include "common/Synchronization.h"
 #include "common/Exception.h"
+#include "common/AllocatorMessage.h"
 #include "utils/Log.h"
 
 namespace cirrus {
 
 using ObjectID = uint64_t;
 
+/** Activity of a server running as a cache, since it started. */
+struct CacheStats {
+    uint64_t hits = 0;           //< reads of objects found
+    uint64_t misses = 0;         //< reads of objects not found
+    uint64_t evictions = 0;      //< objects evicted
+    uint64_t evicted_bytes = 0;  //< bytes of the objects evicted
+};
+
+/** Memory the backend of a server takes for the objects. */
+struct MemoryStats {
+    bool supported = false;        //< whether the backend tracks it
+    uint64_t bytes_used = 0;       //< bytes taken from the system
+    uint64_t bytes_requested = 0;  //< bytes holding the objects
+    double fragmentation = 0;      //< fraction of bytes_used not holding them
+};
+
 struct FutureData {
     FutureData(
             bool result = false,
@@ -35,6 +53,21 @@ struct FutureData {
      std::shared_ptr<const char> data_ptr;
      /** Size of the memory block for a read. */
      uint64_t data_size;
+     /**
+       * For partial bulk operations, whether each object was read or
+       * written.
+       */
+     std::vector<bool> statuses;
+     /** Version of the object read or written, 0 if unknown. */
+     uint64_t version = 0;
+     /** For conditional reads, whether the object was newer and sent. */
+     bool modified = true;
+     /** For watches, the version of every object watched. */
+     std::vector<uint64_t> versions;
+     /** For cache statistics requests, the statistics of the server. */
+     CacheStats cache_stats;
+     /** For memory statistics requests, the statistics of the server. */
+     MemoryStats memory_stats;
 };
 
 /**
@@ -55,15 +88,47 @@ class BladeClient {
 
         std::pair<std::shared_ptr<const char>, unsigned int> getDataPair();
 
+        const std::vector<bool>& getStatuses();
+
+        uint64_t getVersion();
+
+        bool isModified();
+
+        const std::vector<uint64_t>& getVersions();
+
+        const CacheStats& getCacheStats();
+
+        const MemoryStats& getMemoryStats();
+
      protected:
          std::shared_ptr<FutureData> fd;
     };
 
+    /**
+      * Called, from the thread that receives the replies, for every object
+      * subscribed to that another client writes or removes. version is
+      * the new version of the object, 0 if it was removed.
+      */
+    using InvalidationHandler =
+        std::function<void(ObjectID oid, uint64_t version)>;
+
     virtual ~BladeClient() = default;
 
     virtual void connect(const std::string& address,
                          const std::string& port) = 0;
 
+    // Makes the requests that follow count against the quotas of app_id on
+    // the server, given the key app_id was registered with on the server.
+    // Clients that do not authenticate belong to application 0
+    virtual BladeClient::ClientFuture authenticate_async(AppId app_id,
+            const std::string& key) = 0;
+
+    // Asks for the cache statistics of the server, see getCacheStats()
+    virtual BladeClient::ClientFuture cache_stats_async() = 0;
+    // Asks for the memory used by the backend of the server, see
+    // getMemoryStats()
+    virtual BladeClient::ClientFuture memory_stats_async() = 0;
+
     // Read
     virtual std::pair<std::shared_ptr<const char>, unsigned int> read_sync(
         ObjectID id) = 0;
@@ -71,8 +136,15 @@ class BladeClient {
         const std::vector<ObjectID>& ids) = 0;
 
     virtual BladeClient::ClientFuture read_async(ObjectID oid) = 0;
+    // Sends the object only if its version is above version, see
+    // isModified()
+    virtual BladeClient::ClientFuture read_async_if_newer(ObjectID oid,
+            uint64_t version) = 0;
     virtual BladeClient::ClientFuture read_async_bulk(
                                          const std::vector<ObjectID>& oids) = 0;
+    // Missing objects do not fail the read, see getStatuses()
+    virtual BladeClient::ClientFuture read_async_bulk_partial(
+                                         const std::vector<ObjectID>& oids) = 0;
 
     // Write
     virtual bool write_sync(ObjectID id,  const WriteUnit& w) = 0;
@@ -85,8 +157,84 @@ class BladeClient {
     virtual BladeClient::ClientFuture write_async_bulk(
             const std::vector<ObjectID>& oids,
             const WriteUnits& w) = 0;
+    // Every object is tried, see getStatuses()
+    virtual BladeClient::ClientFuture write_async_bulk_partial(
+            const std::vector<ObjectID>& oids,
+            const WriteUnits& w) = 0;
+    // The server removes the objects ttl_ms milliseconds after the write,
+    // unless they are written again before
+    virtual BladeClient::ClientFuture write_async_ttl(ObjectID oid,
+            const WriteUnit& w, uint64_t ttl_ms) = 0;
+    virtual BladeClient::ClientFuture write_async_bulk_ttl(
+            const std::vector<ObjectID>& oids,
+            const WriteUnits& w, uint64_t ttl_ms) = 0;
+
+    // Partial operations, on length bytes of an object starting at offset.
+    // They fail with an OutOfRangeException past the end of the object
+    virtual BladeClient::ClientFuture read_async_partial(ObjectID oid,
+            uint64_t offset, uint64_t length) = 0;
+    std::pair<std::shared_ptr<const char>, unsigned int> read_sync_partial(
+            ObjectID oid, uint64_t offset, uint64_t length);
+
+    virtual BladeClient::ClientFuture write_async_partial(ObjectID oid,
+            uint64_t offset, const WriteUnit& w) = 0;
+    bool write_sync_partial(ObjectID oid, uint64_t offset,
+            const WriteUnit& w);
+
+    // Atomic operations, executed by the server. get() tells whether the
+    // object was changed, getDataPair() has the object when a swap did not
+    // match and the previous object when adding with fetch set
+    virtual BladeClient::ClientFuture compare_and_swap_async(ObjectID oid,
+            const WriteUnit* expected, const WriteUnit& desired) = 0;
+    virtual BladeClient::ClientFuture compare_and_swap_version_async(
+            ObjectID oid, uint64_t expected_version,
+            const WriteUnit& desired) = 0;
+    virtual BladeClient::ClientFuture fetch_add_async(ObjectID oid,
+            const std::vector<uint64_t>& operand, bool fetch) = 0;
+    virtual BladeClient::ClientFuture fetch_add_async(ObjectID oid,
+            const std::vector<double>& operand, bool fetch) = 0;
+    uint64_t fetch_add(ObjectID oid, uint64_t value);
+    // Adds scale * operand to a vector, e.g. to sum gradients on the server
+    virtual BladeClient::ClientFuture accumulate_async(ObjectID oid,
+            const std::vector<double>& operand, double scale) = 0;
+    virtual BladeClient::ClientFuture accumulate_async(ObjectID oid,
+            const std::vector<float>& operand, float scale) = 0;
+
+    // Runs a function of a server plugin on the objects with ids first to
+    // last (inclusive), getDataPair() has its result
+    virtual BladeClient::ClientFuture call_async(const std::string& function,
+            ObjectID first, ObjectID last, const std::string& args) = 0;
+    std::string call_sync(const std::string& function, ObjectID first,
+            ObjectID last, const std::string& args);
+
+    // Subscriptions to the changes other clients make to the objects with
+    // ids first to last (inclusive), reported to the invalidation handler
+    virtual void set_invalidation_handler(InvalidationHandler handler) = 0;
+    virtual BladeClient::ClientFuture subscribe_async(ObjectID first,
+            ObjectID last) = 0;
+    virtual BladeClient::ClientFuture unsubscribe_async(ObjectID first,
+            ObjectID last) = 0;
+
+    // Waits until any of the objects is written past the version given
+    // for it, or for timeout_ms. getStatuses() tells the objects written
+    virtual BladeClient::ClientFuture watch_async(
+            const std::vector<ObjectID>& oids,
+            const std::vector<uint64_t>& versions, uint64_t timeout_ms) = 0;
 
     virtual bool remove(ObjectID id) = 0;
+
+    // Range operations, on the objects with ids first to last (inclusive).
+    // By default they are built on the bulk operations
+    virtual BladeClient::ClientFuture read_async_range(ObjectID first,
+            ObjectID last);
+    std::pair<std::shared_ptr<const char>, unsigned int> read_sync_range(
+            ObjectID first, ObjectID last);
+
+    virtual BladeClient::ClientFuture write_async_range(ObjectID first,
+            ObjectID last, const WriteUnits& w);
+    bool write_sync_range(ObjectID first, ObjectID last, const WriteUnits& w);
+
+    virtual bool remove_range(ObjectID first, ObjectID last);
 };
 
 }  // namespace cirrus
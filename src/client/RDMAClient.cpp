@@ -105,6 +105,194 @@ BladeClient::ClientFuture RDMAClient::write_async_bulk(
     return readToLocalAsync(loc, nullptr);
 }
 
+BladeClient::ClientFuture RDMAClient::read_async_bulk_partial(
+                                   const std::vector<ObjectID>& /* oids*/ ) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::write_async_bulk_partial(
+        const std::vector<ObjectID>& /* oids */,
+        const WriteUnits& /* w */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::write_async_ttl(ObjectID /* oid */,
+        const WriteUnit& /* w */, uint64_t /* ttl_ms */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::write_async_bulk_ttl(
+        const std::vector<ObjectID>& /* oids */,
+        const WriteUnits& /* w */, uint64_t /* ttl_ms */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+/**
+  * The RDMA client keeps no versions: the object is always read.
+  */
+BladeClient::ClientFuture RDMAClient::read_async_if_newer(
+        ObjectID oid, uint64_t /* version */) {
+    return read_async(oid);
+}
+
+BladeClient::ClientFuture RDMAClient::compare_and_swap_async(ObjectID /* oid */,
+        const WriteUnit* /* expected */, const WriteUnit& /* desired */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::compare_and_swap_version_async(
+        ObjectID /* oid */, uint64_t /* expected_version */,
+        const WriteUnit& /* desired */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::fetch_add_async(ObjectID /* oid */,
+        const std::vector<uint64_t>& /* operand */, bool /* fetch */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::fetch_add_async(ObjectID /* oid */,
+        const std::vector<double>& /* operand */, bool /* fetch */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::accumulate_async(ObjectID /* oid */,
+        const std::vector<double>& /* operand */, double /* scale */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::accumulate_async(ObjectID /* oid */,
+        const std::vector<float>& /* operand */, float /* scale */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::call_async(
+        const std::string& /* function */, ObjectID /* first */,
+        ObjectID /* last */, const std::string& /* args */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+void RDMAClient::set_invalidation_handler(
+        InvalidationHandler /* handler */) {
+    throw std::runtime_error("Not implemented");
+}
+
+BladeClient::ClientFuture RDMAClient::authenticate_async(
+        AppId /* app_id */, const std::string& /* key */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::cache_stats_async() {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::memory_stats_async() {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::subscribe_async(ObjectID /* first */,
+        ObjectID /* last */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::unsubscribe_async(
+        ObjectID /* first */, ObjectID /* last */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::watch_async(
+        const std::vector<ObjectID>& /* oids */,
+        const std::vector<uint64_t>& /* versions */,
+        uint64_t /* timeout_ms */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::read_async_partial(
+        ObjectID /* oid */, uint64_t /* offset */, uint64_t /* length */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
+BladeClient::ClientFuture RDMAClient::write_async_partial(
+        ObjectID /* oid */, uint64_t /* offset */, const WriteUnit& /* w */) {
+    BladeLocation loc;
+
+    throw std::runtime_error("Not implemented");
+
+    return readToLocalAsync(loc, nullptr);
+}
+
 /**
   * Writes an object to remote storage under id.
   * @param id the id of the object the user wishes to write to remote memory.
@@ -138,6 +138,10 @@ struct RDMAMem {
 class RDMAClient : public BladeClient {
  public:
     void connect(const std::string& address, const std::string& port) override;
+    BladeClient::ClientFuture authenticate_async(AppId app_id,
+            const std::string& key) override;
+    BladeClient::ClientFuture cache_stats_async() override;
+    BladeClient::ClientFuture memory_stats_async() override;
     bool write_sync(ObjectID id, const WriteUnit& w) override;
     std::pair<std::shared_ptr<const char>, unsigned int> read_sync(ObjectID oid)
         override;
@@ -148,8 +152,12 @@ class RDMAClient : public BladeClient {
         const WriteUnit& w) override;
 
     BladeClient::ClientFuture read_async(ObjectID oid) override;
+    BladeClient::ClientFuture read_async_if_newer(ObjectID oid,
+            uint64_t version) override;
     BladeClient::ClientFuture read_async_bulk(
                                     const std::vector<ObjectID> &oids) override;
+    BladeClient::ClientFuture read_async_bulk_partial(
+                                    const std::vector<ObjectID> &oids) override;
 
     bool write_sync_bulk(
             const std::vector<ObjectID>& oids,
@@ -157,6 +165,45 @@ class RDMAClient : public BladeClient {
     BladeClient::ClientFuture write_async_bulk(
             const std::vector<ObjectID>& oids,
             const WriteUnits& w) override;
+    BladeClient::ClientFuture write_async_bulk_partial(
+            const std::vector<ObjectID>& oids,
+            const WriteUnits& w) override;
+    BladeClient::ClientFuture write_async_ttl(ObjectID oid,
+            const WriteUnit& w, uint64_t ttl_ms) override;
+    BladeClient::ClientFuture write_async_bulk_ttl(
+            const std::vector<ObjectID>& oids,
+            const WriteUnits& w, uint64_t ttl_ms) override;
+
+    BladeClient::ClientFuture read_async_partial(ObjectID oid,
+            uint64_t offset, uint64_t length) override;
+    BladeClient::ClientFuture write_async_partial(ObjectID oid,
+            uint64_t offset, const WriteUnit& w) override;
+
+    BladeClient::ClientFuture compare_and_swap_async(ObjectID oid,
+            const WriteUnit* expected, const WriteUnit& desired) override;
+    BladeClient::ClientFuture compare_and_swap_version_async(ObjectID oid,
+            uint64_t expected_version, const WriteUnit& desired) override;
+    BladeClient::ClientFuture fetch_add_async(ObjectID oid,
+            const std::vector<uint64_t>& operand, bool fetch) override;
+    BladeClient::ClientFuture fetch_add_async(ObjectID oid,
+            const std::vector<double>& operand, bool fetch) override;
+    BladeClient::ClientFuture accumulate_async(ObjectID oid,
+            const std::vector<double>& operand, double scale) override;
+    BladeClient::ClientFuture accumulate_async(ObjectID oid,
+            const std::vector<float>& operand, float scale) override;
+
+    BladeClient::ClientFuture call_async(const std::string& function,
+            ObjectID first, ObjectID last, const std::string& args) override;
+
+    void set_invalidation_handler(InvalidationHandler handler) override;
+    BladeClient::ClientFuture subscribe_async(ObjectID first,
+            ObjectID last) override;
+    BladeClient::ClientFuture unsubscribe_async(ObjectID first,
+            ObjectID last) override;
+
+    BladeClient::ClientFuture watch_async(const std::vector<ObjectID>& oids,
+            const std::vector<uint64_t>& versions,
+            uint64_t timeout_ms) override;
 
     bool remove(ObjectID id) override;
 
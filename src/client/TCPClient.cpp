@@ -5,8 +5,10 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
+#include <climits>
 #include <string>
 #include <vector>
 #include <thread>
@@ -23,6 +25,8 @@
 namespace cirrus {
 
 static const int initial_buffer_size = 50;
+// max number of queued messages sent with a single call
+static const unsigned int max_send_batch = 64;
 
 /**
  * Destructor method for the TCPClient. Terminates the receiver and sender
@@ -111,6 +115,20 @@ void TCPClient::connect(const std::string& address,
   */
 BladeClient::ClientFuture TCPClient::write_async(ObjectID oid,
     const WriteUnit& w) {
+    return write_async_ttl(oid, w, 0);
+}
+
+/**
+  * Asynchronously writes an object that the server removes after a time.
+  * @param id the id of the object the user wishes to write to remote memory.
+  * @param w a WriteUnit containing a serializer and the item to be serialized
+  * @param ttl_ms time after which the object is removed, in milliseconds.
+  * 0 if the object does not expire.
+  * @return A ClientFuture that contains information about the status of the
+  * operation.
+  */
+BladeClient::ClientFuture TCPClient::write_async_ttl(ObjectID oid,
+    const WriteUnit& w, uint64_t ttl_ms) {
 
     // Create flatbuffer builder
     flatbuffers::FlatBufferBuilder* builder;
@@ -141,7 +159,8 @@ BladeClient::ClientFuture TCPClient::write_async(ObjectID oid,
     w.serialize(mem);
     auto msg_contents = message::TCPBladeMessage::CreateWrite(*builder,
                                                               oid,
-                                                              data_fb_vector);
+                                                              data_fb_vector,
+                                                              ttl_ms);
     const int txn_id = curr_txn_id++;
     auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
                                         *builder,
@@ -191,6 +210,509 @@ BladeClient::ClientFuture TCPClient::read_async(ObjectID oid) {
     return enqueue_message(builder, txn_id);
 }
 
+/**
+ * Asynchronously reads an object from the remote server, if the server has
+ * a version newer than the one given. Otherwise no data is sent and
+ * ClientFuture::isModified() returns false.
+ * @param oid the id of the object.
+ * @param version the version of the object the caller has, 0 if none.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::read_async_if_newer(ObjectID oid,
+        uint64_t version) {
+    auto builder = new flatbuffers::FlatBufferBuilder(initial_buffer_size);
+
+    auto msg_contents = message::TCPBladeMessage::CreateReadIfNewer(*builder,
+            oid, version);
+
+    const int txn_id = curr_txn_id++;
+
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                *builder,
+                                txn_id,
+                                0,
+                                message::TCPBladeMessage::Message_ReadIfNewer,
+                                msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Asynchronously replaces an object, if it is equal to the object
+ * expected. get() returns whether the object was replaced. Otherwise
+ * getDataPair() has the object as it is.
+ * @param oid the id of the object.
+ * @param expected the object expected, nullptr if the object should not
+ * exist yet.
+ * @param desired the new object.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::compare_and_swap_async(ObjectID oid,
+        const WriteUnit* expected, const WriteUnit& desired) {
+    return send_compare_and_swap(oid, expected, 0, desired);
+}
+
+/**
+ * Asynchronously replaces an object, if it has not been written since the
+ * version given, e.g. as returned by ClientFuture::getVersion(). get()
+ * returns whether the object was replaced. Otherwise getDataPair() has the
+ * object as it is.
+ * @param oid the id of the object.
+ * @param expected_version the version of the object expected.
+ * @param desired the new object.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::compare_and_swap_version_async(
+        ObjectID oid, uint64_t expected_version, const WriteUnit& desired) {
+    if (expected_version == 0) {
+        throw cirrus::Exception("Objects never have version 0.");
+    }
+    return send_compare_and_swap(oid, nullptr, expected_version, desired);
+}
+
+/**
+ * Asynchronously adds a vector of 64 bit counters to an object,
+ * element by element. Objects that do not exist are taken as 0.
+ * @param oid the id of the object.
+ * @param operand the values added, as many as the counters in the object.
+ * @param fetch whether getDataPair() should have the previous object.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::fetch_add_async(ObjectID oid,
+        const std::vector<uint64_t>& operand, bool fetch) {
+    return send_fetch_add(oid, message::TCPBladeMessage::AddType_UInt64,
+            operand.data(), operand.size() * sizeof(uint64_t), fetch);
+}
+
+/**
+ * Asynchronously adds a vector of doubles to an object, element by
+ * element. Objects that do not exist are taken as 0.
+ * @param oid the id of the object.
+ * @param operand the values added, as many as the doubles in the object.
+ * @param fetch whether getDataPair() should have the previous object.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::fetch_add_async(ObjectID oid,
+        const std::vector<double>& operand, bool fetch) {
+    return send_fetch_add(oid, message::TCPBladeMessage::AddType_Double,
+            operand.data(), operand.size() * sizeof(double), fetch);
+}
+
+/**
+ * Asynchronously adds scale * operand to a vector of doubles, element by
+ * element. The server adds it in place, so several clients can sum their
+ * vectors into one object, e.g. their gradients. Objects that do not
+ * exist are taken as 0.
+ * @param oid the id of the object.
+ * @param operand the values added, as many as the doubles in the object.
+ * @param scale the factor operand is multiplied by.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::accumulate_async(ObjectID oid,
+        const std::vector<double>& operand, double scale) {
+    return send_accumulate(oid, message::TCPBladeMessage::AddType_Double,
+            operand.data(), operand.size() * sizeof(double), scale);
+}
+
+/**
+ * Asynchronously adds scale * operand to a vector of floats, element by
+ * element. Objects that do not exist are taken as 0.
+ * @param oid the id of the object.
+ * @param operand the values added, as many as the floats in the object.
+ * @param scale the factor operand is multiplied by.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::accumulate_async(ObjectID oid,
+        const std::vector<float>& operand, float scale) {
+    return send_accumulate(oid, message::TCPBladeMessage::AddType_Float,
+            operand.data(), operand.size() * sizeof(float), scale);
+}
+
+/**
+ * Sends an Accumulate request.
+ * @param oid the id of the object.
+ * @param type the type of the elements.
+ * @param operand the elements added.
+ * @param size the size of operand, in bytes.
+ * @param scale the factor operand is multiplied by.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::send_accumulate(ObjectID oid,
+        message::TCPBladeMessage::AddType type, const void* operand,
+        uint64_t size, double scale) {
+    // The 64 is to give space for additional flatbuffer internal info
+    auto builder = new flatbuffers::FlatBufferBuilder(size + 64);
+
+    auto operand_fb = builder->CreateVector(
+            reinterpret_cast<const int8_t*>(operand), size);
+    auto msg_contents = message::TCPBladeMessage::CreateAccumulate(*builder,
+            oid, type, scale, operand_fb);
+
+    const int txn_id = curr_txn_id++;
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                            *builder,
+                            txn_id,
+                            0,
+                            message::TCPBladeMessage::Message_Accumulate,
+                            msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Sends a CompareAndSwap request.
+ * @param oid the id of the object.
+ * @param expected the object expected, nullptr if expected_version is
+ * given or if the object should not exist.
+ * @param expected_version the version expected, 0 to compare the object.
+ * @param desired the new object.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::send_compare_and_swap(ObjectID oid,
+        const WriteUnit* expected, uint64_t expected_version,
+        const WriteUnit& desired) {
+    uint64_t expected_size = expected ? expected->size() : 0;
+    // The 64 is to give space for additional flatbuffer internal info
+    auto builder = new flatbuffers::FlatBufferBuilder(
+            expected_size + desired.size() + 64);
+
+    int8_t *mem;
+    flatbuffers::Offset<flatbuffers::Vector<int8_t>> expected_fb;
+    if (expected) {
+        expected_fb = builder->CreateUninitializedVector(expected_size, &mem);
+        expected->serialize(mem);
+    }
+    auto desired_fb = builder->CreateUninitializedVector(desired.size(), &mem);
+    desired.serialize(mem);
+    auto msg_contents = message::TCPBladeMessage::CreateCompareAndSwap(
+            *builder, oid, expected_fb, expected_version, desired_fb);
+
+    const int txn_id = curr_txn_id++;
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                            *builder,
+                            txn_id,
+                            0,
+                            message::TCPBladeMessage::Message_CompareAndSwap,
+                            msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Sends a FetchAdd request.
+ * @param oid the id of the object.
+ * @param type the type of the elements.
+ * @param operand the elements added.
+ * @param size the size of operand, in bytes.
+ * @param fetch whether the previous object should be sent back.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::send_fetch_add(ObjectID oid,
+        message::TCPBladeMessage::AddType type, const void* operand,
+        uint64_t size, bool fetch) {
+    // The 64 is to give space for additional flatbuffer internal info
+    auto builder = new flatbuffers::FlatBufferBuilder(size + 64);
+
+    auto operand_fb = builder->CreateVector(
+            reinterpret_cast<const int8_t*>(operand), size);
+    auto msg_contents = message::TCPBladeMessage::CreateFetchAdd(*builder,
+            oid, type, operand_fb, fetch);
+
+    const int txn_id = curr_txn_id++;
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                            *builder,
+                            txn_id,
+                            0,
+                            message::TCPBladeMessage::Message_FetchAdd,
+                            msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Asynchronously runs a function of a server plugin on the objects with
+ * ids first to last that exist. Only the result of the function is sent
+ * back, so objects can be filtered or reduced without reading them.
+ * The future throws a NoSuchFunctionException if no plugin defines the
+ * function.
+ * @param function the name of the function.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @param args the arguments of the function.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::call_async(const std::string& function,
+        ObjectID first, ObjectID last, const std::string& args) {
+    // The 64 is to give space for additional flatbuffer internal info
+    auto builder = new flatbuffers::FlatBufferBuilder(
+            function.size() + args.size() + 64);
+
+    auto name_fb = builder->CreateString(function);
+    auto args_fb = builder->CreateVector(
+            reinterpret_cast<const int8_t*>(args.data()), args.size());
+    auto msg_contents = message::TCPBladeMessage::CreateCall(*builder,
+            name_fb, first, last, args_fb);
+
+    const int txn_id = curr_txn_id++;
+
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                *builder,
+                                txn_id,
+                                0,
+                                message::TCPBladeMessage::Message_Call,
+                                msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Sets the function called for the invalidations pushed by the server.
+ * It runs on the thread that receives the replies, so it must not block
+ * nor wait on futures of this client.
+ * @param handler the function, or nullptr to ignore invalidations.
+ */
+void TCPClient::set_invalidation_handler(InvalidationHandler handler) {
+    handler_lock.wait();
+    invalidation_handler = std::move(handler);
+    handler_lock.signal();
+}
+
+/**
+ * Asynchronously subscribes to the changes other clients make to the
+ * objects with ids first to last. From then on the server pushes the ids
+ * of the objects written or removed, which are given to the invalidation
+ * handler. Changes are pushed after the replies to the reads that
+ * preceded them, so a copy cached from a read is always invalidated if
+ * the object changed since.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::subscribe_async(ObjectID first,
+        ObjectID last) {
+    return send_subscribe(first, last, false);
+}
+
+/**
+ * Asynchronously drops the subscriptions within the ids first to last.
+ * Invalidations already sent by the server may still be received.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::unsubscribe_async(ObjectID first,
+        ObjectID last) {
+    return send_subscribe(first, last, true);
+}
+
+/**
+ * Sends a Subscribe request.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @param unsubscribe whether to drop the subscriptions instead.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::send_subscribe(ObjectID first,
+        ObjectID last, bool unsubscribe) {
+    auto builder = new flatbuffers::FlatBufferBuilder(initial_buffer_size);
+
+    auto msg_contents = message::TCPBladeMessage::CreateSubscribe(*builder,
+            first, last, unsubscribe);
+
+    const int txn_id = curr_txn_id++;
+
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                *builder,
+                                txn_id,
+                                0,
+                                message::TCPBladeMessage::Message_Subscribe,
+                                msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Asynchronously sets the application of the client on the server, whose
+ * quotas apply to the requests sent after.
+ * @param app_id the application.
+ * @param key the key the application was registered with on the server.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::authenticate_async(AppId app_id,
+        const std::string& key) {
+    auto builder = new flatbuffers::FlatBufferBuilder(initial_buffer_size);
+
+    auto key_fb = builder->CreateString(key);
+    auto msg_contents = message::TCPBladeMessage::CreateAuthenticate(*builder,
+            app_id, key_fb);
+
+    const int txn_id = curr_txn_id++;
+
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                *builder,
+                                txn_id,
+                                0,
+                                message::TCPBladeMessage::Message_Authenticate,
+                                msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Asynchronously asks for the cache statistics of the server.
+ * @return A ClientFuture holding the statistics, see getCacheStats().
+ */
+BladeClient::ClientFuture TCPClient::cache_stats_async() {
+    auto builder = new flatbuffers::FlatBufferBuilder(initial_buffer_size);
+
+    auto msg_contents = message::TCPBladeMessage::CreateCacheStats(*builder);
+
+    const int txn_id = curr_txn_id++;
+
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                *builder,
+                                txn_id,
+                                0,
+                                message::TCPBladeMessage::Message_CacheStats,
+                                msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Asynchronously asks for the memory used by the backend of the server.
+ * @return A ClientFuture holding the statistics, see getMemoryStats().
+ */
+BladeClient::ClientFuture TCPClient::memory_stats_async() {
+    auto builder = new flatbuffers::FlatBufferBuilder(initial_buffer_size);
+
+    auto msg_contents = message::TCPBladeMessage::CreateMemoryStats(*builder);
+
+    const int txn_id = curr_txn_id++;
+
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                *builder,
+                                txn_id,
+                                0,
+                                message::TCPBladeMessage::Message_MemoryStats,
+                                msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Gives the objects of an invalidation pushed by the server to the
+ * invalidation handler.
+ * @param invalidate the message.
+ */
+void TCPClient::process_invalidate(
+        const message::TCPBladeMessage::Invalidate* invalidate) {
+    handler_lock.wait();
+    InvalidationHandler handler = invalidation_handler;
+    handler_lock.signal();
+    auto oids = invalidate->oids();
+    auto versions = invalidate->versions();
+    if (!handler || !oids || !versions) {
+        return;
+    }
+    for (uint64_t i = 0; i < oids->size() && i < versions->size(); ++i) {
+        handler(oids->Get(i), versions->Get(i));
+    }
+}
+
+/**
+ * Asynchronously waits until any of a set of objects is written past the
+ * version the caller has of it. The server answers as soon as it happens,
+ * or once timeout_ms elapse, so the caller does not have to poll.
+ * ClientFuture::getStatuses() tells which objects were written (none on a
+ * timeout) and ClientFuture::getVersions() their versions.
+ * @param oids the ids of the objects.
+ * @param versions the version the caller has of each object, 0 if none.
+ * @param timeout_ms longest time to wait. 0 returns right away.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::watch_async(
+        const std::vector<ObjectID>& oids,
+        const std::vector<uint64_t>& versions, uint64_t timeout_ms) {
+    if (oids.size() != versions.size()) {
+        throw cirrus::Exception("A watch needs a version for every object.");
+    }
+    auto builder = new flatbuffers::FlatBufferBuilder(initial_buffer_size);
+
+    auto oids_fb = builder->CreateVector(oids);
+    auto versions_fb = builder->CreateVector(versions);
+    auto msg_contents = message::TCPBladeMessage::CreateWatch(*builder,
+            oids_fb, versions_fb, timeout_ms);
+
+    const int txn_id = curr_txn_id++;
+
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                *builder,
+                                txn_id,
+                                0,
+                                message::TCPBladeMessage::Message_Watch,
+                                msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Asynchronously reads part of an object from the remote server.
+ * @param oid the id of the object.
+ * @param offset the offset of the first byte read.
+ * @param length the number of bytes read.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::read_async_partial(ObjectID oid,
+        uint64_t offset, uint64_t length) {
+    auto builder = new flatbuffers::FlatBufferBuilder(initial_buffer_size);
+
+    auto msg_contents = message::TCPBladeMessage::CreateReadPartial(*builder,
+            oid, offset, length);
+
+    const int txn_id = curr_txn_id++;
+
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                *builder,
+                                txn_id,
+                                0,
+                                message::TCPBladeMessage::Message_ReadPartial,
+                                msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Asynchronously overwrites part of an object on the remote server. Only
+ * the bytes written are sent.
+ * @param oid the id of the object.
+ * @param offset the offset of the first byte overwritten.
+ * @param w a WriteUnit with the bytes written.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::write_async_partial(ObjectID oid,
+        uint64_t offset, const WriteUnit& w) {
+    uint64_t size = w.size();
+    // The 64 is to give space for additional flatbuffer internal info
+    auto builder = new flatbuffers::FlatBufferBuilder(size + 64);
+
+    int8_t *mem;
+    auto data_fb_vector = builder->CreateUninitializedVector(size, &mem);
+    w.serialize(mem);
+    auto msg_contents = message::TCPBladeMessage::CreateWritePartial(*builder,
+            oid, offset, data_fb_vector);
+
+    const int txn_id = curr_txn_id++;
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                *builder,
+                                txn_id,
+                                0,
+                                message::TCPBladeMessage::Message_WritePartial,
+                                msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
 /**
  * Asynchronously reads a set of objects from the remote server.
  * @param oids the ids of the objects the user wishes to read to local memory.
@@ -198,6 +720,29 @@ BladeClient::ClientFuture TCPClient::read_async(ObjectID oid) {
  */
 BladeClient::ClientFuture TCPClient::read_async_bulk(
         const std::vector<ObjectID>& oids) {
+    return send_read_bulk(oids, false);
+}
+
+/**
+ * Asynchronously reads a set of objects from the remote server. Objects
+ * that do not exist are read as empty and reported by
+ * ClientFuture::getStatuses() instead of failing the whole read.
+ * @param oids the ids of the objects the user wishes to read to local memory.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::read_async_bulk_partial(
+        const std::vector<ObjectID>& oids) {
+    return send_read_bulk(oids, true);
+}
+
+/**
+ * Sends a ReadBulk request.
+ * @param oids the ids of the objects the user wishes to read to local memory.
+ * @param partial whether missing objects do not fail the read.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::send_read_bulk(
+        const std::vector<ObjectID>& oids, bool partial) {
 #ifdef PERF_LOG
     TimerFunction builder_timer;
 #endif
@@ -209,7 +754,8 @@ BladeClient::ClientFuture TCPClient::read_async_bulk(
 
     auto msg_contents = message::TCPBladeMessage::CreateReadBulk(*builder,
                                                               oids.size(),
-                                                              data_fb_vector);
+                                                              data_fb_vector,
+                                                              partial);
     const int txn_id = curr_txn_id++;
     auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
                                      *builder,
@@ -294,6 +840,48 @@ bool TCPClient::write_sync_bulk(
 BladeClient::ClientFuture TCPClient::write_async_bulk(
                                              const std::vector<ObjectID>& oids,
                                              const WriteUnits& w) {
+    return send_write_bulk(oids, w, false, 0);
+}
+
+/**
+ * Asynchronously writes a set of objects to the remote server. Every
+ * object is tried, and the objects not written (e.g. because the server
+ * is full) are reported by ClientFuture::getStatuses().
+ * @param oids the ids of the objects the user wishes to write to remote memory.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::write_async_bulk_partial(
+                                             const std::vector<ObjectID>& oids,
+                                             const WriteUnits& w) {
+    return send_write_bulk(oids, w, true, 0);
+}
+
+/**
+ * Asynchronously writes a set of objects that the server removes after a
+ * time, unless they are written again before.
+ * @param oids the ids of the objects the user wishes to write to remote memory.
+ * @param ttl_ms time after which the objects are removed, in milliseconds.
+ * 0 if the objects do not expire.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::write_async_bulk_ttl(
+                                             const std::vector<ObjectID>& oids,
+                                             const WriteUnits& w,
+                                             uint64_t ttl_ms) {
+    return send_write_bulk(oids, w, false, ttl_ms);
+}
+
+/**
+ * Sends a WriteBulk request.
+ * @param oids the ids of the objects the user wishes to write to remote memory.
+ * @param partial whether to try every object instead of stopping at the
+ * first failure.
+ * @param ttl_ms TTL of the objects, 0 if they do not expire.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::send_write_bulk(
+        const std::vector<ObjectID>& oids, const WriteUnits& w, bool partial,
+        uint64_t ttl_ms) {
 #ifdef PERF_LOG
     TimerFunction builder_timer;
 #endif
@@ -310,7 +898,9 @@ BladeClient::ClientFuture TCPClient::write_async_bulk(
     auto msg_contents = message::TCPBladeMessage::CreateWriteBulk(*builder,
                                                               oids.size(),
                                                               oids_vector,
-                                                              data_fb_vector);
+                                                              data_fb_vector,
+                                                              partial,
+                                                              ttl_ms);
     const int txn_id = curr_txn_id++;
     auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
                                     *builder,
@@ -356,6 +946,101 @@ bool TCPClient::remove(ObjectID oid) {
     return future.get();
 }
 
+/**
+ * Asynchronously reads the objects with ids first to last, with a single
+ * request that does not list the ids.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::read_async_range(ObjectID first,
+        ObjectID last) {
+    if (last < first) {
+        throw cirrus::Exception("Last objectID of a range must be greater "
+            "than first objectID.");
+    }
+    auto builder = new flatbuffers::FlatBufferBuilder(initial_buffer_size);
+
+    auto msg_contents = message::TCPBladeMessage::CreateReadRange(*builder,
+                                                                 first,
+                                                                 last);
+    const int txn_id = curr_txn_id++;
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                    *builder,
+                                    txn_id,
+                                    0,
+                                    message::TCPBladeMessage::Message_ReadRange,
+                                    msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+ * Asynchronously writes objects under ids first to last, with a single
+ * request that does not list the ids.
+ * @param first the id of the first object.
+ * @param last the id of the last object.
+ * @param w the objects, one per id of the range.
+ * @return A ClientFuture containing information about the operation.
+ */
+BladeClient::ClientFuture TCPClient::write_async_range(ObjectID first,
+        ObjectID last, const WriteUnits& w) {
+    if (last < first) {
+        throw cirrus::Exception("Last objectID of a range must be greater "
+            "than first objectID.");
+    }
+    auto w_size = w.size();
+    auto builder = new flatbuffers::FlatBufferBuilder(w_size + 50);
+
+    int8_t* mem;
+    auto data_fb_vector = builder->CreateUninitializedVector(w_size, &mem);
+    w.serialize(mem);
+
+    auto msg_contents = message::TCPBladeMessage::CreateWriteRange(*builder,
+                                                              first,
+                                                              last - first + 1,
+                                                              data_fb_vector);
+    const int txn_id = curr_txn_id++;
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                   *builder,
+                                   txn_id,
+                                   0,
+                                   message::TCPBladeMessage::Message_WriteRange,
+                                   msg_contents.Union());
+    builder->Finish(msg);
+    return enqueue_message(builder, txn_id);
+}
+
+/**
+  * Removes the objects with ids first to last from the remote store, with
+  * a single request. Ids without an object are skipped.
+  * @param first the id of the first object.
+  * @param last the id of the last object.
+  * @return True if the range was processed by the server.
+  */
+bool TCPClient::remove_range(ObjectID first, ObjectID last) {
+    if (last < first) {
+        throw cirrus::Exception("Last objectID of a range must be greater "
+            "than first objectID.");
+    }
+    auto builder = new flatbuffers::FlatBufferBuilder(initial_buffer_size);
+
+    auto msg_contents = message::TCPBladeMessage::CreateRemoveRange(*builder,
+                                                                   first,
+                                                                   last);
+    const int txn_id = curr_txn_id++;
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                                  *builder,
+                                  txn_id,
+                                  0,
+                                  message::TCPBladeMessage::Message_RemoveRange,
+                                  msg_contents.Union());
+    builder->Finish(msg);
+
+    BladeClient::ClientFuture future = enqueue_message(builder, txn_id);
+    return future.get();
+}
+
 /**
   * Loop run by the thread that processes incoming messages. Contains all
   * logic for acting upon the incoming messages, which includes copying
@@ -440,6 +1125,13 @@ void TCPClient::process_received() {
         auto ack = message::TCPBladeMessage::GetTCPBladeMessage(buffer->data());
         TxnID txn_id = ack->txnid();
 
+        // Pushed by the server, not the reply to a request
+        if (ack->message_type() ==
+            message::TCPBladeMessage::Message_Invalidate) {
+            process_invalidate(ack->message_as_Invalidate());
+            continue;
+        }
+
 #ifdef PERF_LOG
         TimerFunction map_time;
 #endif
@@ -473,12 +1165,18 @@ void TCPClient::process_received() {
                 {
                     // just put state in the struct, check for errors
                     txn.fd->result = ack->message_as_WriteAck()->success();
+                    txn.fd->version = ack->message_as_WriteAck()->version();
                     break;
                 }
             case message::TCPBladeMessage::Message_WriteBulkAck:
                 {
                     // just put state in the struct, check for errors
                     txn.fd->result = ack->message_as_WriteBulkAck()->success();
+                    auto statuses = ack->message_as_WriteBulkAck()->statuses();
+                    if (statuses) {
+                        txn.fd->statuses.assign(statuses->begin(),
+                                statuses->end());
+                    }
                     break;
                 }
             case message::TCPBladeMessage::Message_ReadAck:
@@ -488,14 +1186,27 @@ void TCPClient::process_received() {
                     LOG<INFO>("Client processing ReadAck");
                     // copy the data from the ReadAck into the given pointer
                     txn.fd->result = ack->message_as_ReadAck()->success();
+                    txn.fd->version = ack->message_as_ReadAck()->version();
+                    txn.fd->modified =
+                        !ack->message_as_ReadAck()->not_modified();
                     LOG<INFO>("Client wrote success");
                     // fb here stands for flatbuffer. This is the
                     // flatbuffer vector representation of the data.
                     // This operation returns a pointer to the vector
                     auto data_fb_vector = ack->message_as_ReadAck()->data();
+                    const char* data = reinterpret_cast<const char*>(
+                        data_fb_vector->Data());
                     txn.fd->data_size = data_fb_vector->size();
 
-                    // data_fb_vector->Data() returns a pointer to the raw data.
+                    // Large objects are sent after the flatbuffer
+                    uint64_t payload_size =
+                        ack->message_as_ReadAck()->payload_size();
+                    if (payload_size > 0) {
+                        data = buffer->data() + incoming_size - payload_size;
+                        txn.fd->data_size = payload_size;
+                    }
+
+                    // data points to the raw data.
                     // This data lives inside of the std::vector buffer,
                     // which was created with a call to std::make_shared.
 
@@ -506,8 +1217,7 @@ void TCPClient::process_received() {
                     // references to the data exist, the buffer containing
                     // the data is deleted.
                     txn.fd->data_ptr = std::shared_ptr<const char>(
-                        reinterpret_cast<const char*>(data_fb_vector->Data()),
-                        read_op_deleter(buffer));
+                        data, read_op_deleter(buffer));
                     LOG<INFO>("Client has pointer to vector");
                     break;
                 }
@@ -515,11 +1225,24 @@ void TCPClient::process_received() {
                 {
                     txn.fd->result = ack->message_as_ReadBulkAck()->success();
                     auto data_fb_vector = ack->message_as_ReadBulkAck()->data();
+                    const char* data = reinterpret_cast<const char*>(
+                        data_fb_vector->Data());
                     txn.fd->data_size = data_fb_vector->size();
 
+                    uint64_t payload_size =
+                        ack->message_as_ReadBulkAck()->payload_size();
+                    if (payload_size > 0) {
+                        data = buffer->data() + incoming_size - payload_size;
+                        txn.fd->data_size = payload_size;
+                    }
+
                     txn.fd->data_ptr = std::shared_ptr<const char>(
-                        reinterpret_cast<const char*>(data_fb_vector->Data()),
-                        read_op_deleter(buffer));
+                        data, read_op_deleter(buffer));
+                    auto statuses = ack->message_as_ReadBulkAck()->statuses();
+                    if (statuses) {
+                        txn.fd->statuses.assign(statuses->begin(),
+                                statuses->end());
+                    }
                     break;
                 }
             case message::TCPBladeMessage::Message_RemoveAck:
@@ -528,6 +1251,84 @@ void TCPClient::process_received() {
                     txn.fd->result = ack->message_as_RemoveAck()->success();
                     break;
                 }
+            case message::TCPBladeMessage::Message_AtomicAck:
+                {
+                    auto atomic_ack = ack->message_as_AtomicAck();
+                    txn.fd->result = atomic_ack->success();
+                    txn.fd->version = atomic_ack->version();
+                    // Same format as a ReadAck
+                    const char* data = reinterpret_cast<const char*>(
+                        atomic_ack->data()->Data());
+                    txn.fd->data_size = atomic_ack->data()->size();
+                    uint64_t payload_size = atomic_ack->payload_size();
+                    if (payload_size > 0) {
+                        data = buffer->data() + incoming_size - payload_size;
+                        txn.fd->data_size = payload_size;
+                    }
+                    txn.fd->data_ptr = std::shared_ptr<const char>(
+                        data, read_op_deleter(buffer));
+                    break;
+                }
+            case message::TCPBladeMessage::Message_WatchAck:
+                {
+                    txn.fd->result = true;
+                    auto statuses = ack->message_as_WatchAck()->statuses();
+                    auto versions = ack->message_as_WatchAck()->versions();
+                    txn.fd->statuses.assign(statuses->begin(),
+                            statuses->end());
+                    txn.fd->versions.assign(versions->begin(),
+                            versions->end());
+                    break;
+                }
+            case message::TCPBladeMessage::Message_SubscribeAck:
+                {
+                    txn.fd->result = ack->message_as_SubscribeAck()->success();
+                    break;
+                }
+            case message::TCPBladeMessage::Message_AuthenticateAck:
+                {
+                    txn.fd->result =
+                        ack->message_as_AuthenticateAck()->success();
+                    break;
+                }
+            case message::TCPBladeMessage::Message_CacheStatsAck:
+                {
+                    auto stats_ack = ack->message_as_CacheStatsAck();
+                    txn.fd->result = true;
+                    txn.fd->cache_stats.hits = stats_ack->hits();
+                    txn.fd->cache_stats.misses = stats_ack->misses();
+                    txn.fd->cache_stats.evictions = stats_ack->evictions();
+                    txn.fd->cache_stats.evicted_bytes =
+                        stats_ack->evicted_bytes();
+                    break;
+                }
+            case message::TCPBladeMessage::Message_MemoryStatsAck:
+                {
+                    auto stats_ack = ack->message_as_MemoryStatsAck();
+                    txn.fd->result = true;
+                    txn.fd->memory_stats.supported = stats_ack->supported();
+                    txn.fd->memory_stats.bytes_used = stats_ack->bytes_used();
+                    txn.fd->memory_stats.bytes_requested =
+                        stats_ack->bytes_requested();
+                    txn.fd->memory_stats.fragmentation =
+                        stats_ack->fragmentation();
+                    break;
+                }
+            case message::TCPBladeMessage::Message_Rejected:
+                {
+                    // The request was not run, the error code tells why
+                    txn.fd->result = false;
+                    break;
+                }
+            case message::TCPBladeMessage::Message_RemoveRangeAck:
+                {
+                    txn.fd->result =
+                        ack->message_as_RemoveRangeAck()->success();
+                    LOG<INFO>("Server removed ",
+                        ack->message_as_RemoveRangeAck()->num_removed(),
+                        " objects");
+                    break;
+                }
             default:
                 throw cirrus::Exception("Unknown message type:" +
                                         std::to_string(ack->message_type()));
@@ -570,6 +1371,43 @@ ssize_t TCPClient::send_all(int sock, const void* data, size_t len,
     return total_sent;
 }
 
+/**
+ * Guarantees that all the buffers are sent, in order.
+ * @param sock the fd of the socket to send on.
+ * @param iov the buffers to send. Modified as data is sent.
+ * @param iovcnt the number of buffers.
+ * @return the number of bytes sent.
+ */
+ssize_t TCPClient::send_all(int sock, struct iovec* iov, int iovcnt) {
+    ssize_t total_sent = 0;
+
+    while (iovcnt > 0) {
+        ssize_t sent = writev(sock, iov, std::min(iovcnt, IOV_MAX));
+
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw cirrus::Exception("Client error sending data to server");
+        }
+
+        total_sent += sent;
+
+        // Skip the buffers that were fully sent
+        while (iovcnt > 0 && static_cast<size_t>(sent) >= iov->iov_len) {
+            sent -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + sent;
+            iov->iov_len -= sent;
+        }
+    }
+
+    return total_sent;
+}
+
 /**
  * Guarantees that an entire message is read.
  * @param sock the fd of the socket to read on.
@@ -597,9 +1435,17 @@ ssize_t TCPClient::read_all(int sock, void* data, size_t len) {
 /**
   * Loop run by the thread that handles sending messages. Takes
   * FlatBufferBuilders off of the queue and then sends the messages they
-  * contain. Does not wait for response.
+  * contain. All the messages already queued are sent with a single call.
+  * Does not wait for response.
   */
 void TCPClient::process_send() {
+    std::vector<flatbuffers::FlatBufferBuilder*> batch;
+    batch.reserve(max_send_batch);
+    // Size of each message, in network order
+    std::vector<uint32_t> sizes(max_send_batch);
+    // Size and content of each message
+    std::vector<struct iovec> iov(2 * max_send_batch);
+
     // Wait until there are messages to send
     while (1) {
         queue_semaphore.wait();
@@ -613,59 +1459,77 @@ void TCPClient::process_send() {
         if (!send_queue.pop(builder)) {
             continue;
         }
+        batch.push_back(builder);
 
-        int message_size = builder->GetSize();
-
-        LOG<INFO>("Client sending size: ", message_size);
-        // Convert size to network order and send
+        // Take the messages queued in the meantime
+        while (batch.size() < max_send_batch && queue_semaphore.trywait()) {
+            if (!send_queue.pop(builder)) {
+                break;
+            }
+            batch.push_back(builder);
+        }
 
-        uint32_t network_order_size = htonl(message_size);
-        if (send_all(sock, &network_order_size, sizeof(uint32_t), 0)
-                != sizeof(uint32_t)) {
-            throw cirrus::Exception("Client error sending data to server");
+        ssize_t total_size = 0;
+        for (unsigned int i = 0; i < batch.size(); ++i) {
+            uint32_t message_size = batch[i]->GetSize();
+            LOG<INFO>("Client sending size: ", message_size);
+            total_size += sizeof(uint32_t) + message_size;
+
+            // Convert size to network order
+            sizes[i] = htonl(message_size);
+            iov[2 * i].iov_base = &sizes[i];
+            iov[2 * i].iov_len = sizeof(uint32_t);
+            iov[2 * i + 1].iov_base = batch[i]->GetBufferPointer();
+            iov[2 * i + 1].iov_len = message_size;
         }
 
 #ifdef PERF_LOG
         TimerFunction send_time;
 #endif
-        LOG<INFO>("Client sending main message");
-        // Send main message
-        if (send_all(sock, builder->GetBufferPointer(), message_size, 0)
-                != message_size) {
+        LOG<INFO>("Client sending ", batch.size(), " messages");
+        if (send_all(sock, iov.data(), 2 * batch.size()) != total_size) {
             throw cirrus::Exception("Client error sending data to server");
         }
 
 #ifdef PERF_LOG
-        double send_mbps = message_size / (1024 * 1024.0) /
+        double send_mbps = total_size / (1024 * 1024.0) /
             (send_time.getUsElapsed() / 1000.0 / 1000.0);
         LOG<PERF>("TCPClient::process_send send time (us): ",
                 send_time.getUsElapsed(),
                 " bw (MB/s): ", send_mbps);
 #endif
-        LOG<INFO>("message pair sent by client");
+        LOG<INFO>("messages sent by client");
 
         // Release the lock so that the other thread may add to the send queue
         queue_lock.signal();
 
-        // Add the builder to the queue if it is of the right type (a write)
-        // And if not over capacity
+        // Add the builders to the queue if they are of the right type
+        // (a write) and if not over capacity
         reuse_lock.wait();
-
-        if (reuse_queue.size() < reuse_max) {
-            // Clean the builder and reuse if it is the right type
-            auto message_type = message::TCPBladeMessage::GetTCPBladeMessage(
-                builder->GetBufferPointer())->message_type();
-
-            if (message_type == message::TCPBladeMessage::Message_Write) {
-                builder->Clear();
-                reuse_queue.push(builder);
+        for (auto sent_builder : batch) {
+            if (reuse_queue.size() < reuse_max) {
+                // Clean the builder and reuse if it is the right type
+                auto message_type =
+                    message::TCPBladeMessage::GetTCPBladeMessage(
+                        sent_builder->GetBufferPointer())->message_type();
+
+                if (message_type == message::TCPBladeMessage::Message_Write) {
+                    sent_builder->Clear();
+                    reuse_queue.push(sent_builder);
+                } else {
+                    delete sent_builder;
+                }
             } else {
-                delete builder;
+                delete sent_builder;
             }
-        } else {
-            delete builder;
         }
         reuse_lock.signal();
+        batch.clear();
+
+        // The signal sent on termination may have been taken above
+        if (terminate_threads) {
+            return;
+        }
     }
 }
 
@@ -41,6 +41,10 @@ class TCPClient : public BladeClient {
     ~TCPClient() override;
     void connect(const std::string& address,
         const std::string& port) override;
+    ClientFuture authenticate_async(AppId app_id,
+            const std::string& key) override;
+    ClientFuture cache_stats_async() override;
+    ClientFuture memory_stats_async() override;
 
     // Read
     std::pair<std::shared_ptr<const char>, unsigned int> read_sync(
@@ -49,7 +53,10 @@ class TCPClient : public BladeClient {
         const std::vector<ObjectID>& ids) override;
 
     ClientFuture read_async(ObjectID oid) override;
+    ClientFuture read_async_if_newer(ObjectID oid, uint64_t version) override;
     ClientFuture read_async_bulk(const std::vector<ObjectID>& oids) override;
+    ClientFuture read_async_bulk_partial(
+            const std::vector<ObjectID>& oids) override;
 
     // Write
     bool write_sync(ObjectID id, const WriteUnit& w) override;
@@ -61,9 +68,51 @@ class TCPClient : public BladeClient {
     BladeClient::ClientFuture write_async_bulk(
             const std::vector<ObjectID>& oids,
             const WriteUnits& w) override;
+    BladeClient::ClientFuture write_async_bulk_partial(
+            const std::vector<ObjectID>& oids,
+            const WriteUnits& w) override;
+    ClientFuture write_async_ttl(ObjectID oid, const WriteUnit& w,
+            uint64_t ttl_ms) override;
+    BladeClient::ClientFuture write_async_bulk_ttl(
+            const std::vector<ObjectID>& oids,
+            const WriteUnits& w, uint64_t ttl_ms) override;
 
     bool remove(ObjectID id) override;
 
+    ClientFuture read_async_range(ObjectID first, ObjectID last) override;
+    ClientFuture write_async_range(ObjectID first, ObjectID last,
+            const WriteUnits& w) override;
+    bool remove_range(ObjectID first, ObjectID last) override;
+
+    ClientFuture read_async_partial(ObjectID oid, uint64_t offset,
+            uint64_t length) override;
+    ClientFuture write_async_partial(ObjectID oid, uint64_t offset,
+            const WriteUnit& w) override;
+
+    ClientFuture compare_and_swap_async(ObjectID oid,
+            const WriteUnit* expected, const WriteUnit& desired) override;
+    ClientFuture compare_and_swap_version_async(ObjectID oid,
+            uint64_t expected_version, const WriteUnit& desired) override;
+    ClientFuture fetch_add_async(ObjectID oid,
+            const std::vector<uint64_t>& operand, bool fetch) override;
+    ClientFuture fetch_add_async(ObjectID oid,
+            const std::vector<double>& operand, bool fetch) override;
+    ClientFuture accumulate_async(ObjectID oid,
+            const std::vector<double>& operand, double scale) override;
+    ClientFuture accumulate_async(ObjectID oid,
+            const std::vector<float>& operand, float scale) override;
+
+    ClientFuture call_async(const std::string& function, ObjectID first,
+            ObjectID last, const std::string& args) override;
+
+    void set_invalidation_handler(InvalidationHandler handler) override;
+    ClientFuture subscribe_async(ObjectID first, ObjectID last) override;
+    ClientFuture unsubscribe_async(ObjectID first, ObjectID last) override;
+
+    ClientFuture watch_async(const std::vector<ObjectID>& oids,
+            const std::vector<uint64_t>& versions,
+            uint64_t timeout_ms) override;
+
  private:
     /**
       * A struct shared between futures and the receiver_thread. Used to
@@ -105,7 +154,26 @@ class TCPClient : public BladeClient {
          std::shared_ptr<std::vector<char>> buffer;
     };
 
+    ClientFuture send_read_bulk(const std::vector<ObjectID>& oids,
+            bool partial);
+    ClientFuture send_write_bulk(const std::vector<ObjectID>& oids,
+            const WriteUnits& w, bool partial, uint64_t ttl_ms);
+    ClientFuture send_compare_and_swap(ObjectID oid,
+            const WriteUnit* expected, uint64_t expected_version,
+            const WriteUnit& desired);
+    ClientFuture send_fetch_add(ObjectID oid,
+            message::TCPBladeMessage::AddType type, const void* operand,
+            uint64_t size, bool fetch);
+    ClientFuture send_accumulate(ObjectID oid,
+            message::TCPBladeMessage::AddType type, const void* operand,
+            uint64_t size, double scale);
+    ClientFuture send_subscribe(ObjectID first, ObjectID last,
+            bool unsubscribe);
+    void process_invalidate(
+            const message::TCPBladeMessage::Invalidate* invalidate);
+
     ssize_t send_all(int, const void*, size_t, int);
+    ssize_t send_all(int sock, struct iovec* iov, int iovcnt);
     ssize_t read_all(int sock, void* data, size_t len);
 
     ClientFuture enqueue_message(
@@ -151,6 +219,10 @@ class TCPClient : public BladeClient {
     cirrus::SpinLock queue_lock;
     /** Lock on the reuse_queue. */
     cirrus::SpinLock reuse_lock;
+    /** Called for the invalidations pushed by the server. */
+    InvalidationHandler invalidation_handler;
+    /** Lock on the invalidation_handler. */
+    cirrus::SpinLock handler_lock;
     /** Semaphore for the send_queue. */
     cirrus::PosixSemaphore queue_semaphore;
     /** Thread that runs the receiving loop. */
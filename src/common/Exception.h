@@ -13,6 +13,12 @@ enum ErrorCodes {
   kException,
   kServerMemoryErrorException,
   kNoSuchIDException,
+  kOutOfRangeException,
+  kNoSuchFunctionException,
+  kQuotaExceededException,
+  kRateLimitedException,
+  kInvalidArgumentException,
+  kAuthenticationException,
 };
 
 /**
@@ -62,6 +68,68 @@ class NoSuchIDException : public cirrus::Exception {
         cirrus::Exception(msg) {}
 };
 
+/**
+  * An exception generated when the user reads or writes bytes past the end
+  * of an object.
+  */
+class OutOfRangeException : public cirrus::Exception {
+ public:
+    explicit OutOfRangeException(std::string msg):
+        cirrus::Exception(msg) {}
+};
+
+/**
+  * An exception generated when the user calls a function that no plugin
+  * of the server defines.
+  */
+class NoSuchFunctionException : public cirrus::Exception {
+ public:
+    explicit NoSuchFunctionException(std::string msg):
+        cirrus::Exception(msg) {}
+};
+
+/**
+  * An exception generated when a write would take the memory used by the
+  * application over its quota on the server.
+  */
+class QuotaExceededException : public cirrus::Exception {
+ public:
+    explicit QuotaExceededException(std::string msg):
+        cirrus::Exception(msg) {}
+};
+
+/**
+  * An exception generated when the server rejects a request because the
+  * application sends requests or data faster than it is allowed. The
+  * request was not run and can be retried later.
+  */
+class RateLimitedException : public cirrus::Exception {
+ public:
+    explicit RateLimitedException(std::string msg):
+        cirrus::Exception(msg) {}
+};
+
+/**
+  * An exception generated when the server rejects a malformed request, e.g.
+  * a range wider than the server accepts or a write whose data does not
+  * hold the objects it announces.
+  */
+class InvalidArgumentException : public cirrus::Exception {
+ public:
+    explicit InvalidArgumentException(std::string msg):
+        cirrus::Exception(msg) {}
+};
+
+/**
+  * An exception generated when the server does not accept the key a client
+  * presents for an application.
+  */
+class AuthenticationException : public cirrus::Exception {
+ public:
+    explicit AuthenticationException(std::string msg):
+        cirrus::Exception(msg) {}
+};
+
 /**
   * An exception generated when the client or server fail to make a connection
   * with the other.
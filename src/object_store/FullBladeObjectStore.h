@@ -38,8 +38,29 @@ class FullBladeObjectStoreTempl : public ObjectStore<T> {
 
     T get(const ObjectID& id) const override;
     bool put(const ObjectID& id, const T& obj) override;
+    // Removed by the server ttl_ms milliseconds later
+    bool put(const ObjectID& id, const T& obj, uint64_t ttl_ms);
     bool remove(ObjectID) override;
 
+    bool get_if_newer(const ObjectID& id, uint64_t* version, T* obj) const;
+    std::vector<bool> watch(const std::vector<ObjectID>& oids,
+            const std::vector<uint64_t>& versions, uint64_t timeout_ms);
+
+    // Changes made by other clients, reported to handler
+    bool subscribe(ObjectID first, ObjectID last,
+            BladeClient::InvalidationHandler handler);
+    bool unsubscribe(ObjectID first, ObjectID last);
+
+    // Atomic, executed by the server
+    bool compare_and_swap(const ObjectID& id, const T& expected,
+            const T& desired);
+    bool compare_and_swap_version(const ObjectID& id, uint64_t version,
+            const T& desired);
+
+    // Partial, on the bytes of an object from offset
+    T get_partial(const ObjectID& id, uint64_t offset, uint64_t length) const;
+    bool put_partial(const ObjectID& id, uint64_t offset, const T& obj);
+
     typename ObjectStore<T>::ObjectStoreGetFuture get_async(
             const ObjectID& id) override;
     typename ObjectStore<T>::ObjectStorePutFuture put_async(const ObjectID& id,
@@ -48,11 +69,15 @@ class FullBladeObjectStoreTempl : public ObjectStore<T> {
     // Get
     void get_bulk(ObjectID start, ObjectID last, T* data) override;
     std::vector<T> get_bulk_fast(const std::vector<ObjectID>& oids) override;
+    std::vector<T> get_bulk_fast(const std::vector<ObjectID>& oids,
+            std::vector<bool>* found);
 
     // Put
     void put_bulk(ObjectID start, ObjectID last, T* data);
     void put_bulk_fast(const std::vector<ObjectID>& oids,
             const std::vector<T>& data);
+    void put_bulk_fast(const std::vector<ObjectID>& oids,
+            const std::vector<T>& data, std::vector<bool>* stored);
 
     void removeBulk(ObjectID first, ObjectID last) override;
 
@@ -124,6 +149,137 @@ T FullBladeObjectStoreTempl<T>::get(const ObjectID& id) const {
 }
 
 
+/**
+  * Retrieves the object at a specified object id, unless it was not
+  * written since the version the caller has. Objects not modified are not
+  * sent by the server.
+  * @param id the ObjectID of the object.
+  * @param version the version of the object the caller has, 0 if none.
+  * Set to the version of the object read.
+  * @param obj set to the object, if it is newer.
+  * @return whether the object was newer and obj was set.
+  */
+template<class T>
+bool FullBladeObjectStoreTempl<T>::get_if_newer(const ObjectID& id,
+        uint64_t* version, T* obj) const {
+    auto future = client->read_async_if_newer(id, *version);
+    if (!future.isModified()) {
+        return false;
+    }
+    std::pair<std::shared_ptr<const char>, unsigned int> ptr_pair =
+        future.getDataPair();
+    *obj = deserializer(ptr_pair.first.get(), ptr_pair.second);
+    *version = future.getVersion();
+    return true;
+}
+
+/**
+  * Waits until any of a set of objects is written past the version the
+  * caller has of it, e.g. as given by get_if_newer(), or until timeout_ms
+  * elapse.
+  * @param oids the ids of the objects.
+  * @param versions the version the caller has of each object, 0 if none.
+  * @param timeout_ms longest time to wait.
+  * @return for each object, whether it was written. All false on a timeout.
+  */
+template<class T>
+std::vector<bool> FullBladeObjectStoreTempl<T>::watch(
+        const std::vector<ObjectID>& oids,
+        const std::vector<uint64_t>& versions, uint64_t timeout_ms) {
+    return client->watch_async(oids, versions, timeout_ms).getStatuses();
+}
+
+/**
+  * Subscribes to the changes other clients make to the objects with ids
+  * first to last. The handler replaces the one of previous subscriptions.
+  * @param first the id of the first object.
+  * @param last the id of the last object.
+  * @param handler function called, from the thread of the client, with
+  * the id of every object written or removed.
+  * @return whether the subscription was made.
+  */
+template<class T>
+bool FullBladeObjectStoreTempl<T>::subscribe(ObjectID first, ObjectID last,
+        BladeClient::InvalidationHandler handler) {
+    client->set_invalidation_handler(std::move(handler));
+    return client->subscribe_async(first, last).get();
+}
+
+/**
+  * Drops the subscriptions within the ids first to last.
+  * @param first the id of the first object.
+  * @param last the id of the last object.
+  * @return whether the subscriptions were dropped.
+  */
+template<class T>
+bool FullBladeObjectStoreTempl<T>::unsubscribe(ObjectID first,
+        ObjectID last) {
+    return client->unsubscribe_async(first, last).get();
+}
+
+/**
+  * Atomically replaces the object at a specified object id, if it is equal
+  * to expected once serialized.
+  * @param id the ObjectID of the object.
+  * @param expected the object expected.
+  * @param desired the new object.
+  * @return whether the object was replaced.
+  */
+template<class T>
+bool FullBladeObjectStoreTempl<T>::compare_and_swap(const ObjectID& id,
+        const T& expected, const T& desired) {
+    WriteUnitTemplate<T> expected_w(serializer, expected);
+    WriteUnitTemplate<T> desired_w(serializer, desired);
+    return client->compare_and_swap_async(id, &expected_w, desired_w).get();
+}
+
+/**
+  * Atomically replaces the object at a specified object id, if it was not
+  * written since a version, e.g. as given by get_if_newer().
+  * @param id the ObjectID of the object.
+  * @param version the version of the object expected.
+  * @param desired the new object.
+  * @return whether the object was replaced.
+  */
+template<class T>
+bool FullBladeObjectStoreTempl<T>::compare_and_swap_version(
+        const ObjectID& id, uint64_t version, const T& desired) {
+    WriteUnitTemplate<T> desired_w(serializer, desired);
+    return client->compare_and_swap_version_async(id, version,
+            desired_w).get();
+}
+
+/**
+  * Retrieves part of the object at a specified object id. The bytes read
+  * are passed to the deserializer as they are.
+  * @param id the ObjectID of the object.
+  * @param offset the offset of the first byte read.
+  * @param length the number of bytes read.
+  * @return the object deserialized from the bytes read.
+  */
+template<class T>
+T FullBladeObjectStoreTempl<T>::get_partial(const ObjectID& id,
+        uint64_t offset, uint64_t length) const {
+    std::pair<std::shared_ptr<const char>, unsigned int> ptr_pair =
+        client->read_sync_partial(id, offset, length);
+    return deserializer(ptr_pair.first.get(), ptr_pair.second);
+}
+
+/**
+  * Overwrites part of the object at a specified object id with a
+  * serialized object. The object stored keeps its size.
+  * @param id the ObjectID of the object.
+  * @param offset the offset where the serialized obj is written.
+  * @param obj the object written.
+  * @return the success of the put.
+  */
+template<class T>
+bool FullBladeObjectStoreTempl<T>::put_partial(const ObjectID& id,
+        uint64_t offset, const T& obj) {
+    WriteUnitTemplate<T> w(serializer, obj);
+    return client->write_sync_partial(id, offset, w);
+}
+
 /**
   * Asynchronously copies object from remote blade to local DRAM.
   * @param id the ObjectID of the object being retrieved.
@@ -154,6 +310,21 @@ bool FullBladeObjectStoreTempl<T>::put(const ObjectID& id, const T& obj) {
     return client->write_sync(id, w);
 }
 
+/**
+  * Puts an object that the server removes after a time, unless it is put
+  * again before.
+  * @param id the ObjectID that the object should be stored under.
+  * @param obj the object to be stored.
+  * @param ttl_ms time after which the object is removed, in milliseconds.
+  * @return the success of the put.
+  */
+template<class T>
+bool FullBladeObjectStoreTempl<T>::put(const ObjectID& id, const T& obj,
+        uint64_t ttl_ms) {
+    WriteUnitTemplate<T> w(serializer, obj);
+    return client->write_async_ttl(id, w, ttl_ms).get();
+}
+
 /**
   * Asynchronously copies object from local dram to remote blade.
   * @param id the ObjectID that obj should be stored under.
@@ -185,18 +356,22 @@ void FullBladeObjectStoreTempl<T>::get_bulk(ObjectID start,
         throw cirrus::Exception("Last objectID for getBulk must be greater "
             "than start objectID.");
     }
-    const int numObjects = last - start + 1;
-    std::vector<typename cirrus::ObjectStore<T>::ObjectStoreGetFuture> futures(
-        numObjects);
-    // Start each get asynchronously
-    for (int i = 0; i < numObjects; i++) {
-        futures[i] = get_async(start + i);
-    }
+    // A single request for the whole range
+    std::pair<std::shared_ptr<const char>, unsigned int> ptr_pair =
+        client->read_sync_range(start, last);
+
+    const uint32_t* ptr =
+                        reinterpret_cast<const uint32_t*>(ptr_pair.first.get());
+    uint32_t num_oids = *ptr++;
+
+    assert(num_oids == last - start + 1);
 
-    // Wait for each item to complete
-    for (int i = 0; i < numObjects; i++) {
-        futures[i].wait();
-        data[i] = futures[i].get();
+    const char* mem = reinterpret_cast<const char*>(ptr);
+    for (uint32_t i = 0; i < num_oids; ++i) {
+        uint32_t size = ntohl(*reinterpret_cast<const uint32_t*>(mem));
+        mem += sizeof(uint32_t);
+        data[i] = deserializer(mem, size);
+        mem += size;
     }
 }
 
@@ -231,6 +406,41 @@ std::vector<T> FullBladeObjectStoreTempl<T>::get_bulk_fast(
     return res;
 }
 
+/**
+ * Gets many objects from the remote store at once, without failing if some
+ * of them do not exist.
+ * @param oids list of Object ids to be retrieved from server
+ * @param found set to whether each object exists
+ * @return the objects, in the order of oids. Objects that do not exist are
+ * left default constructed.
+ */
+template<class T>
+std::vector<T> FullBladeObjectStoreTempl<T>::get_bulk_fast(
+        const std::vector<ObjectID>& oids, std::vector<bool>* found) {
+    auto future = client->read_async_bulk_partial(oids);
+    std::pair<std::shared_ptr<const char>, unsigned int> ptr_pair =
+        future.getDataPair();
+    *found = future.getStatuses();
+
+    const uint32_t* ptr =
+                        reinterpret_cast<const uint32_t*>(ptr_pair.first.get());
+    uint32_t num_oids = *ptr++;
+
+    assert(num_oids == oids.size() && found->size() == oids.size());
+
+    std::vector<T> res(num_oids);
+    const char* mem = reinterpret_cast<const char*>(ptr);
+    for (uint32_t i = 0; i < num_oids; ++i) {
+        uint32_t size = ntohl(*reinterpret_cast<const uint32_t*>(mem));
+        mem += sizeof(uint32_t);
+        if ((*found)[i]) {
+            res[i] = deserializer(mem, size);
+        }
+        mem += size;
+    }
+    return res;
+}
+
 /**
  * Puts many objects to the remote store at once.
  * @param start the objectID that should be assigned to the first object
@@ -245,32 +455,13 @@ void FullBladeObjectStoreTempl<T>::put_bulk(ObjectID start,
         throw cirrus::Exception("Last objectID for putBulk must be greater "
             "than start objectID.");
     }
-    const int numObjects = last - start + 1;
-    std::vector<typename ObjectStore<T>::ObjectStorePutFuture> futures(
-        numObjects);
-    // Start each put asynchronously
-    for (int i = 0; i < numObjects; i++) {
-        futures[i] = put_async(start + i, data[i]);
-    }
-    std::vector<bool> done(numObjects, false);
-    int total_done = 0;
-
-    // Wait for each item to complete
-    while (total_done != numObjects) {
-        for (int i = 0; i < numObjects; i++) {
-            // Check status if not already completed
-            if (!done[i]) {
-                bool ret = futures[i].try_wait();
-                // Copy object and mark true if it completed.
-                if (ret) {
-                    done[i] = true;
-                    // Check to see if exception was thrown.
-                    futures[i].get();
-                    total_done++;
-                }
-            }
-        }
+    // A single request for the whole range
+    std::vector<const T*> obj_ptrs(last - start + 1);
+    for (uint64_t i = 0; i < obj_ptrs.size(); ++i) {
+        obj_ptrs[i] = &data[i];
     }
+    WriteUnitsTemplate<T> w(serializer, obj_ptrs);
+    client->write_sync_range(start, last, w);
 }
 
 /**
@@ -290,6 +481,24 @@ void FullBladeObjectStoreTempl<T>::put_bulk_fast(
     client->write_sync_bulk(oids, w);
 }
 
+/**
+ * Puts many objects to the remote store at once. Every object is tried,
+ * instead of stopping at the first one that cannot be stored.
+ * @param oids The ids of the objects to write
+ * @param data The objects to be written
+ * @param stored set to whether each object was stored
+ */
+template<class T>
+void FullBladeObjectStoreTempl<T>::put_bulk_fast(
+        const std::vector<ObjectID>& oids,
+        const std::vector<T>& data, std::vector<bool>* stored) {
+    std::vector<const T*> obj_ptrs(data.size());
+    std::transform(data.begin(), data.end(), obj_ptrs.begin(),
+            [](const T& o) { return &o; });
+    WriteUnitsTemplate<T> w(serializer, obj_ptrs);
+    *stored = client->write_async_bulk_partial(oids, w).getStatuses();
+}
+
 /**
   * Removes an object from the remote store, deallocating any space used for it.
   * @param id the ObjectID of the object to be removed from remote memory.
@@ -310,9 +519,7 @@ void FullBladeObjectStoreTempl<T>::removeBulk(ObjectID first, ObjectID last) {
     if (first > last) {
         throw cirrus::Exception("First ObjectID to remove must be leq last.");
     }
-    for (ObjectID oid = first; oid <= last; oid++) {
-        client->remove(oid);
-    }
+    client->remove_range(first, last);
 }
 
 template<class T>
@@ -0,0 +1,61 @@
+#include "server/ClockEvictionPolicy.h"
+
+namespace cirrus {
+
+void ClockEvictionPolicy::insert(uint64_t oid) {
+    auto res = positions.emplace(oid, slots.size());
+    if (res.second) {
+        slots.push_back({oid, true});
+    } else {
+        slots[res.first->second].referenced = true;
+    }
+}
+
+void ClockEvictionPolicy::touch(uint64_t oid) {
+    auto it = positions.find(oid);
+    if (it != positions.end()) {
+        slots[it->second].referenced = true;
+    }
+}
+
+void ClockEvictionPolicy::remove(uint64_t oid) {
+    auto it = positions.find(oid);
+    if (it != positions.end()) {
+        remove_slot(it->second);
+    }
+}
+
+bool ClockEvictionPolicy::next_victim(uint64_t* oid, uint64_t keep) {
+    // After one turn all bits are clear, so two turns always find a victim
+    for (uint64_t steps = 0; steps < 2 * slots.size(); ++steps) {
+        if (hand >= slots.size()) {
+            hand = 0;
+        }
+        Slot& slot = slots[hand];
+        if (slot.referenced || slot.oid == keep) {
+            slot.referenced = false;
+            hand++;
+            continue;
+        }
+
+        *oid = slot.oid;
+        // The hand now points to the slot moved in the hole
+        remove_slot(hand);
+        return true;
+    }
+    return false;
+}
+
+/**
+  * Removes the slot at a position by moving the last slot into it.
+  */
+void ClockEvictionPolicy::remove_slot(uint64_t pos) {
+    positions.erase(slots[pos].oid);
+    if (pos != slots.size() - 1) {
+        slots[pos] = slots.back();
+        positions[slots[pos].oid] = pos;
+    }
+    slots.pop_back();
+}
+
+}  // namespace cirrus
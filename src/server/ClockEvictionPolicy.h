@@ -0,0 +1,73 @@
+#ifndef SRC_SERVER_CLOCKEVICTIONPOLICY_H_
+#define SRC_SERVER_CLOCKEVICTIONPOLICY_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace cirrus {
+
+/**
+  * CLOCK approximation of LRU, used by the server to pick the objects to
+  * evict when it runs as a cache.
+  * Objects sit on a circular list with a reference bit that is set when
+  * they are written or read. To find a victim the hand sweeps the list,
+  * clearing reference bits, and stops at the first object whose bit is
+  * already clear. Accesses only set a bit, so they stay O(1) and do not
+  * reorder anything.
+  * Not thread safe.
+  */
+class ClockEvictionPolicy {
+ public:
+    /**
+      * Tracks an object, or marks it as referenced if already tracked.
+      * @param oid the id of the object
+      */
+    void insert(uint64_t oid);
+
+    /**
+      * Marks an object as referenced. Does nothing if not tracked.
+      * @param oid the id of the object
+      */
+    void touch(uint64_t oid);
+
+    /**
+      * Stops tracking an object. Does nothing if not tracked.
+      * @param oid the id of the object
+      */
+    void remove(uint64_t oid);
+
+    /**
+      * Picks the next object to evict and stops tracking it.
+      * @param oid set to the id of the victim
+      * @param keep id of an object that must not be picked
+      * @return false if there is no object to pick
+      */
+    bool next_victim(uint64_t* oid, uint64_t keep);
+
+    /**
+      * @return number of objects tracked
+      */
+    uint64_t size() const {
+        return slots.size();
+    }
+
+ private:
+    struct Slot {
+        uint64_t oid;
+        bool referenced;
+    };
+
+    void remove_slot(uint64_t pos);
+
+    /** The circular list. Removed slots are filled with the last one. */
+    std::vector<Slot> slots;
+    /** Position of every object in slots. */
+    std::unordered_map<uint64_t, uint64_t> positions;
+    /** Position of the hand in slots. */
+    uint64_t hand = 0;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_CLOCKEVICTIONPOLICY_H_
@@ -0,0 +1,192 @@
+#ifndef SRC_SERVER_FLATINDEX_H_
+#define SRC_SERVER_FLATINDEX_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace cirrus {
+
+/**
+  * Map from object ids to pointers, kept in a single array with open
+  * addressing and linear probing. Unlike std::unordered_map there is no
+  * node per object: a lookup touches one or two cache lines and inserts
+  * do not allocate, except when the array grows.
+  * Value is a pointer or a smart pointer: an empty value marks an empty
+  * slot, so empty values cannot be stored.
+  * Removals shift the following entries back, there are no tombstones.
+  * Not thread safe.
+  */
+template <typename Value>
+class FlatIndex {
+ public:
+    using Entry = std::pair<uint64_t, Value>;
+
+    /** Iterator over the entries in use, in no particular order. */
+    class const_iterator {
+     public:
+        const_iterator(const Entry* pos, const Entry* end) :
+            pos(pos), end(end) {
+            skip_empty();
+        }
+
+        const Entry& operator*() const {
+            return *pos;
+        }
+
+        const Entry* operator->() const {
+            return pos;
+        }
+
+        const_iterator& operator++() {
+            ++pos;
+            skip_empty();
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return pos == other.pos;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return pos != other.pos;
+        }
+
+     private:
+        void skip_empty() {
+            while (pos != end && !pos->second) {
+                ++pos;
+            }
+        }
+
+        const Entry* pos;
+        const Entry* end;
+    };
+
+    /**
+      * Constructor.
+      * @param capacity number of slots to start with, a power of two
+      */
+    explicit FlatIndex(uint64_t capacity = 1024) :
+        entries(capacity), mask(capacity - 1) {}
+
+    uint64_t size() const {
+        return count;
+    }
+
+    const_iterator begin() const {
+        return const_iterator(entries.data(),
+                entries.data() + entries.size());
+    }
+
+    const_iterator end() const {
+        const Entry* last = entries.data() + entries.size();
+        return const_iterator(last, last);
+    }
+
+    /**
+      * Finds the entry of an object.
+      * @param oid the id of the object
+      * @return iterator to the entry, end() if there is none
+      */
+    const_iterator find(uint64_t oid) const {
+        const Entry* entry = find_entry(oid);
+        if (!entry) {
+            return end();
+        }
+        return const_iterator(entry, entries.data() + entries.size());
+    }
+
+    /**
+      * Sets the value of an object.
+      * @param oid the id of the object
+      * @param value the value, not empty
+      * @return the previous value of the object, empty if there was none
+      */
+    Value assign(uint64_t oid, Value value) {
+        // At most three quarters of the slots are used
+        if ((count + 1) * 4 > entries.size() * 3) {
+            grow();
+        }
+        uint64_t i = home(oid);
+        while (entries[i].second) {
+            if (entries[i].first == oid) {
+                std::swap(entries[i].second, value);
+                return value;
+            }
+            i = (i + 1) & mask;
+        }
+        entries[i].first = oid;
+        entries[i].second = std::move(value);
+        count++;
+        return Value();
+    }
+
+    /**
+      * Removes the entry of an object.
+      * @param oid the id of the object
+      * @return the value of the object, empty if there was none
+      */
+    Value erase(uint64_t oid) {
+        Entry* entry = const_cast<Entry*>(find_entry(oid));
+        if (!entry) {
+            return Value();
+        }
+        Value value = std::move(entry->second);
+        entry->second = Value();
+        count--;
+
+        // Moves back the entries that would not be found past the hole
+        uint64_t hole = entry - entries.data();
+        for (uint64_t i = (hole + 1) & mask; entries[i].second;
+                i = (i + 1) & mask) {
+            uint64_t slot = home(entries[i].first);
+            // Entries whose slot is cyclically in (hole, i] stay
+            bool stays = hole <= i ? (slot > hole && slot <= i) :
+                                     (slot > hole || slot <= i);
+            if (!stays) {
+                entries[hole] = std::move(entries[i]);
+                entries[i].second = Value();
+                hole = i;
+            }
+        }
+        return value;
+    }
+
+ private:
+    /** Slot an object is looked up from. Ids are often sequential. */
+    uint64_t home(uint64_t oid) const {
+        return (oid * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+    }
+
+    const Entry* find_entry(uint64_t oid) const {
+        for (uint64_t i = home(oid); entries[i].second; i = (i + 1) & mask) {
+            if (entries[i].first == oid) {
+                return &entries[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void grow() {
+        std::vector<Entry> old(entries.size() * 2);
+        old.swap(entries);
+        mask = entries.size() - 1;
+        count = 0;
+        for (auto& entry : old) {
+            if (entry.second) {
+                assign(entry.first, std::move(entry.second));
+            }
+        }
+    }
+
+    std::vector<Entry> entries;
+    /** Number of slots minus one, the number of slots is a power of two. */
+    uint64_t mask;
+    /** Number of slots in use. */
+    uint64_t count = 0;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_FLATINDEX_H_
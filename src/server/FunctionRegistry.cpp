@@ -0,0 +1,53 @@
+#include "server/FunctionRegistry.h"
+
+#include <dlfcn.h>
+#include <stdexcept>
+#include "utils/logging.h"
+
+namespace cirrus {
+
+FunctionRegistry::~FunctionRegistry() {
+    for (auto handle : handles) {
+        dlclose(handle);
+    }
+}
+
+void FunctionRegistry::load(const std::string& path) {
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        throw std::runtime_error("Error loading plugin " + path + ": " +
+                dlerror());
+    }
+
+    auto getter = reinterpret_cast<NearDataFunctionsGetter>(
+            dlsym(handle, near_data_functions_symbol));
+    if (!getter) {
+        dlclose(handle);
+        throw std::runtime_error("Plugin " + path + " does not define " +
+                near_data_functions_symbol);
+    }
+
+    uint64_t count = 0;
+    const NearDataFunctionEntry* entries = getter(&count);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (functions.find(entries[i].name) != functions.end()) {
+            dlclose(handle);
+            throw std::runtime_error("Function " +
+                    std::string(entries[i].name) + " of plugin " + path +
+                    " is already defined");
+        }
+    }
+    // Registered only once every name is known to be free
+    for (uint64_t i = 0; i < count; ++i) {
+        LOG<INFO>("Registering function ", entries[i].name, " of ", path);
+        functions[entries[i].name] = entries[i].function;
+    }
+    handles.push_back(handle);
+}
+
+NearDataFunction FunctionRegistry::find(const std::string& name) const {
+    auto it = functions.find(name);
+    return it == functions.end() ? nullptr : it->second;
+}
+
+}  // namespace cirrus
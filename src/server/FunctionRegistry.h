@@ -0,0 +1,49 @@
+#ifndef SRC_SERVER_FUNCTIONREGISTRY_H_
+#define SRC_SERVER_FUNCTIONREGISTRY_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "server/NearDataFunction.h"
+
+namespace cirrus {
+
+/**
+  * Functions the server runs on objects for clients, loaded from
+  * plugins (see NearDataFunction.h).
+  * Plugins are loaded before the server starts and stay loaded until
+  * the registry is destroyed.
+  */
+class FunctionRegistry {
+ public:
+    FunctionRegistry() = default;
+    ~FunctionRegistry();
+
+    FunctionRegistry(const FunctionRegistry&) = delete;
+    FunctionRegistry& operator=(const FunctionRegistry&) = delete;
+
+    /**
+      * Loads a plugin and registers its functions.
+      * Throws std::runtime_error if the plugin cannot be loaded or
+      * defines a function that is already registered.
+      * @param path path of the shared object
+      */
+    void load(const std::string& path);
+
+    /**
+      * Finds a function.
+      * @param name the name of the function
+      * @return the function, nullptr if no plugin defines it
+      */
+    NearDataFunction find(const std::string& name) const;
+
+ private:
+    /** Handles of the plugins loaded. */
+    std::vector<void*> handles;
+    /** Functions of the plugins, by name. */
+    std::unordered_map<std::string, NearDataFunction> functions;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_FUNCTIONREGISTRY_H_
@@ -0,0 +1,497 @@
+#include "server/LogStorageBackend.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "utils/logging.h"
+
+namespace cirrus {
+
+static const uint32_t record_magic = 0x53474f4c;  // "LOGS"
+static const uint64_t record_alignment = 8;
+static const char segment_prefix[] = "segment-";
+static const char segment_suffix[] = ".log";
+
+LogStorageBackend::Segment::Segment(uint64_t id, const std::string& file,
+        uint64_t capacity, bool create) :
+    id(id), file(file), capacity(capacity) {
+    fd = open(file.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR,
+            0644);
+    if (fd < 0) {
+        throw std::runtime_error("Error opening log segment " + file);
+    }
+
+    if (create) {
+        // Sparse file, blocks are allocated as records are written
+        if (ftruncate(fd, capacity) != 0) {
+            throw std::runtime_error("Error sizing log segment " + file);
+        }
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            throw std::runtime_error("Error reading log segment " + file);
+        }
+        this->capacity = st.st_size;
+    }
+
+    if (this->capacity > 0) {
+        map = mmap(nullptr, this->capacity, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            throw std::runtime_error("Error mapping log segment " + file);
+        }
+    }
+}
+
+LogStorageBackend::Segment::~Segment() {
+    if (map != nullptr) {
+        munmap(map, capacity);
+    }
+    close(fd);
+    if (remove) {
+        unlink(file.c_str());
+    }
+}
+
+LogStorageBackend::LogStorageBackend(const std::string& path,
+        uint64_t segment_size, double compaction_ratio) :
+    path(path), segment_size(segment_size),
+    compaction_ratio(compaction_ratio) {}
+
+LogStorageBackend::~LogStorageBackend() {
+    terminate = true;
+    compactor_cv.notify_all();
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+}
+
+void LogStorageBackend::init() {
+    recover();
+    compactor = std::thread(&LogStorageBackend::compaction_loop, this);
+}
+
+/**
+  * Records are aligned so that headers can be read in place.
+  */
+uint64_t LogStorageBackend::record_size(uint64_t size) {
+    uint64_t bytes = sizeof(RecordHeader) + size;
+    return (bytes + record_alignment - 1) & ~(record_alignment - 1);
+}
+
+std::string LogStorageBackend::segment_file(uint64_t id) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%s%020" PRIu64 "%s",
+            segment_prefix, id, segment_suffix);
+    return path + "/" + name;
+}
+
+/**
+  * Opens the segments found in the log directory and rebuilds the index
+  * by replaying them in order.
+  */
+void LogStorageBackend::recover() {
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Error creating log directory " + path);
+    }
+
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        throw std::runtime_error("Error opening log directory " + path);
+    }
+    std::vector<uint64_t> ids;
+    while (struct dirent* entry = readdir(dir)) {
+        uint64_t id;
+        char suffix[8];
+        if (sscanf(entry->d_name, "segment-%" SCNu64 "%7s", &id, suffix) == 2 &&
+            std::string(suffix) == segment_suffix) {
+            ids.push_back(id);
+        }
+    }
+    closedir(dir);
+    std::sort(ids.begin(), ids.end());
+
+    for (const auto& id : ids) {
+        auto segment = std::make_shared<Segment>(id, segment_file(id), 0,
+                false);
+        segments.resize(id + 1);
+        segments[id] = segment;
+        scan(segment.get());
+        active = segment.get();
+    }
+
+    LOG<INFO>("Recovered ", index.size(), " objects from ",
+            ids.size(), " log segments in ", path);
+}
+
+/**
+  * Applies the records of a segment to the index.
+  * The segment ends at the first record that is not complete.
+  */
+void LogStorageBackend::scan(Segment* segment) {
+    uint64_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= segment->capacity) {
+        RecordHeader header;
+        std::memcpy(&header, segment->data() + offset, sizeof(header));
+        uint64_t bytes = record_size(header.size);
+        if (header.magic != record_magic ||
+            offset + bytes > segment->capacity) {
+            break;
+        }
+
+        Location loc = {static_cast<uint32_t>(segment->id), 0, offset,
+            header.size};
+        auto it = index.find(header.oid);
+        auto tombstone = tombstones.find(header.oid);
+        if (it != index.end()) {
+            // The previous record of the object is dead
+            loc.dead_puts = it->second.dead_puts + 1;
+            drop(it->second);
+            index.erase(it);
+        } else if (tombstone != tombstones.end()) {
+            // A put makes the delete before useless. A copy of a delete
+            // made by a compaction replaces it
+            loc.dead_puts = tombstone->second.dead_puts;
+            drop(tombstone->second);
+            tombstones.erase(tombstone);
+        } else if (header.type == kDelete) {
+            // Nothing left to delete
+            offset += bytes;
+            continue;
+        }
+        if (header.type == kPut) {
+            index[header.oid] = loc;
+        } else {
+            tombstones[header.oid] = loc;
+        }
+        segment->live_bytes += bytes;
+        offset += bytes;
+    }
+    segment->length = offset;
+}
+
+/**
+  * Finds room for a record at the end of the log. Starts a new segment
+  * when the active one is full.
+  * Must be called with lock held.
+  * @param bytes size of the record
+  * @return the segment to append to
+  */
+LogStorageBackend::Segment* LogStorageBackend::reserve(uint64_t bytes) {
+    if (active && active->length + bytes <= active->capacity) {
+        return active;
+    }
+
+    if (active) {
+        // Seal the active segment, the rest of the file is never used
+        if (ftruncate(active->fd, active->length) != 0) {
+            LOG<ERROR>("Error truncating log segment ", active->file);
+        }
+    }
+
+    uint64_t id = segments.size();
+    auto segment = std::make_shared<Segment>(id, segment_file(id),
+            std::max(segment_size, bytes), true);
+    segments.push_back(segment);
+    active = segment.get();
+    compactor_cv.notify_one();
+    return active;
+}
+
+/**
+  * Appends a record to the log.
+  * Must be called with lock held.
+  * @return the location of the record
+  */
+LogStorageBackend::Location LogStorageBackend::append(uint32_t type,
+        uint64_t oid, const char* data, uint64_t size) {
+    uint64_t bytes = record_size(size);
+    Segment* segment = reserve(bytes);
+
+    RecordHeader header = {record_magic, type, oid, size};
+    static const char padding[record_alignment] = {0};
+    struct iovec iov[3];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = const_cast<char*>(data);
+    iov[1].iov_len = size;
+    iov[2].iov_base = const_cast<char*>(padding);
+    iov[2].iov_len = bytes - sizeof(header) - size;
+
+    ssize_t written = pwritev(segment->fd, iov, 3, segment->length);
+    if (written != static_cast<ssize_t>(bytes)) {
+        throw std::runtime_error("Error writing to log segment " +
+                segment->file);
+    }
+
+    Location loc = {static_cast<uint32_t>(segment->id), 0,
+        segment->length, size};
+    segment->length += bytes;
+    segment->live_bytes += bytes;
+    return loc;
+}
+
+/**
+  * Marks the record at a location as dead.
+  * Must be called with lock held.
+  */
+void LogStorageBackend::drop(const Location& loc) {
+    segments[loc.segment]->live_bytes -= record_size(loc.size);
+}
+
+/**
+  * Accounts for a dead put record of an object going away with its
+  * segment. The delete record of the object dies with the last one.
+  * Must be called with lock held.
+  * @param oid the id of the object
+  */
+void LogStorageBackend::forget_dead_put(uint64_t oid) {
+    auto it = index.find(oid);
+    if (it != index.end()) {
+        it->second.dead_puts--;
+        return;
+    }
+    auto tombstone = tombstones.find(oid);
+    if (tombstone != tombstones.end() &&
+        --tombstone->second.dead_puts == 0) {
+        drop(tombstone->second);
+        tombstones.erase(tombstone);
+    }
+}
+
+/**
+  * Returns a slice of the object at a location, read from the mapping
+  * of its segment.
+  * Must be called with lock held.
+  */
+MemSlice LogStorageBackend::slice(const Location& loc) const {
+    const auto& segment = segments[loc.segment];
+    const char* begin = segment->data() + loc.offset + sizeof(RecordHeader);
+    return MemSlice(segment, begin, begin + loc.size);
+}
+
+bool LogStorageBackend::put(uint64_t oid, const MemSlice& data) {
+    uint64_t old_size;
+    return upsert(oid, data, &old_size);
+}
+
+bool LogStorageBackend::exists(uint64_t oid) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return index.find(oid) != index.end();
+}
+
+MemSlice LogStorageBackend::get(uint64_t oid) const {
+    LookupResult result = lookup(oid);
+    if (!result.found) {
+        throw std::runtime_error(
+                "LogStorageBackend get() called on nonexistent id");
+    }
+
+    return result.data;
+}
+
+bool LogStorageBackend::delet(uint64_t oid) {
+    uint64_t old_size;
+    return erase(oid, &old_size);
+}
+
+uint64_t LogStorageBackend::size(uint64_t oid) const {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(oid);
+    if (it == index.end()) {
+        return 0;
+    }
+
+    return it->second.size;
+}
+
+StorageBackend::LookupResult LogStorageBackend::lookup(uint64_t oid) const {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(oid);
+    if (it == index.end()) {
+        return {false, MemSlice()};
+    }
+
+    return {true, slice(it->second)};
+}
+
+bool LogStorageBackend::upsert(uint64_t oid, const MemSlice& data,
+        uint64_t* old_size) {
+    std::lock_guard<std::mutex> guard(lock);
+    Location loc = append(kPut, oid, data.data(), data.size());
+
+    auto res = index.emplace(oid, loc);
+    if (res.second) {
+        *old_size = 0;
+        // The delete of the object is not needed after this put
+        auto tombstone = tombstones.find(oid);
+        if (tombstone != tombstones.end()) {
+            res.first->second.dead_puts = tombstone->second.dead_puts;
+            drop(tombstone->second);
+            tombstones.erase(tombstone);
+        }
+    } else {
+        *old_size = res.first->second.size;
+        loc.dead_puts = res.first->second.dead_puts + 1;
+        drop(res.first->second);
+        res.first->second = loc;
+    }
+    return true;
+}
+
+bool LogStorageBackend::erase(uint64_t oid, uint64_t* old_size) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(oid);
+    if (it == index.end()) {
+        return false;
+    }
+
+    // The delete must be logged or recovery would bring the object back
+    Location loc = append(kDelete, oid, nullptr, 0);
+    loc.dead_puts = it->second.dead_puts + 1;
+    tombstones[oid] = loc;
+    *old_size = it->second.size;
+    drop(it->second);
+    index.erase(it);
+    return true;
+}
+
+bool LogStorageBackend::list_range(uint64_t first, uint64_t last,
+        std::vector<uint64_t>* oids) const {
+    std::lock_guard<std::mutex> guard(lock);
+    list_index_range(index, first, last, oids);
+    return true;
+}
+
+/**
+  * Reports the bytes of the segments, including the records compaction
+  * has not dropped yet, and the bytes of the objects.
+  */
+bool LogStorageBackend::memory_stats(MemoryStats* stats) const {
+    std::lock_guard<std::mutex> guard(lock);
+    stats->bytes_used = 0;
+    for (const auto& segment : segments) {
+        if (segment) {
+            stats->bytes_used += segment->length;
+        }
+    }
+    stats->bytes_requested = 0;
+    for (const auto& entry : index) {
+        stats->bytes_requested += entry.second.size;
+    }
+    stats->fragmentation = stats->bytes_used == 0 ? 0 :
+        1 - static_cast<double>(stats->bytes_requested) / stats->bytes_used;
+    return true;
+}
+
+/**
+  * Loop run by the compaction thread. Compacts the sealed segment with the
+  * lowest fraction of live bytes, as long as it is below compaction_ratio.
+  */
+void LogStorageBackend::compaction_loop() {
+    while (!terminate) {
+        int64_t victim = -1;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            double min_ratio = compaction_ratio;
+            for (const auto& segment : segments) {
+                if (!segment || segment.get() == active ||
+                    segment->length == 0) {
+                    continue;
+                }
+                double ratio =
+                    static_cast<double>(segment->live_bytes) / segment->length;
+                if (ratio < min_ratio) {
+                    min_ratio = ratio;
+                    victim = segment->id;
+                }
+            }
+        }
+
+        if (victim >= 0) {
+            compact(victim);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(compactor_lock);
+        compactor_cv.wait_for(guard, std::chrono::seconds(1));
+    }
+}
+
+/**
+  * Copies the live records of a segment to the end of the log and deletes
+  * the segment. The lock is taken for each record so that requests are
+  * served during compaction.
+  * @param id the id of the segment
+  */
+void LogStorageBackend::compact(uint32_t id) {
+    std::shared_ptr<Segment> victim;
+    uint64_t first_new;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        victim = segments[id];
+        first_new = active->id;
+    }
+    LOG<INFO>("Compacting log segment ", victim->file);
+
+    uint64_t offset = 0;
+    while (offset < victim->length && !terminate) {
+        RecordHeader header;
+        std::memcpy(&header, victim->data() + offset, sizeof(header));
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (header.type == kPut) {
+            // Only the last record of an object is live
+            auto it = index.find(header.oid);
+            if (it != index.end() && it->second.segment == id &&
+                it->second.offset == offset) {
+                Location loc = append(kPut, header.oid,
+                        victim->data() + offset + sizeof(header),
+                        header.size);
+                loc.dead_puts = it->second.dead_puts;
+                drop(it->second);
+                it->second = loc;
+            } else {
+                forget_dead_put(header.oid);
+            }
+        } else {
+            // Only the delete records still needed are tombstones
+            auto tombstone = tombstones.find(header.oid);
+            if (tombstone != tombstones.end() &&
+                tombstone->second.segment == id &&
+                tombstone->second.offset == offset) {
+                Location loc = append(kDelete, header.oid, nullptr, 0);
+                loc.dead_puts = tombstone->second.dead_puts;
+                drop(tombstone->second);
+                tombstone->second = loc;
+            }
+        }
+        offset += record_size(header.size);
+    }
+    if (terminate) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    // The copies must be on disk before the segment goes away
+    for (uint64_t i = first_new; i < segments.size(); ++i) {
+        if (segments[i]) {
+            fdatasync(segments[i]->fd);
+        }
+    }
+    // The file is deleted once no slice points to the segment anymore
+    victim->remove = true;
+    segments[id].reset();
+}
+
+}  // namespace cirrus
@@ -0,0 +1,149 @@
+#ifndef SRC_SERVER_LOGSTORAGEBACKEND_H_
+#define SRC_SERVER_LOGSTORAGEBACKEND_H_
+
+#include "StorageBackend.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cirrus {
+
+/**
+  * Key-value store backed by an append-only log on disk.
+  * The log is a sequence of segment files. Writes and deletes are appended
+  * to the last segment; an in-memory index maps every object to its last
+  * record. Segments are memory-mapped, so reads are served from the page
+  * cache without copying the object.
+  * A background thread compacts segments where most records are dead by
+  * copying the live records to the end of the log. The delete record of
+  * an object is live only while earlier records of the object are still
+  * in the log, as recovery would bring the object back without it.
+  * On init() the index is rebuilt by scanning the segments in order.
+  * Writes are not synced: the kernel writes the pages back.
+  */
+class LogStorageBackend : public StorageBackend {
+ public:
+    /**
+      * Constructor.
+      * @param path directory of the segment files
+      * @param segment_size size of a segment. Larger objects get a
+      * segment of their own
+      * @param compaction_ratio segments with a smaller fraction of live
+      * bytes are compacted
+      */
+    explicit LogStorageBackend(const std::string& path,
+            uint64_t segment_size = 256 * 1024 * 1024,
+            double compaction_ratio = 0.5);
+    virtual ~LogStorageBackend();
+
+    void init() override;
+    bool put(uint64_t oid, const MemSlice& data) override;
+    bool exists(uint64_t oid) const override;
+    MemSlice get(uint64_t oid) const override;
+    bool delet(uint64_t oid) override;
+    uint64_t size(uint64_t oid) const override;
+    LookupResult lookup(uint64_t oid) const override;
+    bool upsert(uint64_t oid, const MemSlice& data,
+            uint64_t* old_size) override;
+    bool erase(uint64_t oid, uint64_t* old_size) override;
+    bool list_range(uint64_t first, uint64_t last,
+            std::vector<uint64_t>* oids) const override;
+    bool memory_stats(MemoryStats* stats) const override;
+
+ private:
+    /** Header of every record in a segment. */
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t type;   //< kPut or kDelete
+        uint64_t oid;
+        uint64_t size;   //< size of the data following the header
+    };
+
+    enum RecordType : uint32_t {
+        kPut = 1,
+        kDelete = 2
+    };
+
+    /**
+      * A segment file, mapped in memory. Slices returned by get() keep
+      * their segment mapped, even after it is compacted.
+      */
+    struct Segment {
+        Segment(uint64_t id, const std::string& file, uint64_t capacity,
+                bool create);
+        ~Segment();
+
+        const char* data() const {
+            return static_cast<const char*>(map);
+        }
+
+        uint64_t id;
+        std::string file;
+        int fd = -1;
+        void* map = nullptr;
+        uint64_t capacity;
+        /** Bytes written to the segment. */
+        uint64_t length = 0;
+        /** Bytes of the records that are still the last of their object. */
+        uint64_t live_bytes = 0;
+        /** Whether the file is deleted once the segment goes away. */
+        bool remove = false;
+    };
+
+    /** Position of the last record of an object. */
+    struct Location {
+        uint32_t segment;
+        /** Earlier put records of the object still in the log. */
+        uint32_t dead_puts;
+        uint64_t offset;  //< offset of the record in the segment
+        uint64_t size;    //< size of the object, 0 for a delete record
+    };
+
+    static uint64_t record_size(uint64_t size);
+
+    std::string segment_file(uint64_t id) const;
+    void recover();
+    void scan(Segment* segment);
+    Segment* reserve(uint64_t bytes);
+    Location append(uint32_t type, uint64_t oid, const char* data,
+            uint64_t size);
+    void drop(const Location& loc);
+    void forget_dead_put(uint64_t oid);
+    MemSlice slice(const Location& loc) const;
+
+    void compaction_loop();
+    void compact(uint32_t id);
+
+    std::string path;
+    const uint64_t segment_size;
+    const double compaction_ratio;
+
+    /** Segments by id. Compacted segments are null. */
+    std::vector<std::shared_ptr<Segment>> segments;
+    /** Segment writes are appended to. */
+    Segment* active = nullptr;
+
+    std::unordered_map<uint64_t, Location> index;
+    /**
+      * Delete records of the objects removed that are still live, as
+      * earlier records of the objects are still in the log.
+      */
+    std::unordered_map<uint64_t, Location> tombstones;
+
+    /** Protects the segments, the index and the tombstones. */
+    mutable std::mutex lock;
+
+    std::thread compactor;
+    std::atomic<bool> terminate = {false};
+    std::condition_variable compactor_cv;
+    std::mutex compactor_lock;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_LOGSTORAGEBACKEND_H_
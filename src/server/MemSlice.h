@@ -2,6 +2,7 @@
 #define SRC_SERVER_MEMSLICE_H_
 
 #include <iterator>
+#include <memory>
 #include <string>
 #include <vector>
 #include "utils/logging.h"
@@ -13,44 +14,82 @@ namespace cirrus {
   * memory and storage backends
   * We explicitly track types here to avoid expensive memory allocations
   * that are required to achieve polymorphism
+  * A slice can optionally share ownership of the memory it points to
+  * (see owner_). This lets the server hand backend memory to the socket
+  * without copying it and without it going away while it is being sent.
   */
 class MemSlice {
  public:
+    /**
+      * Construct an empty slice
+      */
+    MemSlice() :
+        dataStdVector_(nullptr), dataFbVector_(nullptr),
+        begin(nullptr), end(nullptr)
+    {}
+
     /**
       * Construct a mem slice from a std::string
-      * we copy the string into a new vector
+      * we copy the string into a new vector owned by the slice
       */
     explicit MemSlice(const std::string& data) :
-        dataFbVector_(nullptr), begin(nullptr), end(nullptr), fromString(true) {
-        dataStdVector_ = new std::vector<int8_t>(data.size());
+        dataFbVector_(nullptr), begin(nullptr), end(nullptr) {
+        auto vec = std::make_shared<std::vector<int8_t>>(
+                data.begin(), data.end());
+        dataStdVector_ = vec.get();
+        owner_ = std::move(vec);
+    }
 
-        // copy contents over
-        std::memcpy(const_cast<void*>(
-                    reinterpret_cast<const void*>(dataStdVector_->data())),
-                data.data(), data.size());
+    /**
+      * Construct a mem slice from a std::string
+      * the slice takes the string over, without copying it
+      */
+    explicit MemSlice(std::string&& data) :
+        dataStdVector_(nullptr), dataFbVector_(nullptr) {
+        auto str = std::make_shared<std::string>(std::move(data));
+        begin = str->data();
+        end = str->data() + str->size();
+        owner_ = std::move(str);
     }
 
     MemSlice(const std::vector<int8_t>* data) :
         dataStdVector_(data), dataFbVector_(nullptr),
-        begin(nullptr), end(nullptr), fromString(false)
+        begin(nullptr), end(nullptr)
     {}
 
     explicit MemSlice(const flatbuffers::Vector<int8_t>* data) :
         dataStdVector_(nullptr), dataFbVector_(data),
-        begin(nullptr), end(nullptr), fromString(false)
+        begin(nullptr), end(nullptr)
     {}
 
     MemSlice(const char* begin, const char* end) :
         dataStdVector_(nullptr), dataFbVector_(nullptr),
-        begin(begin), end(end), fromString(false)
+        begin(begin), end(end)
+    {}
+
+    /**
+      * Construct a slice over [begin, end) that keeps owner alive
+      * for as long as the slice (or any copy of it) exists
+      * @param owner Object that owns the memory
+      * @param begin Pointer to the first byte
+      * @param end Pointer to one past the last byte
+      */
+    MemSlice(std::shared_ptr<const void> owner,
+            const char* begin, const char* end) :
+        dataStdVector_(nullptr), dataFbVector_(nullptr),
+        begin(begin), end(end), owner_(std::move(owner))
     {}
 
-    ~MemSlice() {
-        /**
-          * We have to free this vector if we built this slice from a string
-          */
-        if (fromString)
-            delete dataStdVector_;
+    /** Pointer to the first byte of the slice
+      */
+    const char* data() const {
+        if (dataStdVector_) {
+            return reinterpret_cast<const char*>(dataStdVector_->data());
+        } else if (dataFbVector_) {
+            return reinterpret_cast<const char*>(dataFbVector_->data());
+        } else {
+            return begin;
+        }
     }
 
     /** Translate MemSlice to a string
@@ -78,6 +117,15 @@ class MemSlice {
         return s;
     }
 
+    /** Slice over part of this slice, sharing its owner
+      * @param offset Offset of the first byte
+      * @param length Number of bytes, offset + length must not exceed size()
+      */
+    MemSlice sub(uint64_t offset, uint64_t length) const {
+        const char* first = data() + offset;
+        return MemSlice(owner_, first, first + length);
+    }
+
     uint64_t size() const {
         if (dataStdVector_) {
             return dataStdVector_->size() * sizeof(int8_t);
@@ -86,7 +134,7 @@ class MemSlice {
         } else if (begin && end) {
             return std::distance(begin, end);
         } else {
-            throw std::runtime_error("Error in size()");
+            return 0;
         }
     }
 
@@ -111,7 +159,7 @@ class MemSlice {
     const flatbuffers::Vector<int8_t>* dataFbVector_;
     const char* begin, *end;  //< being and end (exclusive) pointers to data
 
-    bool fromString;  //< indicates whether slice contents came from string
+    std::shared_ptr<const void> owner_;  //< keeps the data alive (if set)
 };
 
 }  // namespace cirrus
@@ -1,52 +1,536 @@
 #include "MemoryBackend.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
+#include <mutex>
+#include <thread>
 #include <malloc.h>
 #include "server/MemoryBackend.h"
 
 namespace cirrus {
 
-MemoryBackend::MemoryBackend(uint64_t bytes) : remove_increment(bytes) {}
+/**
+  * Snapshot file format:
+  * | SnapshotHeader | offset of every record (8 bytes each) | records |
+  * Every record is a SnapshotRecord followed by the data of the object,
+  * padded to 8 bytes.
+  */
+struct SnapshotHeader {
+    uint64_t magic;
+    uint64_t num_objects;
+};
+
+struct SnapshotRecord {
+    uint64_t oid;
+    uint64_t size;
+};
+
+static const uint64_t snapshot_magic = 0x50414e5353524943;  // "CIRSSNAP"
+static const uint64_t snapshot_buffer_size = 1024 * 1024;
+
+static uint64_t snapshot_record_size(uint64_t size) {
+    return (sizeof(SnapshotRecord) + size + 7) & ~7ULL;
+}
+
+MemoryBackend::Object::Object(const char* data, uint64_t size,
+        uint64_t inline_threshold) : size_(size),
+    inline_(size <= inline_threshold) {
+    if (inline_) {
+        std::copy(data, data + size, bytes);
+    } else {
+        new (&buffer) std::shared_ptr<const std::vector<int8_t>>(
+                std::make_shared<const std::vector<int8_t>>(
+                    data, data + size));
+    }
+}
+
+MemoryBackend::Object::Object(const Object& other) : size_(other.size_),
+    inline_(other.inline_) {
+    if (inline_) {
+        std::copy(other.bytes, other.bytes + size_, bytes);
+    } else {
+        new (&buffer) std::shared_ptr<const std::vector<int8_t>>(
+                other.buffer);
+    }
+}
+
+MemoryBackend::Object::Object(Object&& other) noexcept : Object() {
+    swap(other);
+}
+
+MemoryBackend::Object& MemoryBackend::Object::operator=(Object other)
+        noexcept {
+    swap(other);
+    return *this;
+}
+
+MemoryBackend::Object::~Object() {
+    if (!inline_) {
+        buffer.~shared_ptr();
+    }
+}
+
+void MemoryBackend::Object::swap(Object& other) noexcept {
+    if (inline_ && other.inline_) {
+        std::swap(bytes, other.bytes);
+    } else if (!inline_ && !other.inline_) {
+        buffer.swap(other.buffer);
+    } else {
+        Object& in = inline_ ? *this : other;
+        Object& out = inline_ ? other : *this;
+        auto moved = std::move(out.buffer);
+        out.buffer.~shared_ptr();
+        std::copy(in.bytes, in.bytes + in.size_, out.bytes);
+        new (&in.buffer) std::shared_ptr<const std::vector<int8_t>>(
+                std::move(moved));
+    }
+    uint64_t size = size_;
+    bool is_inline = inline_;
+    size_ = other.size_;
+    inline_ = other.inline_;
+    other.size_ = size;
+    other.inline_ = is_inline;
+}
+
+/**
+  * Gets a slice with the data of the object. Inline objects are copied, as
+  * their entry may change once the lock of the shard is released. The copy
+  * and the reference count of the slice take a single allocation.
+  */
+MemSlice MemoryBackend::Object::slice() const {
+    if (inline_) {
+        auto copy = std::make_shared<std::array<char, max_inline_size>>();
+        std::memcpy(copy->data(), bytes, size_);
+        return MemSlice(copy, copy->data(), copy->data() + size_);
+    }
+    const char* begin = reinterpret_cast<const char*>(buffer->data());
+    return MemSlice(buffer, begin, begin + size_);
+}
+
+/**
+  * Gives access to the bytes of the object, to modify them in place.
+  * Buffers still referenced by a slice (e.g. a reply being sent or a
+  * snapshot) are copied first, so that the slice keeps seeing the object
+  * as it was.
+  */
+char* MemoryBackend::Object::mutable_data() {
+    if (inline_) {
+        return bytes;
+    }
+    if (buffer.use_count() > 1) {
+        buffer = std::make_shared<const std::vector<int8_t>>(*buffer);
+    }
+    // The buffer is only const towards the slices sharing it
+    return reinterpret_cast<char*>(
+            const_cast<std::vector<int8_t>&>(*buffer).data());
+}
+
+/**
+  * Overwrites part of the object in place.
+  */
+void MemoryBackend::Object::write(uint64_t offset, const MemSlice& data) {
+    std::copy(data.data(), data.data() + data.size(),
+            mutable_data() + offset);
+}
+
+MemoryBackend::MemoryBackend(uint64_t bytes, uint64_t inline_threshold) :
+    remove_increment(bytes),
+    inline_threshold(std::min(inline_threshold, max_inline_size)) {}
 
 void MemoryBackend::init() {}
 
+/**
+  * Finds the index of the shard of an object. Ids are mixed first, so that
+  * consecutive ids are spread over all the shards.
+  */
+uint64_t MemoryBackend::shard_index(uint64_t oid) {
+    uint64_t hash = oid * 0x9e3779b97f4a7c15ULL;
+    return hash >> 58 & (num_shards - 1);
+}
+
+/**
+  * Finds the shard of an object.
+  */
+MemoryBackend::Shard& MemoryBackend::shard(uint64_t oid) const {
+    return shards[shard_index(oid)];
+}
+
 bool MemoryBackend::put(uint64_t oid, const MemSlice& data) {
-    store[oid] = data.get();
-    return true;
+    uint64_t old_size;
+    return upsert(oid, data, &old_size);
 }
 
 bool MemoryBackend::exists(uint64_t oid) const {
-    return store.find(oid) != store.end();
+    Shard& s = shard(oid);
+    std::shared_lock<std::shared_timed_mutex> guard(s.lock);
+    return s.map.find(oid) != s.map.end();
 }
 
 MemSlice MemoryBackend::get(uint64_t oid) const {
-    auto it = store.find(oid);
-    if (it == store.end()) {
+    LookupResult result = lookup(oid);
+    if (!result.found) {
         throw std::runtime_error(
                 "MemoryBackend get() called on nonexistent id");
     }
 
-    return &it->second;
+    return result.data;
 }
 
 bool MemoryBackend::delet(uint64_t oid) {
-    // we assume object exists
-    remove_counter += store[oid].size();
-    store.erase(oid);
-    if (remove_counter >= remove_increment) {
-        remove_counter %= remove_increment;
-        malloc_trim(0);
-    }
-    return true;
+    uint64_t old_size;
+    return erase(oid, &old_size);
 }
 
 uint64_t MemoryBackend::size(uint64_t oid) const {
-    auto it = store.find(oid);
-    if (it == store.end()) {
+    Shard& s = shard(oid);
+    std::shared_lock<std::shared_timed_mutex> guard(s.lock);
+    auto it = s.map.find(oid);
+    if (it == s.map.end()) {
         return 0;
     }
 
     return it->second.size();
 }
 
+StorageBackend::LookupResult MemoryBackend::lookup(uint64_t oid) const {
+    Shard& s = shard(oid);
+    std::shared_lock<std::shared_timed_mutex> guard(s.lock);
+    auto it = s.map.find(oid);
+    if (it == s.map.end()) {
+        return {false, MemSlice()};
+    }
+
+    // The slice stays valid after the object is replaced or erased
+    return {true, it->second.slice()};
+}
+
+bool MemoryBackend::upsert(uint64_t oid, const MemSlice& data,
+        uint64_t* old_size) {
+    // Copy the data before taking the lock
+    Object object(data.data(), data.size(), inline_threshold);
+
+    Shard& s = shard(oid);
+    {
+        std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+        auto& entry = s.map[oid];
+        *old_size = entry.size();
+        // The old object ends up in object, freed outside the lock
+        std::swap(entry, object);
+    }
+    return true;
+}
+
+bool MemoryBackend::erase(uint64_t oid, uint64_t* old_size) {
+    Object old_object;
+
+    Shard& s = shard(oid);
+    {
+        std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+        auto it = s.map.find(oid);
+        if (it == s.map.end()) {
+            return false;
+        }
+        old_object = std::move(it->second);
+        s.map.erase(it);
+    }
+
+    *old_size = old_object.size();
+    old_object = Object();
+    release(*old_size);
+    return true;
+}
+
+bool MemoryBackend::write_at(uint64_t oid, uint64_t offset,
+        const MemSlice& data, uint64_t* size) {
+    Shard& s = shard(oid);
+    std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+    auto it = s.map.find(oid);
+    if (it == s.map.end()) {
+        return false;
+    }
+    *size = it->second.size();
+    if (offset <= *size && data.size() <= *size - offset) {
+        it->second.write(offset, data);
+    }
+    return true;
+}
+
+bool MemoryBackend::update(uint64_t oid,
+        const std::function<void(char*, uint64_t)>& modify) {
+    Shard& s = shard(oid);
+    std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+    auto it = s.map.find(oid);
+    if (it == s.map.end()) {
+        return false;
+    }
+    modify(it->second.mutable_data(), it->second.size());
+    return true;
+}
+
+/**
+  * Deletes the objects with ids in [first, last]. Ranges wider than the
+  * number of objects stored are deleted by scanning the shards instead of
+  * probing every id.
+  */
+uint64_t MemoryBackend::erase_range(uint64_t first, uint64_t last,
+        uint64_t* old_bytes, std::vector<uint64_t>* erased) {
+    *old_bytes = 0;
+    if (first > last) {
+        return 0;
+    }
+
+    uint64_t num_objects = 0;
+    for (const auto& s : shards) {
+        std::shared_lock<std::shared_timed_mutex> guard(s.lock);
+        num_objects += s.map.size();
+    }
+    if (last - first < num_objects) {
+        return StorageBackend::erase_range(first, last, old_bytes, erased);
+    }
+
+    uint64_t count = 0;
+    for (auto& s : shards) {
+        std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+        for (auto it = s.map.begin(); it != s.map.end();) {
+            if (it->first < first || it->first > last) {
+                ++it;
+                continue;
+            }
+            count++;
+            *old_bytes += it->second.size();
+            if (erased) {
+                erased->push_back(it->first);
+            }
+            it = s.map.erase(it);
+        }
+    }
+    release(*old_bytes);
+    return count;
+}
+
+/**
+  * Lists the objects with ids in [first, last]. Ranges wider than the
+  * number of objects stored are found by scanning the shards instead of
+  * probing every id.
+  */
+bool MemoryBackend::list_range(uint64_t first, uint64_t last,
+        std::vector<uint64_t>* oids) const {
+    if (first > last) {
+        return true;
+    }
+
+    uint64_t num_objects = 0;
+    for (const auto& s : shards) {
+        std::shared_lock<std::shared_timed_mutex> guard(s.lock);
+        num_objects += s.map.size();
+    }
+    if (last - first < num_objects) {
+        for (uint64_t oid = first; ; ++oid) {
+            if (exists(oid)) {
+                oids->push_back(oid);
+            }
+            if (oid == last) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    for (const auto& s : shards) {
+        std::shared_lock<std::shared_timed_mutex> guard(s.lock);
+        list_index_range(s.map, first, last, oids);
+    }
+    return true;
+}
+
+/**
+  * Accounts for memory freed by deletes, returning it to the system every
+  * remove_increment bytes.
+  */
+void MemoryBackend::release(uint64_t bytes) {
+    // Only the thread that crosses the increment trims
+    uint64_t before = remove_counter.fetch_add(bytes);
+    if (before / remove_increment != (before + bytes) / remove_increment) {
+        malloc_trim(0);
+    }
+}
+
+/**
+  * Takes a copy of the store, to be written with write_snapshot() while
+  * the store keeps changing. Shards are copied one at a time, so the copy
+  * is only point-in-time if no thread writes meanwhile.
+  * @return the snapshot
+  */
+MemoryBackend::Snapshot MemoryBackend::snapshot() const {
+    Snapshot result;
+    for (const auto& s : shards) {
+        std::shared_lock<std::shared_timed_mutex> guard(s.lock);
+        result.insert(result.end(), s.map.begin(), s.map.end());
+    }
+    return result;
+}
+
+/**
+  * Writes a snapshot to a file. The file is replaced atomically, so it
+  * always holds a complete snapshot.
+  * @param snapshot the snapshot
+  * @param file path of the file
+  */
+void MemoryBackend::write_snapshot(const Snapshot& snapshot,
+        const std::string& file) {
+    std::string tmp_file = file + ".tmp";
+    FILE* fp = fopen(tmp_file.c_str(), "w");
+    if (fp == nullptr) {
+        throw std::runtime_error("Error creating snapshot " + tmp_file);
+    }
+    std::vector<char> buffer(snapshot_buffer_size);
+    setvbuf(fp, buffer.data(), _IOFBF, buffer.size());
+
+    SnapshotHeader header = {snapshot_magic, snapshot.size()};
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    // The offsets let the objects be loaded in parallel
+    uint64_t offset = sizeof(header) + snapshot.size() * sizeof(uint64_t);
+    for (const auto& entry : snapshot) {
+        ok = ok && fwrite(&offset, sizeof(offset), 1, fp) == 1;
+        offset += snapshot_record_size(entry.second.size());
+    }
+
+    static const char padding[8] = {0};
+    for (const auto& entry : snapshot) {
+        uint64_t size = entry.second.size();
+        uint64_t padding_size =
+            snapshot_record_size(size) - sizeof(SnapshotRecord) - size;
+        SnapshotRecord record = {entry.first, size};
+        ok = ok && fwrite(&record, sizeof(record), 1, fp) == 1 &&
+            (size == 0 || fwrite(entry.second.data(), 1, size, fp) == size) &&
+            fwrite(padding, 1, padding_size, fp) == padding_size;
+    }
+
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp_file.c_str(), file.c_str()) != 0) {
+        unlink(tmp_file.c_str());
+        throw std::runtime_error("Error writing snapshot " + file);
+    }
+}
+
+/**
+  * Loads the objects of a snapshot file into the store. The file is mapped
+  * and the objects are copied out of it by several threads, sorted by
+  * shard, then every thread inserts the objects of its own shards.
+  * Must be called before any object is stored.
+  * @param file path of the file
+  * @param num_threads number of threads copying objects
+  * @return total size of the objects loaded. 0 if there is no snapshot
+  */
+uint64_t MemoryBackend::load_snapshot(const std::string& file,
+        uint64_t num_threads) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        throw std::runtime_error("Error opening snapshot " + file);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<uint64_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        throw std::runtime_error("Corrupted snapshot " + file);
+    }
+    uint64_t file_size = st.st_size;
+    void* map = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Error mapping snapshot " + file);
+    }
+    madvise(map, file_size, MADV_WILLNEED);
+
+    const char* base = static_cast<const char*>(map);
+    SnapshotHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    const uint64_t* offsets =
+        reinterpret_cast<const uint64_t*>(base + sizeof(header));
+    std::atomic<bool> corrupted = {header.magic != snapshot_magic ||
+        header.num_objects >
+            (file_size - sizeof(header)) / sizeof(uint64_t)};
+
+    // Every thread copies a contiguous part of the objects
+    num_threads = std::max<uint64_t>(num_threads, 1);
+    uint64_t per_thread = (header.num_objects + num_threads - 1) / num_threads;
+    // Objects copied by each thread, by shard
+    std::vector<std::vector<Snapshot>> parts(num_threads,
+            std::vector<Snapshot>(num_shards));
+    std::vector<uint64_t> part_bytes(num_threads, 0);
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < num_threads && !corrupted; ++t) {
+        threads.emplace_back([&, t] {
+            uint64_t first = std::min(t * per_thread, header.num_objects);
+            uint64_t last = std::min(first + per_thread, header.num_objects);
+            for (uint64_t i = first; i < last && !corrupted; ++i) {
+                uint64_t offset = offsets[i];
+                SnapshotRecord record;
+                if (offset > file_size - sizeof(record)) {
+                    corrupted = true;
+                    break;
+                }
+                std::memcpy(&record, base + offset, sizeof(record));
+                if (record.size > file_size - offset - sizeof(record)) {
+                    corrupted = true;
+                    break;
+                }
+
+                parts[t][shard_index(record.oid)].emplace_back(record.oid,
+                        Object(base + offset + sizeof(record), record.size,
+                            inline_threshold));
+                part_bytes[t] += record.size;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    munmap(map, file_size);
+    if (corrupted) {
+        throw std::runtime_error("Corrupted snapshot " + file);
+    }
+
+    // Objects are inserted in the order of the file, so that the last
+    // copy of an id wins
+    threads.clear();
+    for (uint64_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (uint64_t i = t; i < num_shards; i += num_threads) {
+                Shard& s = shards[i];
+                std::unique_lock<std::shared_timed_mutex> guard(s.lock);
+                s.map.reserve(s.map.size() + header.num_objects / num_shards);
+                for (auto& part : parts) {
+                    for (auto& entry : part[i]) {
+                        s.map[entry.first] = std::move(entry.second);
+                    }
+                    part[i] = Snapshot();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    uint64_t bytes = 0;
+    for (const auto& b : part_bytes) {
+        bytes += b;
+    }
+    return bytes;
+}
+
 }  // namespace cirrus
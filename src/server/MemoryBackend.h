@@ -2,19 +2,34 @@
 #define SRC_SERVER_MEMORYBACKEND_H_
 
 #include "StorageBackend.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace cirrus {
 
 /**
   * This is a key-value store backed by memory
-  * It's just a wrapper around a std::map or something similar
+  * The index is split in shards, each one a std::unordered_map with its own
+  * reader-writer lock, so that several threads can use the store at the
+  * same time. Lookups of different shards never contend, and lookups of the
+  * same shard only contend with writers of that shard.
+  * Objects up to inline_threshold bytes are kept in the entry of the index,
+  * without an allocation of their own.
   */
 class MemoryBackend : public StorageBackend {
  public:
+     /** Largest inline_threshold. Entries take this much space. */
+     static constexpr uint64_t max_inline_size = 48;
+
      MemoryBackend() = default;
-     MemoryBackend(uint64_t bytes);
+     MemoryBackend(uint64_t bytes,
+             uint64_t inline_threshold = max_inline_size);
      virtual ~MemoryBackend() = default;
 
      void init();
@@ -23,13 +38,89 @@ class MemoryBackend : public StorageBackend {
      MemSlice get(uint64_t oid) const override;
      bool delet(uint64_t oid) override;
      uint64_t size(uint64_t oid) const override;
+     LookupResult lookup(uint64_t oid) const override;
+     bool upsert(uint64_t oid, const MemSlice& data,
+             uint64_t* old_size) override;
+     bool erase(uint64_t oid, uint64_t* old_size) override;
+     bool write_at(uint64_t oid, uint64_t offset,
+             const MemSlice& data, uint64_t* size) override;
+     bool update(uint64_t oid,
+             const std::function<void(char*, uint64_t)>& modify) override;
+     uint64_t erase_range(uint64_t first, uint64_t last,
+             uint64_t* old_bytes,
+             std::vector<uint64_t>* erased = nullptr) override;
+     bool list_range(uint64_t first, uint64_t last,
+             std::vector<uint64_t>* oids) const override;
+
+     /**
+       * An object of the store. Small objects are held inline, larger ones
+       * in a separate immutable buffer shared with the slices returned by
+       * get() so that they can be sent without a copy.
+       */
+     class Object {
+      public:
+         Object() : size_(0), inline_(true) {}
+         Object(const char* data, uint64_t size, uint64_t inline_threshold);
+         Object(const Object& other);
+         Object(Object&& other) noexcept;
+         Object& operator=(Object other) noexcept;
+         ~Object();
+
+         const char* data() const {
+             return inline_ ? bytes :
+                 reinterpret_cast<const char*>(buffer->data());
+         }
+
+         uint64_t size() const {
+             return size_;
+         }
+
+         MemSlice slice() const;
+         void write(uint64_t offset, const MemSlice& data);
+         char* mutable_data();
+
+      private:
+         void swap(Object& other) noexcept;
+
+         uint64_t size_ : 63;
+         uint64_t inline_ : 1;
+         union {
+             std::shared_ptr<const std::vector<int8_t>> buffer;
+             char bytes[max_inline_size];
+         };
+     };
+
+     /**
+       * Point-in-time copy of the store. Large objects are immutable,
+       * so only the references to them are copied
+       */
+     using Snapshot = std::vector<std::pair<uint64_t, Object>>;
+
+     Snapshot snapshot() const;
+     static void write_snapshot(const Snapshot& snapshot,
+             const std::string& file);
+     uint64_t load_snapshot(const std::string& file, uint64_t num_threads);
 
  private:
-     // make this mutable because std::map
-     // doesn't play well with const
-     mutable std::unordered_map<uint64_t, std::vector<int8_t>> store;
-     mutable uint64_t remove_counter = 0;
-     mutable uint64_t remove_increment = 1'000'000;
+     /** Number of shards of the index. Must be a power of 2. */
+     static constexpr uint64_t num_shards = 64;
+
+     using Map = std::unordered_map<uint64_t, Object>;
+
+     /** Aligned so that the locks of two shards never share a line. */
+     struct alignas(64) Shard {
+         mutable std::shared_timed_mutex lock;
+         Map map;
+     };
+
+     static uint64_t shard_index(uint64_t oid);
+     Shard& shard(uint64_t oid) const;
+     void release(uint64_t bytes);
+
+     mutable std::array<Shard, num_shards> shards;
+     std::atomic<uint64_t> remove_counter = {0};
+     uint64_t remove_increment = 1'000'000;
+     uint64_t inline_threshold = max_inline_size;
 };
 
 }  // namespace cirrus
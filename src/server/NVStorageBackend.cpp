@@ -2,14 +2,21 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <algorithm>
+#include <limits>
+#include <memory>
 #include <stdexcept>
 #include "utils/logging.h"
 
 /**
   * Interface over RocksDB
+  * Objects are stored under 8 byte big-endian keys
+  * Their sizes are stored under the same keys in a column family of their own
   */
 namespace cirrus {
 
+static const char sizes_family[] = "sizes";
+
 NVStorageBackend::NVStorageBackend(const std::string& path) :
     path(path) {
 }
@@ -19,20 +26,128 @@ void NVStorageBackend::init() {
     options.OptimizeLevelStyleCompaction();
 
     options.create_if_missing = true;
+    options.create_missing_column_families = true;
+
+    // Databases written before the sizes were kept lack their family
+    std::vector<std::string> families;
+    bool index = rocksdb::DB::ListColumnFamilies(options, path,
+            &families).ok() &&
+        std::find(families.begin(), families.end(), sizes_family) ==
+            families.end();
 
     // open DB
-    rocksdb::Status s = rocksdb::DB::Open(options, path, &db);
+    std::vector<rocksdb::ColumnFamilyDescriptor> descriptors = {
+        {rocksdb::kDefaultColumnFamilyName, options},
+        {sizes_family, options}};
+    std::vector<rocksdb::ColumnFamilyHandle*> handles;
+    rocksdb::Status s = rocksdb::DB::Open(options, path, descriptors,
+            &handles, &db);
     if (!s.ok()) {
         throw std::runtime_error("Error opening rocksdb");
     }
+    sizes = handles[1];
+    if (index) {
+        index_sizes();
+    }
     LOG<INFO>("Opened rocksdb in path: ", path);
 }
 
+/**
+  * Keys are the oids in big-endian so that they have a fixed width and
+  * sort like the oids.
+  */
+class Key {
+ public:
+    explicit Key(uint64_t oid) {
+        for (int i = sizeof(uint64_t) - 1; i >= 0; --i) {
+            buf[i] = static_cast<char>(oid & 0xff);
+            oid >>= 8;
+        }
+    }
+
+    rocksdb::Slice slice() const {
+        return rocksdb::Slice(buf, sizeof(buf));
+    }
+
+    /** Decodes the oid of a key. */
+    static uint64_t oid(const rocksdb::Slice& key) {
+        uint64_t oid = 0;
+        for (uint64_t i = 0; i < sizeof(uint64_t); ++i) {
+            oid = oid << 8 | static_cast<uint8_t>(key.data()[i]);
+        }
+        return oid;
+    }
+
+ private:
+    char buf[sizeof(uint64_t)];
+};
+
+/**
+  * Stores the sizes of the objects of a database written before the sizes
+  * were kept. Done once, when the database is opened.
+  */
+void NVStorageBackend::index_sizes() {
+    std::unique_ptr<rocksdb::Iterator> it(
+            db->NewIterator(rocksdb::ReadOptions()));
+    rocksdb::WriteBatch batch;
+    uint64_t count = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        batch.Put(sizes, it->key(), Key(it->value().size()).slice());
+        count++;
+    }
+    if (!it->status().ok() ||
+        !db->Write(rocksdb::WriteOptions(), &batch).ok()) {
+        throw std::runtime_error("Error indexing sizes in rocksdb");
+    }
+    LOG<INFO>("Indexed the sizes of ", count, " objects in rocksdb");
+}
+
+/**
+  * Reads the size of an object, without reading the object.
+  * @param oid the id of the object
+  * @param size set to the size of the object, if it exists
+  * @return true if the object exists
+  */
+bool NVStorageBackend::stored_size(uint64_t oid, uint64_t* size) const {
+    std::string value;
+    rocksdb::Status s = db->Get(rocksdb::ReadOptions(), sizes,
+            Key(oid).slice(), &value);
+    if (s.IsNotFound()) {
+        return false;
+    } else if (!s.ok()) {
+        throw std::runtime_error("Error in get in rocksdb");
+    }
+    // Sizes are encoded like the keys
+    *size = Key::oid(value);
+    return true;
+}
+
+/**
+  * Reads a value without copying it. The value stays pinned in RocksDB's
+  * cache for as long as the slice (or any copy of it) exists.
+  * @return the status of the read
+  */
+rocksdb::Status NVStorageBackend::get_pinned(uint64_t oid,
+        MemSlice* data) const {
+    auto value = std::make_shared<rocksdb::PinnableSlice>();
+    rocksdb::Status s = db->Get(rocksdb::ReadOptions(),
+            db->DefaultColumnFamily(), Key(oid).slice(), value.get());
+    if (s.ok()) {
+        const char* begin = value->data();
+        const char* end = begin + value->size();
+        *data = MemSlice(std::move(value), begin, end);
+    }
+    return s;
+}
+
 bool NVStorageBackend::put(uint64_t oid, const MemSlice& data) {
     LOG<INFO>("Putting in rocksdb. oid: ", oid,
             " with size: ", data.size());
-    rocksdb::Status s = db->Put(rocksdb::WriteOptions(),
-            std::to_string(oid), data.toString());
+    Key key(oid);
+    rocksdb::WriteBatch batch;
+    batch.Put(key.slice(), rocksdb::Slice(data.data(), data.size()));
+    batch.Put(sizes, key.slice(), Key(data.size()).slice());
+    rocksdb::Status s = db->Write(rocksdb::WriteOptions(), &batch);
 
     if (!s.ok()) {
         throw std::runtime_error("Error in put in rocksdb");
@@ -41,37 +156,233 @@ bool NVStorageBackend::put(uint64_t oid, const MemSlice& data) {
 }
 
 bool NVStorageBackend::exists(uint64_t oid) const {
-    std::string value;
-    rocksdb::Status s = db->Get(rocksdb::ReadOptions(),
-            std::to_string(oid), &value);
-
-    LOG<INFO>("Object oid: ", oid, " not found: ", s.IsNotFound());
-    return !s.IsNotFound();
+    uint64_t size;
+    return stored_size(oid, &size);
 }
 
 MemSlice NVStorageBackend::get(uint64_t oid) const {
-    std::string value;
-    rocksdb::Status s = db->Get(rocksdb::ReadOptions(),
-            std::to_string(oid), &value);
-    if (!s.ok() || s.IsNotFound()) {
+    LookupResult result = lookup(oid);
+    if (!result.found) {
         throw std::runtime_error("Error in get in rocksdb");
     }
 
     LOG<INFO>("Get in rocksdb. oid: ", oid);
-    return MemSlice(value);
+    return result.data;
 }
 
 bool NVStorageBackend::delet(uint64_t oid) {
     // we assume object exists
-    db->Delete(rocksdb::WriteOptions(), std::to_string(oid));
+    Key key(oid);
+    rocksdb::WriteBatch batch;
+    batch.Delete(key.slice());
+    batch.Delete(sizes, key.slice());
+    db->Write(rocksdb::WriteOptions(), &batch);
     LOG<INFO>("Deleted oid: ", oid);
     return true;
 }
 
 uint64_t NVStorageBackend::size(uint64_t oid) const {
-    MemSlice obj = get(oid);
-    LOG<INFO>("Size of oid: ", oid, " is: ", obj.size());
-    return obj.size();
+    uint64_t size = 0;
+    stored_size(oid, &size);
+    LOG<INFO>("Size of oid: ", oid, " is: ", size);
+    return size;
+}
+
+StorageBackend::LookupResult NVStorageBackend::lookup(uint64_t oid) const {
+    MemSlice data;
+    rocksdb::Status s = get_pinned(oid, &data);
+    if (s.IsNotFound()) {
+        return {false, MemSlice()};
+    } else if (!s.ok()) {
+        throw std::runtime_error("Error in get in rocksdb");
+    }
+
+    LOG<INFO>("Lookup in rocksdb. oid: ", oid);
+    return {true, std::move(data)};
+}
+
+bool NVStorageBackend::upsert(uint64_t oid, const MemSlice& data,
+        uint64_t* old_size) {
+    // RocksDB can't tell the size of a value without reading it, the
+    // size is read from its own family instead
+    *old_size = size(oid);
+    return put(oid, data);
+}
+
+bool NVStorageBackend::erase(uint64_t oid, uint64_t* old_size) {
+    if (!stored_size(oid, old_size)) {
+        return false;
+    }
+    return delet(oid);
+}
+
+std::vector<StorageBackend::LookupResult> NVStorageBackend::get_bulk(
+        const std::vector<uint64_t>& oids) const {
+    std::vector<Key> keys;
+    std::vector<rocksdb::Slice> key_slices;
+    keys.reserve(oids.size());
+    key_slices.reserve(oids.size());
+    for (const auto& oid : oids) {
+        keys.emplace_back(oid);
+        key_slices.push_back(keys.back().slice());
+    }
+
+    // Values are read into slices pinned in RocksDB's cache instead of
+    // being copied. The results share the slices, which are released once
+    // none of them is used
+    auto values = std::make_shared<std::vector<rocksdb::PinnableSlice>>(
+            oids.size());
+    std::vector<rocksdb::Status> statuses(oids.size());
+    db->MultiGet(rocksdb::ReadOptions(), db->DefaultColumnFamily(),
+            oids.size(), key_slices.data(), values->data(), statuses.data());
+
+    std::vector<LookupResult> results;
+    results.reserve(oids.size());
+    for (uint64_t i = 0; i < oids.size(); ++i) {
+        if (statuses[i].IsNotFound()) {
+            results.push_back({false, MemSlice()});
+        } else if (!statuses[i].ok()) {
+            throw std::runtime_error("Error in multiget in rocksdb");
+        } else {
+            const char* begin = (*values)[i].data();
+            const char* end = begin + (*values)[i].size();
+            results.push_back({true, MemSlice(values, begin, end)});
+        }
+    }
+    return results;
+}
+
+uint64_t NVStorageBackend::put_bulk(const std::vector<uint64_t>& oids,
+        const std::vector<MemSlice>& data, uint64_t* old_bytes) {
+    // An id repeated in the batch replaces a single object
+    std::vector<uint64_t> replaced(oids);
+    std::sort(replaced.begin(), replaced.end());
+    replaced.erase(std::unique(replaced.begin(), replaced.end()),
+            replaced.end());
+
+    // The sizes of the objects replaced come from a single MultiGet
+    std::vector<Key> keys;
+    std::vector<rocksdb::Slice> key_slices;
+    keys.reserve(replaced.size());
+    key_slices.reserve(replaced.size());
+    for (const auto& oid : replaced) {
+        keys.emplace_back(oid);
+        key_slices.push_back(keys.back().slice());
+    }
+    std::vector<rocksdb::PinnableSlice> values(replaced.size());
+    std::vector<rocksdb::Status> statuses(replaced.size());
+    db->MultiGet(rocksdb::ReadOptions(), sizes, replaced.size(),
+            key_slices.data(), values.data(), statuses.data());
+    *old_bytes = 0;
+    for (uint64_t i = 0; i < replaced.size(); ++i) {
+        if (statuses[i].ok()) {
+            *old_bytes += Key::oid(values[i]);
+        } else if (!statuses[i].IsNotFound()) {
+            throw std::runtime_error("Error in multiget in rocksdb");
+        }
+    }
+
+    // The last write of a repeated id wins
+    rocksdb::WriteBatch batch;
+    for (uint64_t i = 0; i < oids.size(); ++i) {
+        Key key(oids[i]);
+        batch.Put(key.slice(),
+                rocksdb::Slice(data[i].data(), data[i].size()));
+        batch.Put(sizes, key.slice(), Key(data[i].size()).slice());
+    }
+
+    // All or nothing
+    rocksdb::Status s = db->Write(rocksdb::WriteOptions(), &batch);
+    if (!s.ok()) {
+        throw std::runtime_error("Error in batch put in rocksdb");
+    }
+    return oids.size();
+}
+
+bool NVStorageBackend::list_range(uint64_t first, uint64_t last,
+        std::vector<uint64_t>* oids) const {
+    if (first > last) {
+        return true;
+    }
+
+    // The sizes are smaller to go through than the objects
+    Key first_key(first);
+    Key last_key(last);
+    std::unique_ptr<rocksdb::Iterator> it(
+            db->NewIterator(rocksdb::ReadOptions(), sizes));
+    for (it->Seek(first_key.slice());
+         it->Valid() && it->key().compare(last_key.slice()) <= 0;
+         it->Next()) {
+        oids->push_back(Key::oid(it->key()));
+    }
+    if (!it->status().ok()) {
+        throw std::runtime_error("Error iterating rocksdb");
+    }
+    return true;
+}
+
+uint64_t NVStorageBackend::erase_range(uint64_t first, uint64_t last,
+        uint64_t* old_bytes, std::vector<uint64_t>* erased) {
+    uint64_t count = 0;
+    *old_bytes = 0;
+    if (first > last) {
+        return 0;
+    }
+
+    // Sizes of the objects deleted
+    Key first_key(first);
+    Key last_key(last);
+    std::unique_ptr<rocksdb::Iterator> it(
+            db->NewIterator(rocksdb::ReadOptions(), sizes));
+    for (it->Seek(first_key.slice());
+         it->Valid() && it->key().compare(last_key.slice()) <= 0;
+         it->Next()) {
+        count++;
+        *old_bytes += Key::oid(it->value());
+        if (erased) {
+            erased->push_back(Key::oid(it->key()));
+        }
+    }
+    if (!it->status().ok()) {
+        throw std::runtime_error("Error iterating rocksdb");
+    }
+
+    // The end of the range is exclusive. When last is the largest oid,
+    // its key followed by any byte sorts after it.
+    std::string end;
+    if (last != std::numeric_limits<uint64_t>::max()) {
+        end = Key(last + 1).slice().ToString();
+    } else {
+        end = last_key.slice().ToString() + '\0';
+    }
+    rocksdb::WriteBatch batch;
+    batch.DeleteRange(db->DefaultColumnFamily(), first_key.slice(), end);
+    batch.DeleteRange(sizes, first_key.slice(), end);
+    rocksdb::Status s = db->Write(rocksdb::WriteOptions(), &batch);
+    if (!s.ok()) {
+        throw std::runtime_error("Error in delete range in rocksdb");
+    }
+    LOG<INFO>("Deleted ", count, " oids from ", first, " to ", last);
+    return count;
+}
+
+/**
+  * Reports the bytes of the objects. The space RocksDB takes for them is
+  * not tracked, so no fragmentation is reported.
+  */
+bool NVStorageBackend::memory_stats(MemoryStats* stats) const {
+    stats->bytes_requested = 0;
+    std::unique_ptr<rocksdb::Iterator> it(
+            db->NewIterator(rocksdb::ReadOptions(), sizes));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        stats->bytes_requested += Key::oid(it->value());
+    }
+    if (!it->status().ok()) {
+        throw std::runtime_error("Error iterating rocksdb");
+    }
+    stats->bytes_used = stats->bytes_requested;
+    stats->fragmentation = 0;
+    return true;
 }
 
 }  // namespace cirrus
@@ -7,6 +7,8 @@
 #include "rocksdb/db.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/options.h"
+#include "rocksdb/iterator.h"
+#include "rocksdb/write_batch.h"
 
 namespace cirrus {
 
@@ -24,12 +26,35 @@ class NVStorageBackend : public StorageBackend {
     MemSlice get(uint64_t oid) const override;
     bool delet(uint64_t oid) override;
     uint64_t size(uint64_t oid) const override;
+    LookupResult lookup(uint64_t oid) const override;
+    bool upsert(uint64_t oid, const MemSlice& data,
+            uint64_t* old_size) override;
+    bool erase(uint64_t oid, uint64_t* old_size) override;
+    std::vector<LookupResult> get_bulk(
+            const std::vector<uint64_t>& oids) const override;
+    uint64_t put_bulk(const std::vector<uint64_t>& oids,
+            const std::vector<MemSlice>& data, uint64_t* old_bytes) override;
+    uint64_t erase_range(uint64_t first, uint64_t last,
+            uint64_t* old_bytes,
+            std::vector<uint64_t>* erased = nullptr) override;
+    bool list_range(uint64_t first, uint64_t last,
+            std::vector<uint64_t>* oids) const override;
+    bool memory_stats(MemoryStats* stats) const override;
 
  private:
+    rocksdb::Status get_pinned(uint64_t oid, MemSlice* data) const;
+    bool stored_size(uint64_t oid, uint64_t* size) const;
+    void index_sizes();
+
     std::string path;  //< path to raw device
 
     rocksdb::DB* db = nullptr;  //< rocksdb handler
     rocksdb::Options options;   //< rocksdb options
+    /**
+      * Column family of the sizes of the objects, so that writes and
+      * removes learn the size of the object they replace without reading it
+      */
+    rocksdb::ColumnFamilyHandle* sizes = nullptr;
 };
 
 }  // namespace cirrus
@@ -0,0 +1,75 @@
+#ifndef SRC_SERVER_NEARDATAFUNCTION_H_
+#define SRC_SERVER_NEARDATAFUNCTION_H_
+
+#include <cstdint>
+#include <string>
+
+/**
+  * Interface of the plugins that add functions to the server.
+  * A plugin is a shared object loaded with --plugin=path. It exports
+  * cirrus_near_data_functions(), which returns the functions it defines.
+  * Clients call them by name on an object or a range of objects, and
+  * only the result is sent back. Functions run while the server holds
+  * its lock on the objects: they must be short and must not block.
+  *
+  * Example:
+  *   static bool sum(const cirrus::NearDataObject* objects, uint64_t n,
+  *           const char* args, uint64_t args_size, std::string* result) {
+  *       ...
+  *   }
+  *   static const cirrus::NearDataFunctionEntry functions[] = {
+  *       {"sum", sum}};
+  *   extern "C" const cirrus::NearDataFunctionEntry*
+  *   cirrus_near_data_functions(uint64_t* count) {
+  *       *count = 1;
+  *       return functions;
+  *   }
+  */
+
+namespace cirrus {
+
+/** An object a function is called on. */
+struct NearDataObject {
+    /** The id of the object. */
+    uint64_t oid;
+    /** The data of the object, valid only during the call. */
+    const char* data;
+    /** The size of the object, in bytes. */
+    uint64_t size;
+};
+
+/**
+  * A function run by the server.
+  * @param objects the objects the function is called on, in id order.
+  * Objects that do not exist are skipped
+  * @param num_objects the number of objects
+  * @param args arguments given by the client
+  * @param args_size the size of args, in bytes
+  * @param result where the result sent to the client is stored
+  * @return true on success. On failure the client gets an exception
+  */
+using NearDataFunction = bool (*)(const NearDataObject* objects,
+        uint64_t num_objects, const char* args, uint64_t args_size,
+        std::string* result);
+
+/** A function of a plugin, with the name clients call it by. */
+struct NearDataFunctionEntry {
+    const char* name;
+    NearDataFunction function;
+};
+
+/**
+  * Type of the function exported by plugins.
+  * @param count set to the number of functions
+  * @return the functions of the plugin. They must stay valid while the
+  * plugin is loaded
+  */
+using NearDataFunctionsGetter = const NearDataFunctionEntry* (*)(
+        uint64_t* count);
+
+/** Name of the function exported by plugins. */
+static const char near_data_functions_symbol[] = "cirrus_near_data_functions";
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_NEARDATAFUNCTION_H_
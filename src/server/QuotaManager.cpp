@@ -0,0 +1,217 @@
+#include "server/QuotaManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+
+namespace cirrus {
+
+/**
+  * Constructor.
+  * @param rate tokens added per second, 0 if unlimited. The bucket starts
+  * full
+  */
+QuotaManager::TokenBucket::TokenBucket(uint64_t rate) :
+    rate(rate), tokens(rate) {}
+
+/**
+  * Adds the tokens accumulated since the last call and tells whether some
+  * are left.
+  * @param now_us the current time, in microseconds
+  * @return true if the bucket is not empty
+  */
+bool QuotaManager::TokenBucket::available(uint64_t now_us) {
+    if (rate == 0) {
+        return true;
+    }
+    if (now_us > last_us) {
+        tokens = std::min(rate, tokens + (now_us - last_us) * rate / 1e6);
+        last_us = now_us;
+    }
+    return tokens > 0;
+}
+
+/**
+  * Takes tokens from the bucket, even more than there are left.
+  * @param tokens the number of tokens
+  */
+void QuotaManager::TokenBucket::consume(uint64_t tokens) {
+    if (rate > 0) {
+        this->tokens -= tokens;
+    }
+}
+
+QuotaManager::App::App(const Limits& limits) :
+    limits(limits), requests(limits.requests_per_s),
+    bandwidth(limits.bytes_per_s) {}
+
+QuotaManager::QuotaManager() {}
+
+/**
+  * Sets the limits of the applications that have none of their own.
+  * Applies to the applications seen after the call.
+  * @param limits the limits
+  */
+void QuotaManager::setDefaultLimits(const Limits& limits) {
+    default_limits = limits;
+    has_limits = has_limits || limits.memory > 0 ||
+        limits.requests_per_s > 0 || limits.bytes_per_s > 0;
+}
+
+/**
+  * Sets the limits of an application. The memory it uses is kept.
+  * @param app_id the application
+  * @param limits the limits
+  */
+void QuotaManager::setLimits(AppId app_id, const Limits& limits) {
+    App* app = getApp(app_id);
+    std::lock_guard<std::mutex> guard(app->rate_lock);
+    app->limits = limits;
+    app->requests = TokenBucket(limits.requests_per_s);
+    app->bandwidth = TokenBucket(limits.bytes_per_s);
+    has_limits = has_limits || limits.memory > 0 ||
+        limits.requests_per_s > 0 || limits.bytes_per_s > 0;
+}
+
+/**
+  * Tells whether any application has a limit. Without limits nothing has
+  * to be accounted for.
+  */
+bool QuotaManager::enabled() const {
+    return has_limits;
+}
+
+/**
+  * Returns the state of an application, created with the default limits
+  * the first time it is seen.
+  * @param app_id the application
+  * @return the state, valid for the lifetime of the QuotaManager
+  */
+QuotaManager::App* QuotaManager::getApp(AppId app_id) {
+    std::lock_guard<std::mutex> guard(apps_lock);
+    auto it = apps.find(app_id);
+    if (it == apps.end()) {
+        it = apps.emplace(std::piecewise_construct,
+                std::forward_as_tuple(app_id),
+                std::forward_as_tuple(default_limits)).first;
+    }
+    return &it->second;
+}
+
+/**
+  * Tells whether an application can use more memory.
+  * @param app_id the application
+  * @param memorySize the bytes it would use
+  * @return true if the memory fits in the quota of the application
+  */
+bool QuotaManager::canAllocateMemory(uint64_t app_id, uint64_t memorySize) {
+    return fits(getApp(app_id), memorySize);
+}
+
+/**
+  * Charges memory to an application, not tied to any object.
+  * @param app_id the application
+  * @param memorySize the bytes used
+  */
+void QuotaManager::allocateMemory(uint64_t app_id, uint64_t memorySize) {
+    getApp(app_id)->memory_used += memorySize;
+}
+
+/**
+  * Tells whether an application can write an object, which replaces the
+  * object with the same id.
+  * @param app the application
+  * @param oid the id of the object
+  * @param size the size of the object
+  * @return true if the object fits in the quota of the application
+  */
+bool QuotaManager::fits(const App* app, ObjectID oid, uint64_t size) const {
+    if (app->limits.memory == 0) {
+        return true;
+    }
+    uint64_t used = app->memory_used;
+    auto it = charges.find(oid);
+    if (it != charges.end() && it->second.app == app) {
+        used -= it->second.size;
+    }
+    return used + size <= app->limits.memory;
+}
+
+/**
+  * Tells whether new objects fit in the quota of an application, not
+  * counting the objects they may replace.
+  * @param app the application
+  * @param size the size of the objects
+  * @return true if the objects fit
+  */
+bool QuotaManager::fits(const App* app, uint64_t size) const {
+    return app->limits.memory == 0 ||
+        app->memory_used + size <= app->limits.memory;
+}
+
+/**
+  * Charges an object just written to an application, instead of the
+  * application it was charged to before.
+  * @param app the application
+  * @param oid the id of the object
+  * @param size the size of the object
+  */
+void QuotaManager::charge(App* app, ObjectID oid, uint64_t size) {
+    Charge& charge = charges[oid];
+    if (charge.app) {
+        charge.app->memory_used -= charge.size;
+    }
+    charge.app = app;
+    charge.size = size;
+    app->memory_used += size;
+}
+
+/**
+  * Gives back the memory of an object removed to the application it was
+  * charged to.
+  * @param oid the id of the object
+  */
+void QuotaManager::release(ObjectID oid) {
+    auto it = charges.find(oid);
+    if (it != charges.end()) {
+        it->second.app->memory_used -= it->second.size;
+        charges.erase(it);
+    }
+}
+
+/**
+  * Tells whether an application can send a request now and, if so,
+  * charges the request to its rates. The clock is only read for the
+  * applications with a rate.
+  * @param app the application
+  * @param bytes the size of the request
+  * @return false if the application is over its request rate or
+  * bandwidth
+  */
+bool QuotaManager::admit(App* app, uint64_t bytes) {
+    if (app->limits.requests_per_s == 0 && app->limits.bytes_per_s == 0) {
+        return true;
+    }
+    uint64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    std::lock_guard<std::mutex> guard(app->rate_lock);
+    if (!app->requests.available(now_us) ||
+        !app->bandwidth.available(now_us)) {
+        return false;
+    }
+    app->requests.consume(1);
+    app->bandwidth.consume(bytes);
+    return true;
+}
+
+/**
+  * Charges data sent to an application, e.g. a reply, to its bandwidth.
+  * @param app the application
+  * @param bytes the size of the data
+  */
+void QuotaManager::chargeBandwidth(App* app, uint64_t bytes) {
+    std::lock_guard<std::mutex> guard(app->rate_lock);
+    app->bandwidth.consume(bytes);
+}
+
+}  // namespace cirrus
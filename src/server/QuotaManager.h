@@ -2,15 +2,107 @@
 #define SRC_SERVER_QUOTAMANAGER_H_
 
 #include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include "common/AllocatorMessage.h"
 
 namespace cirrus {
 
+using ObjectID = uint64_t;
+
+/**
+  * Quotas of the applications sharing a server, identified by the AppId of
+  * the authentication module. Every object is charged to the application
+  * that wrote it last, and requests and bandwidth are limited with token
+  * buckets.
+  * getApp(), admit() and chargeBandwidth() are thread safe: every
+  * application has a lock of its own for its token buckets, so requests
+  * of different applications are admitted in parallel. The memory
+  * accounting (fits(), charge(), release(), canAllocateMemory() and
+  * allocateMemory()) is not, its callers serialize it. Limits are set
+  * before the manager is used.
+  */
 class QuotaManager {
  public:
+    /** Limits of an application, 0 means unlimited. */
+    struct Limits {
+        /** Bytes of the objects the application stores. */
+        uint64_t memory = 0;
+        /** Requests per second. */
+        uint64_t requests_per_s = 0;
+        /** Bytes received and sent per second. */
+        uint64_t bytes_per_s = 0;
+    };
+
+    /**
+      * Tokens added at a fixed rate, up to a second's worth. Consuming is
+      * allowed while there are tokens left, and may leave the bucket in
+      * debt, so that large requests are paid for by the requests after.
+      */
+    class TokenBucket {
+     public:
+        explicit TokenBucket(uint64_t rate = 0);
+
+        bool available(uint64_t now_us);
+        void consume(uint64_t tokens);
+
+     private:
+        /** Tokens added per second, 0 if unlimited. */
+        double rate;
+        /** Tokens left, negative when in debt. */
+        double tokens;
+        /** Time the tokens were last added, in microseconds. */
+        uint64_t last_us = 0;
+    };
+
+    /** State of an application. */
+    struct App {
+        explicit App(const Limits& limits);
+
+        Limits limits;
+        /** Bytes of the objects charged to the application. */
+        uint64_t memory_used = 0;
+        /** Protects the token buckets. */
+        std::mutex rate_lock;
+        TokenBucket requests;
+        TokenBucket bandwidth;
+    };
+
     QuotaManager();
 
-    virtual bool canAllocateMemory(uint64_t app_id, uint64_t memorySize) = 0;;
-    virtual void allocateMemory(uint64_t app_id, uint64_t memorySize) = 0;
+    void setDefaultLimits(const Limits& limits);
+    void setLimits(AppId app_id, const Limits& limits);
+    bool enabled() const;
+    App* getApp(AppId app_id);
+
+    bool canAllocateMemory(uint64_t app_id, uint64_t memorySize);
+    void allocateMemory(uint64_t app_id, uint64_t memorySize);
+
+    bool fits(const App* app, ObjectID oid, uint64_t size) const;
+    bool fits(const App* app, uint64_t size) const;
+    void charge(App* app, ObjectID oid, uint64_t size);
+    void release(ObjectID oid);
+
+    bool admit(App* app, uint64_t bytes);
+    void chargeBandwidth(App* app, uint64_t bytes);
+
+ private:
+    /** The object charged to an application. */
+    struct Charge {
+        App* app = nullptr;
+        uint64_t size = 0;
+    };
+
+    /** Limits of the applications without limits of their own. */
+    Limits default_limits;
+    /** Whether any application has a limit. */
+    bool has_limits = false;
+    /** State of every application seen. Nodes never move. */
+    std::unordered_map<AppId, App> apps;
+    /** Protects apps, not the applications in it. */
+    std::mutex apps_lock;
+    /** The application each object is charged to. */
+    std::unordered_map<ObjectID, Charge> charges;
 };
 
 }  // namespace cirrus
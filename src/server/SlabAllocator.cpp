@@ -0,0 +1,207 @@
+#include "server/SlabAllocator.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include "utils/logging.h"
+
+namespace cirrus {
+
+static const uint64_t slot_alignment = 8;
+
+/**
+  * Rounds a size up to a multiple of a power of two.
+  */
+static uint64_t round_up(uint64_t size, uint64_t multiple) {
+    return (size + multiple - 1) & ~(multiple - 1);
+}
+
+double SlabAllocator::Stats::fragmentation() const {
+    uint64_t used = slab_bytes + large_bytes;
+    if (used == 0) {
+        return 0;
+    }
+    return 1.0 - static_cast<double>(bytes_requested) / used;
+}
+
+SlabAllocator::SlabAllocator(uint64_t arena_size, bool huge_pages,
+        uint64_t slab_size, uint64_t min_slot_size, double growth_factor) :
+    slab_size(slab_size), arena_size(round_up(arena_size, slab_size)) {
+    if (slab_size == 0 || (slab_size & (slab_size - 1)) != 0) {
+        throw std::runtime_error("Slab size must be a power of two");
+    }
+    if (growth_factor <= 1) {
+        throw std::runtime_error("Slab growth factor must be above 1");
+    }
+
+    // Only touched pages take memory
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    void* mem = MAP_FAILED;
+    if (huge_pages) {
+        mem = mmap(nullptr, this->arena_size, PROT_READ | PROT_WRITE,
+                flags | MAP_HUGETLB, -1, 0);
+        if (mem == MAP_FAILED) {
+            LOG<ERROR>("No huge pages available for the slab arena, ",
+                    "using transparent huge pages");
+        }
+    }
+    if (mem == MAP_FAILED) {
+        mem = mmap(nullptr, this->arena_size, PROT_READ | PROT_WRITE,
+                flags, -1, 0);
+        if (mem == MAP_FAILED) {
+            throw std::runtime_error("Error reserving slab arena");
+        }
+        if (huge_pages) {
+            madvise(mem, this->arena_size, MADV_HUGEPAGE);
+        }
+    }
+    arena = static_cast<char*>(mem);
+
+    uint64_t slot_size = round_up(std::max(min_slot_size, sizeof(FreeSlot)),
+            slot_alignment);
+    while (slot_size < slab_size) {
+        classes.push_back(std::make_unique<SizeClass>(slot_size));
+        slot_size = round_up(std::max<uint64_t>(slot_size * growth_factor,
+                    slot_size + slot_alignment), slot_alignment);
+    }
+    classes.push_back(std::make_unique<SizeClass>(slab_size));
+
+    LOG<INFO>("Slab arena of ", this->arena_size, " bytes with ",
+            classes.size(), " size classes");
+}
+
+SlabAllocator::~SlabAllocator() {
+    munmap(arena, arena_size);
+}
+
+/**
+  * Finds the smallest class with slots of at least size bytes.
+  * @return index of the class, -1 if size is larger than a slab
+  */
+int SlabAllocator::class_index(uint64_t size) const {
+    auto it = std::lower_bound(classes.begin(), classes.end(), size,
+            [](const std::unique_ptr<SizeClass>& c, uint64_t size) {
+                return c->slot_size < size;
+            });
+    if (it == classes.end()) {
+        return -1;
+    }
+    return it - classes.begin();
+}
+
+/**
+  * Takes a slab from the arena.
+  * @return the slab, nullptr if the arena is exhausted
+  */
+char* SlabAllocator::new_slab() {
+    std::lock_guard<std::mutex> guard(arena_lock);
+    if (arena_next + slab_size > arena_size) {
+        return nullptr;
+    }
+    char* slab = arena + arena_next;
+    arena_next += slab_size;
+    return slab;
+}
+
+void* SlabAllocator::allocate(uint64_t size) {
+    int index = class_index(size);
+    if (index < 0) {
+        return allocate_large(size);
+    }
+
+    SizeClass& c = *classes[index];
+    std::lock_guard<std::mutex> guard(c.lock);
+    void* slot;
+    if (c.free_list) {
+        slot = c.free_list;
+        c.free_list = c.free_list->next;
+    } else {
+        if (c.slab_next == c.slab_end) {
+            char* slab = new_slab();
+            if (slab == nullptr) {
+                return nullptr;
+            }
+            c.slabs++;
+            c.slab_next = slab;
+            // slots never straddle two slabs
+            c.slab_end = slab + slab_size / c.slot_size * c.slot_size;
+        }
+        slot = c.slab_next;
+        c.slab_next += c.slot_size;
+    }
+
+    c.slots_used++;
+    c.bytes_requested += size;
+    return slot;
+}
+
+void SlabAllocator::free(void* ptr, uint64_t size) {
+    int index = class_index(size);
+    if (index < 0) {
+        free_large(ptr, size);
+        return;
+    }
+
+    SizeClass& c = *classes[index];
+    std::lock_guard<std::mutex> guard(c.lock);
+    FreeSlot* slot = static_cast<FreeSlot*>(ptr);
+    slot->next = c.free_list;
+    c.free_list = slot;
+
+    c.slots_used--;
+    c.bytes_requested -= size;
+}
+
+/**
+  * Allocations that do not fit in a slab get their own mapping.
+  */
+void* SlabAllocator::allocate_large(uint64_t size) {
+    uint64_t mapped = round_up(size, sysconf(_SC_PAGESIZE));
+    void* mem = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(large_lock);
+    large_objects++;
+    large_bytes += mapped;
+    large_requested += size;
+    return mem;
+}
+
+void SlabAllocator::free_large(void* ptr, uint64_t size) {
+    uint64_t mapped = round_up(size, sysconf(_SC_PAGESIZE));
+    munmap(ptr, mapped);
+
+    std::lock_guard<std::mutex> guard(large_lock);
+    large_objects--;
+    large_bytes -= mapped;
+    large_requested -= size;
+}
+
+SlabAllocator::Stats SlabAllocator::stats() const {
+    Stats s;
+    s.arena_size = arena_size;
+    s.slab_bytes = 0;
+    s.slot_bytes = 0;
+    s.bytes_requested = 0;
+
+    for (const auto& c : classes) {
+        std::lock_guard<std::mutex> guard(c->lock);
+        s.classes.push_back(
+                {c->slot_size, c->slabs, c->slots_used, c->bytes_requested});
+        s.slab_bytes += c->slabs * slab_size;
+        s.slot_bytes += c->slots_used * c->slot_size;
+        s.bytes_requested += c->bytes_requested;
+    }
+
+    std::lock_guard<std::mutex> guard(large_lock);
+    s.large_objects = large_objects;
+    s.large_bytes = large_bytes;
+    s.bytes_requested += large_requested;
+    return s;
+}
+
+}  // namespace cirrus
@@ -0,0 +1,136 @@
+#ifndef SRC_SERVER_SLABALLOCATOR_H_
+#define SRC_SERVER_SLABALLOCATOR_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cirrus {
+
+/**
+  * Allocator that carves fixed size slots out of slabs.
+  * Slabs are taken from a single arena reserved upfront with mmap(). Every
+  * slab belongs to a size class and is cut into slots of the size of the
+  * class. Freed slots go to a free list of their class and are reused in
+  * O(1). Memory is never given back to the system, so there is no need
+  * for malloc_trim() and its pauses.
+  * Allocations larger than a slab are mapped on their own.
+  * The allocator is thread safe.
+  */
+class SlabAllocator {
+ public:
+    /** Usage of a size class. */
+    struct ClassStats {
+        uint64_t slot_size;        //< size of the slots of the class
+        uint64_t slabs;            //< number of slabs of the class
+        uint64_t slots_used;       //< number of slots allocated
+        uint64_t bytes_requested;  //< bytes requested by allocated slots
+    };
+
+    /** Usage of the allocator. */
+    struct Stats {
+        uint64_t arena_size;       //< bytes reserved for the arena
+        uint64_t slab_bytes;       //< bytes of the slabs in use
+        uint64_t slot_bytes;       //< bytes of the slots allocated
+        uint64_t bytes_requested;  //< bytes requested by all allocations
+        uint64_t large_objects;    //< number of allocations larger than a slab
+        uint64_t large_bytes;      //< bytes mapped for large allocations
+        std::vector<ClassStats> classes;
+
+        /**
+          * Fraction of the memory taken from the system that does not hold
+          * requested bytes: unused slots, the unused end of slots and
+          * the rounding of large allocations.
+          */
+        double fragmentation() const;
+    };
+
+    /**
+      * Constructor.
+      * @param arena_size bytes to reserve for the arena
+      * @param huge_pages whether to back the arena with huge pages
+      * @param slab_size size of each slab. Also the largest slot size
+      * @param min_slot_size size of the slots of the smallest class
+      * @param growth_factor ratio between the slot sizes of two
+      * consecutive classes
+      */
+    explicit SlabAllocator(uint64_t arena_size, bool huge_pages = false,
+            uint64_t slab_size = 2 * 1024 * 1024,
+            uint64_t min_slot_size = 64, double growth_factor = 1.25);
+    ~SlabAllocator();
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    /**
+      * Allocate memory
+      * @param size number of bytes
+      * @return pointer to the memory, 8 byte aligned. nullptr if the arena
+      * is exhausted
+      */
+    void* allocate(uint64_t size);
+
+    /**
+      * Free memory
+      * @param ptr pointer returned by allocate()
+      * @param size size given to allocate()
+      */
+    void free(void* ptr, uint64_t size);
+
+    /**
+      * Get the usage of the allocator
+      * @return Stats
+      */
+    Stats stats() const;
+
+ private:
+    /** Slots freed are linked through their first bytes. */
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    /** Size class. */
+    struct SizeClass {
+        explicit SizeClass(uint64_t slot_size) : slot_size(slot_size) {}
+
+        uint64_t slot_size;
+        /** Slots freed, reused first. */
+        FreeSlot* free_list = nullptr;
+        /** Part of the last slab of the class that was never used. */
+        char* slab_next = nullptr;
+        char* slab_end = nullptr;
+
+        uint64_t slabs = 0;
+        uint64_t slots_used = 0;
+        uint64_t bytes_requested = 0;
+
+        mutable std::mutex lock;
+    };
+
+    int class_index(uint64_t size) const;
+    char* new_slab();
+    void* allocate_large(uint64_t size);
+    void free_large(void* ptr, uint64_t size);
+
+    const uint64_t slab_size;
+
+    /** Arena all slabs come from. */
+    char* arena = nullptr;
+    uint64_t arena_size;
+    /** Offset of the first slab never handed out. */
+    uint64_t arena_next = 0;
+    std::mutex arena_lock;
+
+    /** Size classes, sorted by slot size. */
+    std::vector<std::unique_ptr<SizeClass>> classes;
+
+    uint64_t large_objects = 0;
+    uint64_t large_bytes = 0;
+    uint64_t large_requested = 0;
+    mutable std::mutex large_lock;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_SLABALLOCATOR_H_
@@ -0,0 +1,142 @@
+#include "server/SlabBackend.h"
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include "utils/logging.h"
+
+namespace cirrus {
+
+SlabBackend::SlabBackend(uint64_t arena_size, bool huge_pages) :
+    arena_size(arena_size), huge_pages(huge_pages) {}
+
+SlabBackend::~SlabBackend() {}
+
+void SlabBackend::init() {
+    allocator = std::make_shared<SlabAllocator>(arena_size, huge_pages);
+}
+
+void SlabBackend::Release::operator()(Object* obj) const {
+    uint64_t slot_size = sizeof(Object) + obj->size;
+    obj->~Object();
+    allocator->free(obj, slot_size);
+}
+
+bool SlabBackend::put(uint64_t oid, const MemSlice& data) {
+    uint64_t old_size;
+    return upsert(oid, data, &old_size);
+}
+
+bool SlabBackend::exists(uint64_t oid) const {
+    std::shared_lock<std::shared_timed_mutex> guard(lock);
+    return store.find(oid) != store.end();
+}
+
+MemSlice SlabBackend::get(uint64_t oid) const {
+    LookupResult result = lookup(oid);
+    if (!result.found) {
+        throw std::runtime_error(
+                "SlabBackend get() called on nonexistent id");
+    }
+
+    return result.data;
+}
+
+bool SlabBackend::delet(uint64_t oid) {
+    uint64_t old_size;
+    return erase(oid, &old_size);
+}
+
+StorageBackend::LookupResult SlabBackend::lookup(uint64_t oid) const {
+    std::shared_ptr<Object> obj;
+    {
+        std::shared_lock<std::shared_timed_mutex> guard(lock);
+        auto it = store.find(oid);
+        if (it == store.end()) {
+            return {false, MemSlice()};
+        }
+        obj = it->second;
+    }
+
+    const char* data = obj->data();
+    uint64_t size = obj->size;
+    return {true, MemSlice(std::move(obj), data, data + size)};
+}
+
+bool SlabBackend::upsert(uint64_t oid, const MemSlice& data,
+        uint64_t* old_size) {
+    void* slot = allocator->allocate(sizeof(Object) + data.size());
+    if (slot == nullptr) {
+        LOG<ERROR>("Slab arena exhausted, fragmentation: ",
+                allocator->stats().fragmentation());
+        return false;
+    }
+
+    Object* raw = new (slot) Object(data.size());
+    std::memcpy(raw->data(), data.data(), data.size());
+
+    std::shared_ptr<Object> obj;
+    try {
+        obj = std::shared_ptr<Object>(raw, Release{allocator.get()},
+                CountAllocator<Object>(allocator));
+    } catch (const std::bad_alloc&) {
+        // The object was released
+        LOG<ERROR>("Slab arena exhausted, fragmentation: ",
+                allocator->stats().fragmentation());
+        return false;
+    }
+
+    // The previous object is released outside of the lock
+    std::shared_ptr<Object> old;
+    {
+        std::unique_lock<std::shared_timed_mutex> guard(lock);
+        old = store.assign(oid, std::move(obj));
+    }
+    *old_size = old ? old->size : 0;
+    return true;
+}
+
+bool SlabBackend::erase(uint64_t oid, uint64_t* old_size) {
+    std::shared_ptr<Object> old;
+    {
+        std::unique_lock<std::shared_timed_mutex> guard(lock);
+        old = store.erase(oid);
+    }
+    if (!old) {
+        return false;
+    }
+
+    *old_size = old->size;
+    return true;
+}
+
+bool SlabBackend::list_range(uint64_t first, uint64_t last,
+        std::vector<uint64_t>* oids) const {
+    std::shared_lock<std::shared_timed_mutex> guard(lock);
+    list_index_range(store, first, last, oids);
+    return true;
+}
+
+uint64_t SlabBackend::size(uint64_t oid) const {
+    std::shared_lock<std::shared_timed_mutex> guard(lock);
+    auto it = store.find(oid);
+    if (it == store.end()) {
+        return 0;
+    }
+
+    return it->second->size;
+}
+
+SlabAllocator::Stats SlabBackend::stats() const {
+    return allocator->stats();
+}
+
+bool SlabBackend::memory_stats(MemoryStats* stats) const {
+    SlabAllocator::Stats slab_stats = allocator->stats();
+    stats->bytes_used = slab_stats.slab_bytes + slab_stats.large_bytes;
+    stats->bytes_requested = slab_stats.bytes_requested;
+    stats->fragmentation = slab_stats.fragmentation();
+    return true;
+}
+
+}  // namespace cirrus
@@ -0,0 +1,127 @@
+#ifndef SRC_SERVER_SLABBACKEND_H_
+#define SRC_SERVER_SLABBACKEND_H_
+
+#include "StorageBackend.h"
+#include <memory>
+#include <new>
+#include <shared_mutex>
+#include "server/FlatIndex.h"
+#include "server/SlabAllocator.h"
+
+namespace cirrus {
+
+/**
+  * Key-value store backed by memory. Objects are stored in the slots of
+  * a SlabAllocator instead of individual heap allocations, and so is the
+  * reference count of each object, created once when it is written.
+  * Slices returned by get() share the object's reference count, so objects
+  * can be overwritten or removed while being sent, and lookups do not
+  * allocate.
+  * The index is a FlatIndex, without a heap node per object.
+  * Thread safe: lookups share a reader-writer lock, which writers take
+  * only to change the index.
+  */
+class SlabBackend : public StorageBackend {
+ public:
+    /**
+      * Constructor.
+      * @param arena_size bytes to reserve for objects
+      * @param huge_pages whether to back objects with huge pages
+      */
+    explicit SlabBackend(uint64_t arena_size, bool huge_pages = false);
+    virtual ~SlabBackend();
+
+    void init() override;
+    bool put(uint64_t oid, const MemSlice& data) override;
+    bool exists(uint64_t oid) const override;
+    MemSlice get(uint64_t oid) const override;
+    bool delet(uint64_t oid) override;
+    uint64_t size(uint64_t oid) const override;
+    LookupResult lookup(uint64_t oid) const override;
+    bool upsert(uint64_t oid, const MemSlice& data,
+            uint64_t* old_size) override;
+    bool erase(uint64_t oid, uint64_t* old_size) override;
+    bool list_range(uint64_t first, uint64_t last,
+            std::vector<uint64_t>* oids) const override;
+    bool memory_stats(MemoryStats* stats) const override;
+
+    /**
+      * Get the usage of the memory holding the objects
+      * @return the stats of the allocator
+      */
+    SlabAllocator::Stats stats() const;
+
+ private:
+    /** Header in front of every object, in the same slot. */
+    struct Object {
+        explicit Object(uint64_t size) : size(size) {}
+
+        char* data() {
+            return reinterpret_cast<char*>(this + 1);
+        }
+
+        uint64_t size;
+    };
+
+    /** Frees the slot of an object when its last reference goes away. */
+    struct Release {
+        SlabAllocator* allocator;
+
+        void operator()(Object* obj) const;
+    };
+
+    /**
+      * Allocates the reference counts of the objects from the slabs. Its
+      * copy in every count keeps the allocator alive until the count is
+      * freed.
+      */
+    template <typename T>
+    struct CountAllocator {
+        using value_type = T;
+
+        explicit CountAllocator(std::shared_ptr<SlabAllocator> allocator) :
+            allocator(std::move(allocator)) {}
+
+        template <typename U>
+        CountAllocator(const CountAllocator<U>& other) :
+            allocator(other.allocator) {}
+
+        T* allocate(size_t n) {
+            void* ptr = allocator->allocate(n * sizeof(T));
+            if (ptr == nullptr) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(ptr);
+        }
+
+        void deallocate(T* ptr, size_t n) {
+            allocator->free(ptr, n * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const CountAllocator<U>& other) const {
+            return allocator == other.allocator;
+        }
+
+        template <typename U>
+        bool operator!=(const CountAllocator<U>& other) const {
+            return allocator != other.allocator;
+        }
+
+        std::shared_ptr<SlabAllocator> allocator;
+    };
+
+    uint64_t arena_size;
+    bool huge_pages;
+
+    /** Shared with the slices, it outlives the backend if needed. */
+    std::shared_ptr<SlabAllocator> allocator;
+
+    mutable std::shared_timed_mutex lock;
+    /** Held by the index and by every slice of the object. */
+    FlatIndex<std::shared_ptr<Object>> store;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_SLABBACKEND_H_
@@ -6,6 +6,7 @@
 #include <cstring>
 #include <string>
 #include <cassert>
+#include <functional>
 
 #include "utils/logging.h"
 
@@ -19,6 +20,23 @@ namespace cirrus {
   */
 class StorageBackend {
  public:
+    /**
+      * Result of a lookup
+      */
+    struct LookupResult {
+        bool found;     //< whether the object exists
+        MemSlice data;  //< the object's data, if found
+    };
+
+    /**
+      * Memory taken by the backend for the objects
+      */
+    struct MemoryStats {
+        uint64_t bytes_used;       //< bytes taken from the system
+        uint64_t bytes_requested;  //< bytes holding the objects
+        double fragmentation;      //< fraction of bytes_used not holding them
+    };
+
      virtual ~StorageBackend() = default;
 
     /**
@@ -61,6 +79,236 @@ class StorageBackend {
       * @return Size of the object
       */
     virtual uint64_t size(uint64_t oid) const = 0;
+
+    /**
+      * Find object. Replaces calls to exists(), size() and get()
+      * with a single lookup in the backend
+      * @param oid Object ID
+      * @return LookupResult with the object's data if the object exists
+      */
+    virtual LookupResult lookup(uint64_t oid) const {
+        if (!exists(oid)) {
+            return {false, MemSlice()};
+        }
+        return {true, get(oid)};
+    }
+
+    /**
+      * Put object, replacing the object under the same id if any
+      * @param oid Object ID
+      * @param data MemSlice to be written
+      * @param old_size Set to the size of the object replaced, 0 if none
+      * @return bool Indicates success (true) or failure (false). On failure
+      * the previous object (if any) is left in place
+      */
+    virtual bool upsert(uint64_t oid, const MemSlice& data,
+            uint64_t* old_size) {
+        *old_size = exists(oid) ? size(oid) : 0;
+        return put(oid, data);
+    }
+
+    /**
+      * Delete object if it exists
+      * @param oid Object ID
+      * @param old_size Set to the size of the object deleted
+      * @return bool Indicates whether the object existed
+      */
+    virtual bool erase(uint64_t oid, uint64_t* old_size) {
+        if (!exists(oid)) {
+            return false;
+        }
+        *old_size = size(oid);
+        return delet(oid);
+    }
+
+    /**
+      * Overwrite part of an object. The object keeps its size
+      * Nothing is written if the bytes go past the end of the object
+      * The default implementation writes the whole object again
+      * @param oid Object ID
+      * @param offset Offset of the first byte overwritten
+      * @param data Bytes written
+      * @param size Set to the size of the object, if it exists
+      * @return bool Indicates whether the object exists
+      */
+    virtual bool write_at(uint64_t oid, uint64_t offset,
+            const MemSlice& data, uint64_t* size) {
+        LookupResult old = lookup(oid);
+        if (!old.found) {
+            return false;
+        }
+        *size = old.data.size();
+        if (offset > *size || data.size() > *size - offset ||
+            data.size() == 0) {
+            return true;
+        }
+        std::vector<int8_t> object = old.data.get();
+        std::copy(data.data(), data.data() + data.size(),
+                object.begin() + offset);
+        uint64_t old_size;
+        return upsert(oid, MemSlice(&object), &old_size);
+    }
+
+    /**
+      * Modify an object in place. The object keeps its size
+      * The default implementation writes the whole object again
+      * @param oid Object ID
+      * @param modify Called with the bytes of the object and their number
+      * @return bool Indicates whether the object exists
+      */
+    virtual bool update(uint64_t oid,
+            const std::function<void(char*, uint64_t)>& modify) {
+        LookupResult old = lookup(oid);
+        if (!old.found) {
+            return false;
+        }
+        std::vector<int8_t> object(old.data.data(),
+                old.data.data() + old.data.size());
+        old.data = MemSlice();
+        modify(reinterpret_cast<char*>(object.data()), object.size());
+        uint64_t old_size;
+        return upsert(oid, MemSlice(&object), &old_size);
+    }
+
+    /**
+      * Find several objects
+      * @param oids Object IDs
+      * @return LookupResult of each object, in the order of oids
+      */
+    virtual std::vector<LookupResult> get_bulk(
+            const std::vector<uint64_t>& oids) const {
+        std::vector<LookupResult> results;
+        results.reserve(oids.size());
+        for (const auto& oid : oids) {
+            results.push_back(lookup(oid));
+        }
+        return results;
+    }
+
+    /**
+      * Put several objects, replacing the objects under the same ids
+      * @param oids Object IDs
+      * @param data MemSlice of each object, in the order of oids
+      * @param old_bytes Set to the total size of the objects replaced
+      * @return Number of objects stored. Objects are stored in order:
+      * on failure the first objects (only) are stored
+      */
+    virtual uint64_t put_bulk(const std::vector<uint64_t>& oids,
+            const std::vector<MemSlice>& data, uint64_t* old_bytes) {
+        *old_bytes = 0;
+        for (uint64_t i = 0; i < oids.size(); ++i) {
+            uint64_t old_size;
+            if (!upsert(oids[i], data[i], &old_size)) {
+                return i;
+            }
+            *old_bytes += old_size;
+        }
+        return oids.size();
+    }
+
+    /**
+      * List the objects with ids in [first, last], in no particular order
+      * The default implementation cannot list the objects
+      * @param first First Object ID
+      * @param last Last Object ID (inclusive)
+      * @param oids The ids of the objects found are appended to it
+      * @return bool Whether the objects were listed. If not, callers
+      * probe every id of the range
+      */
+    virtual bool list_range(uint64_t /* first */, uint64_t /* last */,
+            std::vector<uint64_t>* /* oids */) const {
+        return false;
+    }
+
+    /**
+      * Get the memory taken for the objects
+      * The default implementation does not track it
+      * @param stats Set to the usage of the memory
+      * @return bool Whether the backend tracks its memory
+      */
+    virtual bool memory_stats(MemoryStats* /* stats */) const {
+        return false;
+    }
+
+    /**
+      * Delete all objects with ids in [first, last]
+      * The default implementation deletes the objects listed by
+      * list_range(), or probes every id of the range
+      * @param first First Object ID
+      * @param last Last Object ID (inclusive)
+      * @param old_bytes Set to the total size of the objects deleted
+      * @param erased If not null, the ids of the objects deleted are
+      * appended to it
+      * @return Number of objects deleted
+      */
+    virtual uint64_t erase_range(uint64_t first, uint64_t last,
+            uint64_t* old_bytes, std::vector<uint64_t>* erased = nullptr) {
+        uint64_t count = 0;
+        *old_bytes = 0;
+        if (first > last) {
+            return 0;
+        }
+        auto erase_one = [&](uint64_t oid) {
+            uint64_t old_size;
+            if (erase(oid, &old_size)) {
+                count++;
+                *old_bytes += old_size;
+                if (erased) {
+                    erased->push_back(oid);
+                }
+            }
+        };
+
+        std::vector<uint64_t> oids;
+        if (list_range(first, last, &oids)) {
+            for (const auto& oid : oids) {
+                erase_one(oid);
+            }
+            return count;
+        }
+        // oid == last is checked before the increment, which could wrap
+        for (uint64_t oid = first; ; ++oid) {
+            erase_one(oid);
+            if (oid == last) {
+                break;
+            }
+        }
+        return count;
+    }
+
+ protected:
+    /**
+      * Lists the ids of an index that are in [first, last]. Ranges
+      * narrower than the index are probed id by id, wider ones are found
+      * by scanning the index
+      * @param index Map from the ids to the objects
+      * @param first First Object ID
+      * @param last Last Object ID (inclusive)
+      * @param oids The ids found are appended to it
+      */
+    template <typename Index>
+    static void list_index_range(const Index& index, uint64_t first,
+            uint64_t last, std::vector<uint64_t>* oids) {
+        if (first > last) {
+            return;
+        }
+        if (last - first < index.size()) {
+            for (uint64_t oid = first; ; ++oid) {
+                if (index.find(oid) != index.end()) {
+                    oids->push_back(oid);
+                }
+                if (oid == last) {
+                    break;
+                }
+            }
+            return;
+        }
+        for (const auto& entry : index) {
+            if (entry.first >= first && entry.first <= last) {
+                oids->push_back(entry.first);
+            }
+        }
+    }
 };
 
 }  // namespace cirrus
@@ -1,77 +1,360 @@
 #include "server/TCPServer.h"
 
 #include <poll.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <linux/errqueue.h>
 #include <unistd.h>
 #include <string.h>
+#include <climits>
+#include <limits>
 #include <map>
+#include <numeric>
 #include <vector>
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <iostream>
 #include <cstdint>
 
 #include "MemoryBackend.h"
 #include "NVStorageBackend.h"
+#include "LogStorageBackend.h"
+#include "SlabBackend.h"
+#include "TieredBackend.h"
+#include "WriteAheadLog.h"
+#include "VectorKernels.h"
 
 #include "utils/logging.h"
+#include "utils/CirrusTime.h"
 #include "common/Exception.h"
 #include "common/schemas/TCPBladeMessage_generated.h"
 
 namespace cirrus {
 
-using TxnID = uint64_t;
-
 // size for Flatbuffer's buffer
 static const int initial_buffer_size = 50;
+// max number of events returned by a single call to epoll_wait()
+static const int max_epoll_events = 64;
+// max number of slices given to a single call to sendmsg()
+static const int max_iovecs = IOV_MAX;
+// min number of bytes read from a socket at once
+static const uint64_t read_chunk_size = 64 * 1024;
+// size of the blocks replies are copied into
+static const uint64_t reply_block_size = 64 * 1024;
+// bytes of replies after which a connection stops reading requests
+// until the replies are sent
+static const uint64_t max_pending_reply_size = 4 * 1024 * 1024;
+// longest a watch waits, longer timeouts are cut to it
+static const uint64_t max_watch_timeout_ms = 24 * 3600 * 1000;
+// resolution of the TTLs of objects
+static const uint64_t expiry_tick_ms = 100;
+// slots of the timing wheel of the TTLs, a revolution takes 51.2 s
+static const uint64_t expiry_slots = 512;
+// most objects taken from the timing wheel at once, so that requests do
+// not wait for long
+static const uint64_t max_expirations_per_lock = 1024;
+// most objects a range read or a function call covers, wider ranges are
+// rejected rather than probed id by id
+static const uint64_t max_range_size = 1024 * 1024;
+
+/**
+  * Puts a socket in non blocking mode.
+  * @param sock the fd of the socket
+  */
+static void set_nonblocking(int sock) {
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1) {
+        throw cirrus::ConnectionException("Error setting socket non blocking");
+    }
+}
 
 /**
   * Constructor for the server. Given a port and queue length, sets the values
   * of the variables.
   * @param port the port the server will listen on
   * @param pool_size_ the number of bytes to have in the memory pool.
-  * @param backend the Type of backend: "Memory" or "Storage"
-  * @param storage_path Path to disk storage. Used when backend is "Storage"
+  * @param backend the Type of backend: "Memory", "Slab", "Storage", "Log"
+  * or "Tiered"
+  * @param storage_path Path to disk storage. Used when backend is "Storage",
+  * "Log" or "Tiered"
   * @param max_fds_ the maximum number of clients that can be connected to the
   * server at the same time.
+  * @param num_threads the number of reactor threads serving connections.
   */
 TCPServer::TCPServer(int port, uint64_t pool_size_,
                      const std::string& backend,
                      const std::string& storage_path,
-                     uint64_t max_fds_) :
-    port_(port), pool_size(pool_size_), max_fds(max_fds_ + 1) {
+                     uint64_t max_fds_,
+                     uint64_t num_threads) :
+    port_(port), pool_size(pool_size_), backend_type(backend),
+    storage_path(storage_path),
+    expirations(expiry_tick_ms, expiry_slots),
+    start_time(std::chrono::steady_clock::now()),
+    max_fds(max_fds_ + 1), num_threads(num_threads) {
     if (max_fds_ + 1 == 0) {
         throw cirrus::Exception("Max_fds value too high, "
             "overflow occurred.");
     }
+    if (num_threads == 0) {
+        throw cirrus::Exception("TCPServer needs at least one thread.");
+    }
 
-    if (backend == "Memory") {
-        mem = std::make_unique<MemoryBackend>(100'000'000);
-    } else if (backend == "Storage") {
-        mem = std::make_unique<NVStorageBackend>(storage_path);
-    } else {
+    if (backend != "Memory" && backend != "Storage" && backend != "Slab" &&
+        backend != "Log" && backend != "Tiered") {
         throw std::runtime_error("Wrong backend option");
     }
 
-    mem->init();  // initialize memory backend
+    base_version = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    last_version = base_version;
+}
+
+/**
+  * Sets the minimum size of a send to use MSG_ZEROCOPY. With MSG_ZEROCOPY
+  * the kernel sends the pages of the data instead of copying them, which
+  * pays off for large objects only.
+  * @param bytes the threshold, 0 to disable MSG_ZEROCOPY
+  */
+void TCPServer::set_zerocopy_threshold(uint64_t bytes) {
+#ifdef MSG_ZEROCOPY
+    zerocopy_threshold = bytes;
+#else
+    if (bytes > 0) {
+        LOG<ERROR>("MSG_ZEROCOPY is not supported on this system");
+    }
+#endif
+}
+
+/**
+  * Backs the memory of the Slab backend with huge pages.
+  * Must be called before init().
+  * @param enable whether to use huge pages
+  */
+void TCPServer::set_huge_pages(bool enable) {
+    huge_pages = enable;
+}
+
+/**
+  * Sets when the Tiered backend demotes objects to disk: once the objects
+  * in memory go above high * pool_size, the least recently used ones are
+  * demoted until they are under low * pool_size.
+  * Must be called before init().
+  * @param high the high watermark, fraction of pool_size
+  * @param low the low watermark, fraction of pool_size
+  */
+void TCPServer::set_watermarks(double high, double low) {
+    high_watermark = high;
+    low_watermark = low;
+}
+
+/**
+  * Runs the server as a cache: when the pool is full, writes evict the
+  * least recently used objects instead of failing.
+  * Must be called before init().
+  * @param enable whether to evict objects
+  */
+void TCPServer::set_cache_mode(bool enable) {
+    cache_mode = enable;
+}
+
+/**
+  * Makes the Memory backend be snapshotted to storage_path periodically.
+  * On init() the objects of the last snapshot are loaded back.
+  * Must be called before init().
+  * @param seconds time between snapshots, 0 to disable snapshots
+  */
+void TCPServer::set_snapshot_interval(uint64_t seconds) {
+    snapshot_interval = seconds;
+}
+
+/**
+  * Sets the size up to which the Memory backend keeps objects in its
+  * index instead of allocating them separately. Must be called before
+  * init().
+  * @param bytes largest size of the objects kept inline. Values above
+  * MemoryBackend::max_inline_size are lowered to it
+  */
+void TCPServer::set_inline_threshold(uint64_t bytes) {
+    inline_threshold = bytes;
+}
+
+/**
+  * Loads a plugin of functions that clients can run on objects (see
+  * NearDataFunction.h). Must be called before init().
+  * Throws std::runtime_error if the plugin cannot be loaded.
+  * @param path path of the shared object
+  */
+void TCPServer::load_plugin(const std::string& path) {
+    functions.load(path);
+}
+
+/**
+  * Sets the quotas of the applications without quotas of their own,
+  * including the connections that do not authenticate. Must be called
+  * before init().
+  * @param limits the limits, 0 for no limit
+  */
+void TCPServer::set_default_quota(const QuotaManager::Limits& limits) {
+    quotas.setDefaultLimits(limits);
+}
+
+/**
+  * Registers an application, whose quotas only apply to the clients that
+  * authenticate with its key. Must be called before init().
+  * @param app_id the application
+  * @param key the key of the application
+  */
+void TCPServer::set_app_key(AppId app_id, const std::string& key) {
+    authenticator.addApplication(app_id, key);
+}
+
+/**
+  * Sets the quotas of an application. Must be called before init().
+  * @param app_id the application
+  * @param limits the limits, 0 for no limit
+  */
+void TCPServer::set_quota(AppId app_id, const QuotaManager::Limits& limits) {
+    quotas.setLimits(app_id, limits);
+}
+
+/**
+  * Makes the Memory backend log writes and removes to storage_path and
+  * replay them on init(). Acks are only sent once the log is synced.
+  * Without a snapshot interval, a snapshot is taken whenever the log grows
+  * past pool_size, so that the log is truncated and recovery does not
+  * replay the whole history.
+  * Must be called before init().
+  * @param enable whether to log writes
+  */
+void TCPServer::set_wal(bool enable) {
+    use_wal = enable;
+}
+
+/**
+  * Gets the cache statistics of the server, also sent to the clients
+  * that ask for them with a CacheStats message.
+  * @return the number of hits, misses and evictions so far
+  */
+TCPServer::CacheStats TCPServer::cache_stats() {
+    std::lock_guard<std::mutex> guard(mem_lock);
+    return cache_counters;
+}
+
+TCPServer::~TCPServer() {
+    {
+        std::lock_guard<std::mutex> guard(snapshot_lock);
+        terminate_snapshots = true;
+    }
+    snapshot_cv.notify_all();
+    if (snapshot_thread.joinable()) {
+        snapshot_thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> guard(expiry_lock);
+        terminate_expiry = true;
+    }
+    expiry_cv.notify_all();
+    if (expiry_thread.joinable()) {
+        expiry_thread.join();
+    }
+    for (const auto& list : watch_lists) {
+        if (list.wake_fd != -1) {
+            close(list.wake_fd);
+        }
+    }
 }
 
 /**
-  * Initializer for the server. Sets up the socket it uses to listen for
-  * incoming connections.
+  * Initializer for the server. Sets up the backend and the socket it uses to
+  * listen for incoming connections. In multi-threaded mode one listening
+  * socket is created per reactor thread.
   */
 void TCPServer::init() {
-    server_sock_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_sock_ < 0) {
+    if (backend_type == "Memory") {
+        mem = std::make_unique<MemoryBackend>(100'000'000,
+                inline_threshold);
+    } else if (backend_type == "Slab") {
+        // Slots are rounded up to their size class.
+        // Objects only take the pages they touch.
+        mem = std::make_unique<SlabBackend>(2 * pool_size, huge_pages);
+    } else if (backend_type == "Log") {
+        mem = std::make_unique<LogStorageBackend>(storage_path);
+    } else if (backend_type == "Tiered") {
+        // pool_size bounds the memory tier only
+        mem = std::make_unique<TieredBackend>(
+                std::make_unique<MemoryBackend>(100'000'000,
+                    inline_threshold),
+                std::make_unique<NVStorageBackend>(storage_path),
+                pool_size, high_watermark, low_watermark);
+    } else {
+        mem = std::make_unique<NVStorageBackend>(storage_path);
+    }
+    mem->init();  // initialize memory backend
+    max_size = backend_type == "Tiered" ?
+        std::numeric_limits<uint64_t>::max() : pool_size;
+
+    // Persistent backends reopen with the objects of the previous run
+    StorageBackend::MemoryStats recovered = {0, 0, 0};
+    if (mem->memory_stats(&recovered)) {
+        curr_size = recovered.bytes_requested;
+    }
+
+    if (backend_type == "Memory" && (snapshot_interval > 0 || use_wal)) {
+        recover();
+    }
+    if (backend_type == "Memory" && (snapshot_interval > 0 || use_wal)) {
+        snapshot_thread = std::thread(&TCPServer::snapshot_loop, this);
+    }
+
+    server_sock_ = create_listen_socket();
+    watch_lists = std::vector<WatchList>(num_threads);
+
+    if (num_threads > 1) {
+        reactor_socks_.push_back(server_sock_);
+        for (uint64_t i = 1; i < num_threads; ++i) {
+            reactor_socks_.push_back(create_listen_socket());
+        }
+        // Watches fire on the thread of the write, which wakes up the
+        // thread of the watch
+        for (auto& list : watch_lists) {
+            list.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (list.wake_fd == -1) {
+                throw cirrus::ConnectionException(
+                        "Server error creating eventfd");
+            }
+        }
+        return;
+    }
+
+    fds.at(curr_index).fd = server_sock_;
+    // Only listen for data to read
+    fds.at(curr_index++).events = POLLIN;
+}
+
+/**
+  * Creates a socket listening on the server's port. Sockets are created with
+  * SO_REUSEPORT so that several of them can be bound to the same port.
+  * @return the fd of the new socket
+  */
+int TCPServer::create_listen_socket() {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
         throw cirrus::ConnectionException("Server error creating socket");
     }
 
     LOG<INFO>("Created socket in TCPServer");
 
     int opt = 1;
-    if (setsockopt(server_sock_, SOL_SOCKET, SO_REUSEADDR, &opt,
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt,
                    sizeof(opt))) {
         switch (errno) {
             case EBADF:
@@ -93,11 +376,11 @@ void TCPServer::init() {
         throw cirrus::ConnectionException("Error forcing port binding");
     }
 
-    if (setsockopt(server_sock_, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt))) {
+    if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt))) {
         throw cirrus::ConnectionException("Error setting socket options.");
     }
 
-    if (setsockopt(server_sock_, SOL_SOCKET, SO_REUSEPORT, &opt,
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt,
                    sizeof(opt))) {
         switch (errno) {
             case EBADF:
@@ -125,7 +408,7 @@ void TCPServer::init() {
     serv_addr.sin_port = htons(port_);
     std::memset(serv_addr.sin_zero, 0, sizeof(serv_addr.sin_zero));
 
-    int ret = bind(server_sock_, reinterpret_cast<sockaddr*>(&serv_addr),
+    int ret = bind(sock, reinterpret_cast<sockaddr*>(&serv_addr),
             sizeof(serv_addr));
     if (ret < 0) {
         throw cirrus::ConnectionException("Error binding in port "
@@ -133,14 +416,12 @@ void TCPServer::init() {
     }
 
     // SOMAXCONN is the "max reasonable backlog size" defined in socket.h
-    if (listen(server_sock_, SOMAXCONN) == -1) {
+    if (listen(sock, SOMAXCONN) == -1) {
         throw cirrus::ConnectionException("Error listening on port "
             + to_string(port_));
     }
 
-    fds.at(curr_index).fd = server_sock_;
-    // Only listen for data to read
-    fds.at(curr_index++).events = POLLIN;
+    return sock;
 }
 
 /**
@@ -159,15 +440,27 @@ bool TCPServer::testRemove(struct pollfd x) {
 }
 /**
   * Server processing loop. When called, server loops infinitely, accepting
-  * new connections and acting on messages received.
+  * new connections and acting on messages received. In multi-threaded mode
+  * this starts the reactor threads and waits for them.
   */
 void TCPServer::loop() {
+    if (num_threads > 1) {
+        for (uint64_t i = 0; i < reactor_socks_.size(); ++i) {
+            reactors_.emplace_back(&TCPServer::reactor_loop, this,
+                    reactor_socks_[i], i);
+        }
+        for (auto& reactor : reactors_) {
+            reactor.join();
+        }
+        return;
+    }
+
     struct sockaddr_in cli_addr;
     socklen_t clilen = sizeof(cli_addr);
 
     while (1) {
         LOG<INFO>("Server calling poll.");
-        int poll_status = poll(fds.data(), curr_index, timeout);
+        int poll_status = poll(fds.data(), curr_index, wait_timeout(0));
         LOG<INFO>("Poll returned with status: ", poll_status);
 
         if (poll_status == -1) {
@@ -182,21 +475,22 @@ void TCPServer::loop() {
                 if (curr_fd.fd == -1) {
                     continue;
                 }
-                if (curr_fd.revents != POLLIN) {
+                if (curr_fd.revents == 0) {
+                    continue;
+                }
+                if (curr_fd.revents & (POLLHUP | POLLNVAL)) {
                     LOG<ERROR>("Non read event on socket: ", curr_fd.fd);
-                    if (curr_fd.revents & POLLHUP) {
-                        LOG<INFO>("Connection was closed by client");
-                        LOG<INFO>("Closing socket: ", curr_fd.fd);
-                        close(curr_fd.fd);
-                        curr_fd.fd = -1;
-                    }
-
+                    LOG<INFO>("Connection was closed by client");
+                    LOG<INFO>("Closing socket: ", curr_fd.fd);
+                    cancel_watches(0, curr_fd.fd);
+                    connections.erase(curr_fd.fd);
+                    close(curr_fd.fd);
+                    curr_fd.fd = -1;
                 } else if (curr_fd.fd == server_sock_) {
                     LOG<INFO>("New connection incoming");
 
                     // New data on main socket, accept and connect
                     // TODO(Tyler): loop this to accept multiple at once?
-                    // TODO(Tyler): Switch to non blocking sockets?
                     int newsock = accept(server_sock_,
                             reinterpret_cast<struct sockaddr*>(&cli_addr),
                             &clilen);
@@ -208,20 +502,46 @@ void TCPServer::loop() {
                         close(newsock);
                     } else {
                         LOG<INFO>("Created new socket: ", newsock);
+                        set_nonblocking(newsock);
+                        auto conn = connections.emplace(newsock,
+                                Connection(newsock, 0));
+                        enable_zerocopy(conn.first->second);
                         fds.at(curr_index).fd = newsock;
                         fds.at(curr_index).events = POLLIN;
                         curr_index++;
                     }
                 } else {
-                    if (!process(curr_fd.fd)) {
+                    Connection& conn = connections.at(curr_fd.fd);
+                    if (!handle_events(conn, curr_fd.revents & POLLIN,
+                                       curr_fd.revents & POLLOUT,
+                                       curr_fd.revents & POLLERR)) {
                         LOG<INFO>("Processing failed on socket: ", curr_fd.fd);
+                        cancel_watches(0, curr_fd.fd);
+                        connections.erase(curr_fd.fd);
+                        close(curr_fd.fd);
                         // do not make future alerts on this fd
                         curr_fd.fd = -1;
+                    } else {
+                        // Stop reading while replies are pending
+                        curr_fd.events =
+                            conn.write_pending() ? POLLOUT : POLLIN;
                     }
                 }
                 curr_fd.revents = 0;  // Reset the event flags
             }
         }
+        // Replies of the watches that fired or expired, and invalidations
+        std::vector<int> ready = complete_watches(0, &connections);
+        for (int fd : send_invalidations(0, &connections)) {
+            ready.push_back(fd);
+        }
+        for (int fd : ready) {
+            for (uint64_t i = 0; i < curr_index; i++) {
+                if (fds.at(i).fd == fd) {
+                    fds.at(i).events = POLLOUT;
+                }
+            }
+        }
         // If at max capacity, try to make room
         if (curr_index == max_fds) {
             // Try to purge unused fds, those with fd == -1
@@ -233,211 +553,1853 @@ void TCPServer::loop() {
 }
 
 /**
- * Guarantees that an entire message is sent.
- * @param sock the fd of the socket to send on.
- * @param data a pointer to the data to send.
- * @param len the number of bytes to send.
- * @param flags for the send call.
- * @return the number of bytes sent.
- */
-ssize_t TCPServer::send_all(int sock, const void* data, size_t len,
-    int /* flags */) {
-    uint64_t to_send = len;
-    uint64_t total_sent = 0;
-    int64_t sent = 0;
-
-    while (to_send != total_sent) {
-        sent = send(sock, data, len - total_sent, 0);
-
-        if (sent == -1) {
-            LOG<ERROR>("Server error sending data to client, "
-                "possible client died");
-            return -1;
-        }
+  * Loop run by each reactor thread. The thread owns an epoll instance, its
+  * listening socket and every connection accepted on that socket.
+  * @param listen_sock the listening socket of this reactor
+  * @param reactor the index of this reactor
+  */
+void TCPServer::reactor_loop(int listen_sock, uint64_t reactor) {
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        throw cirrus::ConnectionException("Server error creating epoll fd");
+    }
 
-        total_sent += sent;
+    // accept() is called until EAGAIN so the listening socket
+    // must not block
+    set_nonblocking(listen_sock);
+    std::unordered_map<int, Connection> connections;
 
-        // Increment the pointer to data we're sending by the amount just sent
-        data = static_cast<const char*>(data) + sent;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_sock;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_sock, &ev) == -1) {
+        throw cirrus::ConnectionException("Server error calling epoll_ctl");
+    }
+    int wake_fd = watch_lists[reactor].wake_fd;
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) == -1) {
+        throw cirrus::ConnectionException("Server error calling epoll_ctl");
     }
 
-    return total_sent;
-}
+    // Stop reading while replies are pending
+    auto update_events = [epoll_fd](Connection& conn) {
+        if (conn.write_pending() == conn.want_write) {
+            return;
+        }
+        conn.want_write = conn.write_pending();
+        struct epoll_event mod_ev;
+        mod_ev.events = conn.want_write ? EPOLLOUT : EPOLLIN;
+        mod_ev.data.fd = conn.fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &mod_ev) == -1) {
+            throw cirrus::ConnectionException(
+                    "Server error calling epoll_ctl");
+        }
+    };
 
-/**
- * Guarantees that an entire message is read.
- * @param sock the fd of the socket to read on.
- * @param data a pointer to the buffer to read into.
- * @param len the number of bytes to read.
- * @return the number of bytes sent.
- */
-ssize_t TCPServer::read_all(int sock, void* data, size_t len) {
-    uint64_t bytes_read = 0;
+    std::vector<struct epoll_event> events(max_epoll_events);
+    while (1) {
+        int num_events = epoll_wait(epoll_fd, events.data(),
+                                    events.size(), wait_timeout(reactor));
+        if (num_events == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw cirrus::ConnectionException("Server error calling epoll.");
+        } else if (num_events == 0) {
+            LOG<INFO>(timeout, " milliseconds elapsed without contact.");
+        }
+
+        for (int i = 0; i < num_events; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listen_sock) {
+                accept_connections(epoll_fd, listen_sock, reactor,
+                        &connections);
+                continue;
+            } else if (fd == wake_fd) {
+                // The watches are completed below
+                uint64_t count;
+                if (read(wake_fd, &count, sizeof(count)) == -1 &&
+                    errno != EAGAIN) {
+                    throw cirrus::ConnectionException(
+                            "Server error reading eventfd");
+                }
+                continue;
+            }
 
-    while (bytes_read < len) {
-        int64_t retval = read(sock, reinterpret_cast<char*>(data) + bytes_read,
-            len - bytes_read);
+            Connection& conn = connections.at(fd);
+            bool keep = true;
+            if (events[i].events & EPOLLHUP) {
+                LOG<INFO>("Connection was closed by client");
+                keep = false;
+            } else if (!handle_events(conn, events[i].events & EPOLLIN,
+                                      events[i].events & EPOLLOUT,
+                                      events[i].events & EPOLLERR)) {
+                LOG<INFO>("Processing failed on socket: ", fd);
+                keep = false;
+            }
 
-        if (retval == -1) {
-            char *error = strerror(errno);
-            LOG<ERROR>(error);
-            throw cirrus::Exception("Error reading from client");
+            if (!keep) {
+                LOG<INFO>("Closing socket: ", fd);
+                cancel_watches(reactor, fd);
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+                connections.erase(fd);
+                close(fd);
+                num_connections--;
+            } else {
+                update_events(conn);
+            }
         }
 
-        bytes_read += retval;
+        // Replies of the watches that fired or expired, and invalidations
+        for (int fd : complete_watches(reactor, &connections)) {
+            update_events(connections.at(fd));
+        }
+        for (int fd : send_invalidations(reactor, &connections)) {
+            update_events(connections.at(fd));
+        }
     }
-
-    return bytes_read;
 }
 
 /**
-  * Read header from client's message or return false if client has disconnected
-  * @param buffer Buffer where data is stored
-  * @param sock Socket used for communication
-  * @param bytes_read Keeps track of how many bytes have been read
-  * @param Return false if client disconnected, true otherwise
+  * Accepts every connection pending on a reactor's listening socket and
+  * adds it to the reactor's epoll instance.
+  * @param epoll_fd the epoll instance of the reactor
+  * @param listen_sock the listening socket of the reactor
+  * @param reactor the index of the reactor
+  * @param connections the connections owned by the reactor
   */
-bool TCPServer::read_from_client(
-        std::vector<char>& buffer, int sock, uint64_t& bytes_read) {
-    bool first_loop = true;
-    while (bytes_read < static_cast<int>(sizeof(uint32_t))) {
-        int retval = read(sock, buffer.data() + bytes_read,
-                          sizeof(uint32_t) - bytes_read);
+void TCPServer::accept_connections(int epoll_fd, int listen_sock,
+        uint64_t reactor, std::unordered_map<int, Connection>* connections) {
+    struct sockaddr_in cli_addr;
+    socklen_t clilen = sizeof(cli_addr);
 
-        if (first_loop && retval == 0) {
-            // Socket is closed by client if 0 bytes are available
-            close(sock);
-            LOG<INFO>("Closing socket: ", sock);
-            return false;
+    while (1) {
+        int newsock = accept(listen_sock,
+                reinterpret_cast<struct sockaddr*>(&cli_addr), &clilen);
+        if (newsock < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return;
+            }
+            throw std::runtime_error("Error accepting socket");
         }
-        if (retval < 0) {
-            throw cirrus::Exception("Server issue in reading "
-                                    "socket during size read.");
+
+        // If at capacity, reject connection
+        if (num_connections.fetch_add(1) >= max_fds - 1) {
+            num_connections--;
+            close(newsock);
+            continue;
         }
 
-        bytes_read += retval;
-        first_loop = false;
+        // On Linux accepted sockets do not inherit O_NONBLOCK
+        set_nonblocking(newsock);
+        auto conn = connections->emplace(newsock,
+                Connection(newsock, reactor));
+        enable_zerocopy(conn.first->second);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = newsock;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, newsock, &ev) == -1) {
+            throw cirrus::ConnectionException("Server error calling epoll_ctl");
+        }
+        LOG<INFO>("Created new socket: ", newsock);
     }
-    return true;
 }
 
-int64_t checksum(const std::vector<int8_t>& data) {
-    int64_t sum = 0;
-    for (const auto& d : data) {
-        sum += d;
+/**
+  * Turns on MSG_ZEROCOPY for a new connection, if enabled on the server.
+  * @param conn the connection
+  */
+void TCPServer::enable_zerocopy(Connection& conn) {
+#ifdef SO_ZEROCOPY
+    int opt = 1;
+    if (zerocopy_threshold > 0 &&
+        setsockopt(conn.fd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)) == 0) {
+        conn.zerocopy = true;
     }
-    return sum;
+#else
+    (void) conn;
+#endif
 }
 
 /**
- * Process the message incoming on a particular socket. Reads in the message
- * from the socket, extracts the flatbuffer, and then acts depending on
- * the type of the message.
- * @param sock the file descriptor for the socket with an incoming message.
- */
-bool TCPServer::process(int sock) {
-    LOG<INFO>("Processing socket: ", sock);
-    std::vector<char> buffer;
-
-    // Read in the incoming message
+  * Acts on the events reported for a connection. Pending replies are sent
+  * first. New messages are only read once all replies went out, so that a
+  * client that does not read its replies cannot make the server buffer an
+  * unbounded amount of data.
+  * @param conn the connection
+  * @param readable whether the socket has data to read
+  * @param writable whether the socket can take more data
+  * @param error whether an error was reported on the socket
+  * @return false if the connection should be closed
+  */
+bool TCPServer::handle_events(Connection& conn, bool readable,
+        bool writable, bool error) {
+    if (error && !handle_error(conn)) {
+        return false;
+    }
+    if (writable && !flush(conn)) {
+        return false;
+    }
+    if (readable && !conn.write_pending()) {
+        return handle_read(conn);
+    }
+    return true;
+}
 
-    // Reserve the size of a 32 bit int
-    uint64_t current_buf_size = sizeof(uint32_t);
-    buffer.reserve(current_buf_size);
-    uint64_t bytes_read = 0;
+/**
+  * Handles an error reported on a socket. Completions of MSG_ZEROCOPY
+  * sends are reported as errors; anything else closes the connection.
+  * @param conn the connection
+  * @return false if the connection should be closed
+  */
+bool TCPServer::handle_error(Connection& conn) {
+    if (zerocopy_threshold == 0) {
+        return false;
+    }
 
-    bool ret = read_from_client(buffer, sock, bytes_read);
-    if (!ret) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 ||
+        err != 0) {
+        LOG<ERROR>("Error on socket: ", conn.fd);
         return false;
     }
+    return reap_zerocopy(conn);
+}
+
+/**
+  * Reads the MSG_ZEROCOPY completions queued on a socket and releases the
+  * data of the sends that completed.
+  * @param conn the connection
+  * @return false if the socket failed
+  */
+bool TCPServer::reap_zerocopy(Connection& conn) {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    while (1) {
+        char control[128];
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(conn.fd, &msg, MSG_ERRQUEUE) == -1) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            LOG<ERROR>("Error reading socket error queue: ", strerror(errno));
+            return false;
+        }
 
-    LOG<INFO>("Server received size from client");
-    // Convert to host byte order
-    uint32_t* incoming_size_ptr = reinterpret_cast<uint32_t*>(buffer.data());
-    uint32_t incoming_size = ntohl(*incoming_size_ptr);
-    LOG<INFO>("Server received incoming size of ", incoming_size);
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+             cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) {
+                continue;
+            }
+            auto serr = reinterpret_cast<struct sock_extended_err*>(
+                    CMSG_DATA(cmsg));
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+                serr->ee_errno != 0) {
+                continue;
+            }
 
-    // Resize the buffer to be larger if necessary
-#ifdef PERF_LOG
-    TimerFunction resize_time;
-#endif
-    if (incoming_size > current_buf_size) {
-        // We use reserve() in place of resize() as it does not initialize the
-        // memory that it allocates. This is safe, but buffer.capacity() must
-        // be used to find the length of the buffer rather than buffer.size()
-        buffer.reserve(incoming_size);
+            // Sends ee_info up to ee_data (inclusive) completed.
+            // Ids are 32 bits and may wrap around.
+            uint32_t first = serr->ee_info;
+            uint32_t last = serr->ee_data;
+            for (auto it = conn.zerocopy_inflight.begin();
+                 it != conn.zerocopy_inflight.end();) {
+                if (it->first - first <= last - first) {
+                    it = conn.zerocopy_inflight.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            // The kernel copied the data anyway (e.g., on loopback).
+            // Pinning the pages would only add overhead.
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                conn.zerocopy = false;
+            }
+        }
     }
-#ifdef PERF_LOG
-    LOG<PERF>("TCPServer::process resize time (us): ",
-            resize_time.getUsElapsed());
+#else
+    (void) conn;
+    return true;
 #endif
+}
 
+/**
+  * Reads requests from a client without blocking. The socket is read in
+  * large chunks and every complete request is processed. The replies are
+  * queued and sent together once no more data is available (or once too
+  * many replies are pending). Partial requests are resumed on the next event.
+  * @param conn the connection to read from
+  * @return false if the client disconnected or the connection failed
+  */
+bool TCPServer::handle_read(Connection& conn) {
+    // Reused for all the replies
+    flatbuffers::FlatBufferBuilder builder(initial_buffer_size);
+    while (1) {
+        reserve_input(conn);
+        uint64_t space = conn.in_capacity - conn.in_end;
+        int64_t retval = read(conn.fd, conn.in_buf.get() + conn.in_end, space);
+        if (retval == 0) {
+            // Socket is closed by client if 0 bytes are available
+            return false;
+        } else if (retval < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            char *error = strerror(errno);
+            LOG<ERROR>("Error reading from client: ", error);
+            return false;
+        }
 
-#ifdef PERF_LOG
-    TimerFunction receive_time;
-#endif
+        conn.in_end += retval;
+        if (!process_requests(conn, builder)) {
+            return false;
+        }
 
-    read_all(sock, buffer.data(), incoming_size);
+        // A short read means there is nothing left in the socket
+        if (static_cast<uint64_t>(retval) < space ||
+            conn.out_size >= max_pending_reply_size) {
+            break;
+        }
+    }
 
-#ifdef PERF_LOG
-    double recv_mbps = bytes_read / (1024.0 * 1024) /
-        (receive_time.getUsElapsed() / 1000000.0);
-    LOG<PERF>("TCPServer::process receive time (us): ",
-            receive_time.getUsElapsed(),
-            " bw (MB/s): ", recv_mbps);
-#endif
-    LOG<INFO>("Server received full message from client");
+    if (wal && conn.wal_lsn > wal->durable_lsn()) {
+        // The acks are sent on the next wakeup, with a single sync of the
+        // log for all the connections processed in this one
+        return true;
+    }
+    return flush(conn);
+}
 
-    // Extract the message from the buffer
-    auto msg = message::TCPBladeMessage::GetTCPBladeMessage(buffer.data());
-    TxnID txn_id = msg->txnid();
-    // Instantiate the builder
-    flatbuffers::FlatBufferBuilder builder(initial_buffer_size);
+/**
+  * Makes room in the read buffer of a connection for the next read. The
+  * buffer has room for at least read_chunk_size bytes and for the whole
+  * request that is partially read, if any.
+  * @param conn the connection
+  */
+void TCPServer::reserve_input(Connection& conn) {
+    uint64_t pending = conn.in_end - conn.in_begin;
+    uint64_t needed = read_chunk_size;
+    if (pending >= sizeof(uint32_t)) {
+        uint32_t msg_size;
+        std::memcpy(&msg_size, conn.in_buf.get() + conn.in_begin,
+                sizeof(uint32_t));
+        needed = std::max(needed, sizeof(uint32_t) + ntohl(msg_size));
+    }
 
-    // Initialize the error code
-    cirrus::ErrorCodes error_code = cirrus::ErrorCodes::kOk;
+    if (conn.in_capacity - conn.in_begin >= needed) {
+        return;
+    }
 
-    LOG<INFO>("Server checking type of message");
-    // Check message type
-    bool success = true;
-    switch (msg->message_type()) {
-        case message::TCPBladeMessage::Message_Write:
-            {
-#ifdef PERF_LOG
-                TimerFunction write_time;
-#endif
-                // first see if the object exists on the server.
-                // If so, overwrite it and account for the size change.
-                ObjectID oid = msg->message_as_Write()->oid();
-                LOG<INFO>("Server processing WRITE request to oid: .", oid);
+    if (conn.in_capacity < needed) {
+        // Grow the buffer
+        std::unique_ptr<char[]> in_buf(new char[needed]);
+        if (pending > 0) {
+            std::memcpy(in_buf.get(), conn.in_buf.get() + conn.in_begin,
+                    pending);
+        }
+        conn.in_buf = std::move(in_buf);
+        conn.in_capacity = needed;
+    } else {
+        // Move the partial request to the front
+        std::memmove(conn.in_buf.get(), conn.in_buf.get() + conn.in_begin,
+                pending);
+    }
+    conn.in_begin = 0;
+    conn.in_end = pending;
+}
 
-                // update current used size
-                // XXX maybe tracking this size should be done by the backend
-                if (mem->exists(oid)) {
-                    curr_size -= mem->size(oid);
-                }
+/**
+  * Processes every complete request in the read buffer of a connection.
+  * Each request is a 4 byte size followed by the flatbuffer message.
+  * @param conn the connection
+  * @param builder builder used for the replies
+  * @return false if the client sent an invalid request
+  */
+bool TCPServer::process_requests(Connection& conn,
+        flatbuffers::FlatBufferBuilder& builder) {
+    while (conn.in_end - conn.in_begin >= sizeof(uint32_t)) {
+        const char* request = conn.in_buf.get() + conn.in_begin;
+        uint32_t msg_size;
+        std::memcpy(&msg_size, request, sizeof(uint32_t));
+        // Convert to host byte order
+        msg_size = ntohl(msg_size);
+        if (msg_size == 0) {
+            LOG<ERROR>("Client sent an empty message");
+            return false;
+        }
+        if (conn.in_end - conn.in_begin < sizeof(uint32_t) + msg_size) {
+            // Wait for the rest of the message
+            break;
+        }
 
-                // Throw error if put would exceed size of the store
-                auto data_fb = msg->message_as_Write()->data();
-                if (curr_size + data_fb->size() > pool_size) {
-                    LOG<ERROR>("Put would go over capacity on server. ",
-                                "Current size: ", curr_size,
-                                " Incoming size: ", data_fb->size(),
-                                " Pool size: ", pool_size);
-                    error_code =
-                        cirrus::ErrorCodes::kServerMemoryErrorException;
-                    success = false;
-                } else {
-                    // Service the write request by
-                    // storing the serialized object
-                    mem->put(oid, MemSlice(data_fb));
+        LOG<INFO>("Server received full message of size ", msg_size);
+        builder.Clear();
+        if (!process(conn, request + sizeof(uint32_t), msg_size, builder)) {
+            return false;
+        }
+        conn.in_begin += sizeof(uint32_t) + msg_size;
+    }
 
-                    curr_size += data_fb->size();
-                }
+    if (conn.in_begin == conn.in_end) {
+        conn.in_begin = conn.in_end = 0;
+    }
+    return true;
+}
 
-                // Create and send ack
+/**
+  * Sends as much of the pending replies as the socket takes. The slices of
+  * the replies are handed to the kernel in a single call, without copying
+  * them first.
+  * @param conn the connection to send on
+  * @return false if the client died
+  */
+bool TCPServer::flush(Connection& conn) {
+    if (wal && !wal->sync(conn.wal_lsn)) {
+        LOG<ERROR>("Error syncing the write-ahead log");
+        return false;
+    }
+
+    struct iovec iov[max_iovecs];
+    while (conn.write_pending()) {
+        int iovcnt = 0;
+        uint64_t total = 0;
+        for (auto it = conn.out_queue.begin();
+             it != conn.out_queue.end() && iovcnt < max_iovecs; ++it) {
+            uint64_t offset = iovcnt == 0 ? conn.out_offset : 0;
+            iov[iovcnt].iov_base = const_cast<char*>(it->data() + offset);
+            iov[iovcnt].iov_len = it->size() - offset;
+            total += iov[iovcnt++].iov_len;
+        }
+
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        int flags = MSG_NOSIGNAL;
+        bool zerocopy = conn.zerocopy && total >= zerocopy_threshold;
+#ifdef MSG_ZEROCOPY
+        if (zerocopy) {
+            flags |= MSG_ZEROCOPY;
+        }
+#endif
+        int64_t sent = sendmsg(conn.fd, &msg, flags);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            } else if (errno == ENOBUFS && zerocopy) {
+                // Not enough memory to pin the pages, copy instead
+                conn.zerocopy = false;
+                continue;
+            }
+            LOG<ERROR>("Server error sending data to client, "
+                "possible client died");
+            return false;
+        }
+
+        if (zerocopy) {
+            // The kernel reads the data after sendmsg() returns,
+            // keep it until the send completes
+            auto& inflight = conn.zerocopy_inflight[conn.zerocopy_next_id++];
+            uint64_t held = 0;
+            for (auto it = conn.out_queue.begin();
+                 held < static_cast<uint64_t>(sent); ++it) {
+                held += it->size() -
+                    (it == conn.out_queue.begin() ? conn.out_offset : 0);
+                inflight.push_back(*it);
+            }
+        }
+
+        // Drop the slices that were fully sent
+        conn.out_size -= sent;
+        uint64_t left = sent;
+        while (left > 0) {
+            uint64_t remaining = conn.out_queue.front().size() - conn.out_offset;
+            if (left < remaining) {
+                conn.out_offset += left;
+                break;
+            }
+            left -= remaining;
+            conn.out_offset = 0;
+            conn.out_queue.pop_front();
+        }
+        if (conn.out_queue.empty()) {
+            conn.out_block_tail = false;
+        }
+    }
+
+    return true;
+}
+
+/**
+  * Queues a reply to a client. The reply is made of the flatbuffer message
+  * followed by the payload. The message is copied next to the previous
+  * replies so that they go out as one slice. The payload is not copied:
+  * its slices are sent as they are and kept until sent. Replies are sent
+  * by flush().
+  * @param conn the connection to send on
+  * @param builder builder containing the finished reply
+  * @param payload data to send after the flatbuffer
+  * @return false if the reply cannot be sent
+  */
+bool TCPServer::queue_reply(Connection& conn,
+        const flatbuffers::FlatBufferBuilder& builder,
+        std::vector<MemSlice>&& payload) {
+    uint64_t message_size = builder.GetSize();
+    uint64_t frame_size = message_size;
+    for (const auto& slice : payload) {
+        frame_size += slice.size();
+    }
+    if (frame_size > std::numeric_limits<uint32_t>::max()) {
+        LOG<ERROR>("Reply of size ", frame_size, " is too large");
+        return false;
+    }
+
+    uint64_t header_size = sizeof(uint32_t) + message_size;
+    if (conn.out_block && conn.out_block.use_count() == 1) {
+        // Nothing points to the block anymore, start over
+        conn.out_block->clear();
+        conn.out_block_tail = false;
+    }
+    if (!conn.out_block ||
+        conn.out_block->capacity() - conn.out_block->size() < header_size) {
+        // The block must never reallocate, slices point into it
+        conn.out_block = std::make_shared<std::vector<char>>();
+        conn.out_block->reserve(std::max(reply_block_size, header_size));
+        conn.out_block_tail = false;
+    }
+
+    std::vector<char>& block = *conn.out_block;
+    const char* begin = block.data() + block.size();
+    // Convert size to network order
+    uint32_t network_order_size = htonl(frame_size);
+    const char* size_ptr = reinterpret_cast<const char*>(&network_order_size);
+    const char* message =
+        reinterpret_cast<const char*>(builder.GetBufferPointer());
+    block.insert(block.end(), size_ptr, size_ptr + sizeof(uint32_t));
+    block.insert(block.end(), message, message + message_size);
+    const char* end = block.data() + block.size();
+
+    if (conn.out_block_tail) {
+        // Extend the slice of the previous reply
+        MemSlice& last = conn.out_queue.back();
+        last = MemSlice(conn.out_block, last.data(), end);
+    } else {
+        conn.out_queue.emplace_back(conn.out_block, begin, end);
+        conn.out_block_tail = true;
+    }
+
+    for (auto& slice : payload) {
+        if (slice.size() > 0) {
+            conn.out_queue.push_back(std::move(slice));
+            conn.out_block_tail = false;
+        }
+    }
+    conn.out_size += sizeof(uint32_t) + frame_size;
+
+    LOG<INFO>("Server queued ack of size: ", frame_size);
+    return true;
+}
+
+std::string TCPServer::snapshot_file() const {
+    return storage_path + "/memory.snapshot";
+}
+
+/**
+  * Recovers the objects of the Memory backend: loads the last snapshot and
+  * replays the write-ahead log on top of it.
+  */
+void TCPServer::recover() {
+    if (mkdir(storage_path.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw cirrus::Exception("Error creating directory " + storage_path);
+    }
+
+    TimerFunction recover_time;
+    auto memory = static_cast<MemoryBackend*>(mem.get());
+    // Snapshots are also taken to truncate the log
+    if (snapshot_interval > 0 || use_wal) {
+        curr_size = memory->load_snapshot(snapshot_file(),
+                std::thread::hardware_concurrency());
+    }
+    if (use_wal) {
+        // The log may start before the snapshot: records already in the
+        // snapshot are applied again, which leaves the same objects
+        wal = std::make_unique<WriteAheadLog>(storage_path);
+        wal->open([this](uint64_t oid, const MemSlice* data) {
+            uint64_t old_size;
+            if (data != nullptr) {
+                if (mem->upsert(oid, *data, &old_size)) {
+                    curr_size = curr_size - old_size + data->size();
+                }
+            } else if (mem->erase(oid, &old_size)) {
+                curr_size -= old_size;
+            }
+        });
+    }
+    if (cache_mode) {
+        for (const auto& entry : memory->snapshot()) {
+            clock.insert(entry.first);
+        }
+    }
+    LOG<INFO>("Recovered ", curr_size, " bytes in ",
+            recover_time.getSecElapsed(), " s");
+}
+
+/**
+  * Loop run by the snapshot thread. Every snapshot_interval seconds it takes
+  * a copy of the index of the Memory backend, which only blocks the writes
+  * of a shard for the time it takes to copy the references to its objects,
+  * and then writes the objects out. mem_lock is not taken.
+  * Without a snapshot interval, it checks every second whether the log
+  * grew past pool_size, replaying it would then take longer than loading
+  * a snapshot.
+  */
+void TCPServer::snapshot_loop() {
+    auto memory = static_cast<MemoryBackend*>(mem.get());
+    std::unique_lock<std::mutex> guard(snapshot_lock);
+    while (!snapshot_cv.wait_for(guard,
+                std::chrono::seconds(snapshot_interval > 0 ?
+                    snapshot_interval : 1),
+                [this] { return terminate_snapshots; })) {
+        if (snapshot_interval == 0 && wal->generation_size() < pool_size) {
+            continue;
+        }
+        TimerFunction snapshot_time;
+        MemoryBackend::Snapshot snapshot;
+        try {
+            // Objects are stored before their write is logged, so every
+            // write in the log generations ended here is in the backend
+            // by now and in the snapshot taken after. Writes logged in
+            // later generations may also be in it, which is harmless as
+            // they are applied again on recovery
+            uint64_t generation = 0;
+            if (wal) {
+                generation = wal->rotate();
+            }
+            snapshot = memory->snapshot();
+            MemoryBackend::write_snapshot(snapshot, snapshot_file());
+            if (wal) {
+                wal->remove_until(generation);
+            }
+        } catch (const std::runtime_error& e) {
+            LOG<ERROR>(e.what());
+            continue;
+        }
+        LOG<INFO>("Snapshotted ", snapshot.size(), " objects in ",
+                snapshot_time.getSecElapsed(), " s");
+    }
+}
+
+/**
+  * Sets the TTL of an object just written, replacing its previous one.
+  * The first TTL set starts the expiry thread, servers whose clients do
+  * not use TTLs never run it.
+  * Must be called with mem_lock and the lock of the object held.
+  * @param oid the id of the object
+  * @param ttl_ms time after which the object is removed, in milliseconds.
+  * 0 if the object does not expire
+  */
+void TCPServer::set_ttl(ObjectID oid, uint64_t ttl_ms) {
+    if (!expiring.empty()) {
+        expiring.erase(oid);
+    }
+    if (ttl_ms > 0) {
+        if (!expiry_thread.joinable()) {
+            expiry_thread = std::thread(&TCPServer::expiry_loop, this);
+        }
+        expirations.schedule(oid, elapsed_ms() + ttl_ms);
+    } else if (!expirations.empty()) {
+        expirations.cancel(oid);
+    }
+}
+
+/**
+  * Returns the time since the server was created, in milliseconds.
+  */
+uint64_t TCPServer::elapsed_ms() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_time).count();
+}
+
+/**
+  * Loop run by the expiry thread. Every tick it removes the objects whose
+  * TTL elapsed, as given by the timing wheel, so it never scans the
+  * objects. Objects are taken from the wheel in batches and removed one
+  * by one, like the removes of clients. An object written with a new TTL
+  * in the meantime is kept.
+  * TTLs are not logged: objects recovered after a restart do not expire.
+  */
+void TCPServer::expiry_loop() {
+    std::vector<uint64_t> expired;
+    std::unique_lock<std::mutex> guard(expiry_lock);
+    while (!expiry_cv.wait_for(guard,
+                std::chrono::milliseconds(expiry_tick_ms),
+                [this] { return terminate_expiry; })) {
+        do {
+            expired.clear();
+            {
+                std::lock_guard<std::mutex> mem_guard(mem_lock);
+                expirations.advance(elapsed_ms(), max_expirations_per_lock,
+                        &expired);
+                expiring.insert(expired.begin(), expired.end());
+            }
+            for (const auto& oid : expired) {
+                std::lock_guard<std::recursive_mutex> object_guard(
+                        object_lock(oid));
+                {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    if (expiring.erase(oid) == 0) {
+                        continue;
+                    }
+                }
+                uint64_t old_size;
+                bool erased = mem->erase(oid, &old_size);
+                std::lock_guard<std::mutex> mem_guard(mem_lock);
+                if (erased) {
+                    curr_size -= old_size;
+                    record_remove(oid, nullptr);
+                }
+                if (cache_mode) {
+                    clock.remove(oid);
+                }
+            }
+            if (!expired.empty()) {
+                LOG<INFO>("Expired ", expired.size(), " objects");
+            }
+        } while (expired.size() == max_expirations_per_lock);
+    }
+}
+
+/**
+  * Returns the lock of an object.
+  * @param oid the id of the object
+  */
+std::recursive_mutex& TCPServer::object_lock(ObjectID oid) {
+    return object_locks[(oid * 0x9e3779b97f4a7c15) >>
+        (64 - object_lock_bits)];
+}
+
+/**
+  * Takes the locks of several objects. Locks are taken in the order of
+  * their index, so that two requests never wait for each other.
+  * @param oids the ids of the objects
+  * @return the locks, held until they are destroyed
+  */
+std::vector<std::unique_lock<std::recursive_mutex>> TCPServer::lock_objects(
+        const std::vector<ObjectID>& oids) {
+    std::vector<std::recursive_mutex*> locks;
+    locks.reserve(oids.size());
+    for (const auto& oid : oids) {
+        locks.push_back(&object_lock(oid));
+    }
+    std::sort(locks.begin(), locks.end());
+    locks.erase(std::unique(locks.begin(), locks.end()), locks.end());
+
+    std::vector<std::unique_lock<std::recursive_mutex>> guards;
+    guards.reserve(locks.size());
+    for (auto lock : locks) {
+        guards.emplace_back(*lock);
+    }
+    return guards;
+}
+
+/**
+  * Takes the locks of the objects with ids in [first, last]. Ranges with
+  * fewer ids than there are locks only take the locks of their ids.
+  * @param first the first id of the range
+  * @param last the last id of the range
+  * @return the locks, held until they are destroyed
+  */
+std::vector<std::unique_lock<std::recursive_mutex>>
+TCPServer::lock_object_range(ObjectID first, ObjectID last) {
+    if (first > last) {
+        return {};
+    }
+    if (last - first >= object_locks.size()) {
+        return lock_all_objects();
+    }
+    std::vector<ObjectID> oids(last - first + 1);
+    std::iota(oids.begin(), oids.end(), first);
+    return lock_objects(oids);
+}
+
+/**
+  * Takes the locks of every object, e.g. to change objects not known
+  * upfront.
+  * @return the locks, held until they are destroyed
+  */
+std::vector<std::unique_lock<std::recursive_mutex>>
+TCPServer::lock_all_objects() {
+    std::vector<std::unique_lock<std::recursive_mutex>> guards;
+    guards.reserve(object_locks.size());
+    for (auto& lock : object_locks) {
+        guards.emplace_back(lock);
+    }
+    return guards;
+}
+
+/**
+  * Stores an object in the backend and accounts for its size in the pool.
+  * The size of the object is reserved in the pool before the object is
+  * stored, so that concurrent writes cannot go over capacity.
+  * Must be called with the lock of the object held.
+  * @param oid the id of the object
+  * @param data the content of the object
+  * @param conn the connection of the request, nullptr if none
+  * @return kOk, or kServerMemoryErrorException if the object does not fit
+  */
+cirrus::ErrorCodes TCPServer::store_object(ObjectID oid,
+        const MemSlice& data, Connection* conn) {
+    uint64_t size = data.size();
+    {
+        std::unique_lock<std::mutex> guard(mem_lock);
+        if (conn && conn->app && !quotas.fits(conn->app, oid, size)) {
+            LOG<ERROR>("Put of oid ", oid, " would go over the memory quota");
+            return cirrus::ErrorCodes::kQuotaExceededException;
+        }
+        if (curr_size + size > max_size) {
+            // Only near capacity the size of the object being replaced
+            // is needed upfront. The object cannot change, its lock is held
+            guard.unlock();
+            auto old = mem->lookup(oid);
+            uint64_t old_size = old.found ? old.data.size() : 0;
+            guard.lock();
+            if (cache_mode) {
+                evict(oid, old_size, size, conn);
+            }
+            if (curr_size - old_size + size > max_size) {
+                LOG<ERROR>("Put would go over capacity on server. ",
+                            "Current size: ", curr_size,
+                            " Incoming size: ", size,
+                            " Pool size: ", max_size);
+                return cirrus::ErrorCodes::kServerMemoryErrorException;
+            }
+        }
+        curr_size += size;
+    }
+
+    uint64_t old_size;
+    bool stored = mem->upsert(oid, data, &old_size);
+    std::lock_guard<std::mutex> guard(mem_lock);
+    if (!stored) {
+        curr_size -= size;
+        LOG<ERROR>("Backend out of memory");
+        return cirrus::ErrorCodes::kServerMemoryErrorException;
+    }
+    curr_size -= old_size;
+    if (cache_mode) {
+        clock.insert(oid);
+    }
+    if (conn && conn->app) {
+        quotas.charge(conn->app, oid, size);
+    }
+    record_put(oid, conn);
+    return cirrus::ErrorCodes::kOk;
+}
+
+/**
+  * Replaces an object if it matches what the client expects.
+  * Must be called with the lock of the object held.
+  * @param oid the id of the object
+  * @param expected the object expected, nullptr if it should not exist
+  * @param expected_version if not 0, the version expected instead
+  * @param desired the new object
+  * @param swapped set to whether the object was replaced
+  * @param current set to the object, if it exists and did not match
+  * @param conn the connection of the request
+  * @return kOk, or the error storing the new object
+  */
+cirrus::ErrorCodes TCPServer::compare_and_swap(ObjectID oid,
+        const flatbuffers::Vector<int8_t>* expected,
+        uint64_t expected_version,
+        const flatbuffers::Vector<int8_t>* desired,
+        bool* swapped, MemSlice* current, Connection* conn) {
+    auto obj = mem->lookup(oid);
+    bool match;
+    if (expected_version != 0) {
+        std::lock_guard<std::mutex> guard(mem_lock);
+        track_versions();
+        match = obj.found && version(oid) == expected_version;
+    } else if (!expected) {
+        match = !obj.found;
+    } else {
+        match = obj.found && obj.data.size() == expected->size() &&
+            std::memcmp(obj.data.data(), expected->data(),
+                    expected->size()) == 0;
+    }
+
+    *swapped = false;
+    if (!match) {
+        if (obj.found) {
+            *current = std::move(obj.data);
+        }
+        return cirrus::ErrorCodes::kOk;
+    }
+    obj.data = MemSlice();
+    cirrus::ErrorCodes code = store_object(oid, MemSlice(desired), conn);
+    *swapped = code == cirrus::ErrorCodes::kOk;
+    return code;
+}
+
+/**
+  * Adds a multiple of an operand to an object, element by element. The
+  * object is updated in place.
+  * Must be called with the lock of the object held.
+  * @param oid the id of the object
+  * @param type the type of the elements
+  * @param scale the factor the operand is multiplied by. Must be 1 for
+  * integers
+  * @param operand the elements added, as many as in the object
+  * @param fetch whether the previous object is needed
+  * @param previous set to the previous object if fetch is set. Empty if
+  * the object did not exist
+  * @param conn the connection of the request
+  * @return kOk, or kException if the operand does not match the object
+  */
+cirrus::ErrorCodes TCPServer::add_vector(ObjectID oid,
+        message::TCPBladeMessage::AddType type, double scale,
+        const flatbuffers::Vector<int8_t>* operand, bool fetch,
+        MemSlice* previous, Connection* conn) {
+    uint64_t element_size =
+        type == message::TCPBladeMessage::AddType_Float ? sizeof(float) :
+        sizeof(uint64_t);
+    uint64_t size = operand->size();
+    if (size % element_size != 0 ||
+        (type == message::TCPBladeMessage::AddType_UInt64 && scale != 1)) {
+        LOG<ERROR>("Invalid operand of size ", size, " and scale ", scale);
+        return cirrus::ErrorCodes::kException;
+    }
+    const char* src = reinterpret_cast<const char*>(operand->data());
+    auto add = [type, scale, src, element_size](char* dst, uint64_t n) {
+        n /= element_size;
+        if (type == message::TCPBladeMessage::AddType_Double) {
+            axpy_double(dst, src, scale, n);
+        } else if (type == message::TCPBladeMessage::AddType_Float) {
+            axpy_float(dst, src, scale, n);
+        } else {
+            add_uint64(dst, src, n);
+        }
+    };
+
+    auto obj = mem->lookup(oid);
+    if (!obj.found) {
+        std::vector<int8_t> sum(size, 0);
+        add(reinterpret_cast<char*>(sum.data()), size);
+        return store_object(oid, MemSlice(&sum), conn);
+    }
+    if (obj.data.size() != size) {
+        LOG<ERROR>("Operand of size ", size, " added to oid ", oid,
+                " of size ", obj.data.size());
+        return cirrus::ErrorCodes::kException;
+    }
+
+    // Without other references the backend updates the object in place,
+    // otherwise the previous object stays as it is
+    if (fetch) {
+        *previous = std::move(obj.data);
+    } else {
+        obj.data = MemSlice();
+    }
+    mem->update(oid, add);
+    std::lock_guard<std::mutex> guard(mem_lock);
+    if (cache_mode) {
+        clock.touch(oid);
+    }
+    record_put(oid, conn);
+    return cirrus::ErrorCodes::kOk;
+}
+
+/**
+  * Runs a function of a plugin on a range of objects. The objects are not
+  * locked: each one is read as it is at some point during the call.
+  * @param name the name of the function
+  * @param first the id of the first object
+  * @param last the id of the last object (inclusive)
+  * @param args arguments of the function, may be nullptr
+  * @param result set to the result of the function
+  * @return kOk, kNoSuchFunctionException if no plugin defines the function,
+  * kOutOfRangeException if the range is inverted, kInvalidArgumentException
+  * if the range is too wide to probe or kException if the function fails
+  */
+cirrus::ErrorCodes TCPServer::call_function(const std::string& name,
+        ObjectID first, ObjectID last,
+        const flatbuffers::Vector<int8_t>* args, std::string* result) {
+    NearDataFunction function = functions.find(name);
+    if (!function) {
+        LOG<ERROR>("No plugin defines function ", name);
+        return cirrus::ErrorCodes::kNoSuchFunctionException;
+    }
+    if (first > last) {
+        LOG<ERROR>("Invalid range from oid ", first, " to oid ", last);
+        return cirrus::ErrorCodes::kOutOfRangeException;
+    }
+
+    // Backends that list their objects are only asked for the objects
+    // stored, the others are probed id by id so ranges are limited as in
+    // ReadRange
+    std::vector<ObjectID> oids;
+    if (mem->list_range(first, last, &oids)) {
+        std::sort(oids.begin(), oids.end());
+    } else if (last - first >= max_range_size) {
+        LOG<ERROR>("Range of ", last - first, " ids too wide");
+        return cirrus::ErrorCodes::kInvalidArgumentException;
+    } else {
+        oids.resize(last - first + 1);
+        std::iota(oids.begin(), oids.end(), first);
+    }
+
+    // The slices keep the objects alive during the call
+    auto results = mem->get_bulk(oids);
+    std::vector<NearDataObject> objects;
+    objects.reserve(oids.size());
+    for (uint64_t i = 0; i < oids.size(); ++i) {
+        if (results[i].found) {
+            objects.push_back({oids[i], results[i].data.data(),
+                    results[i].data.size()});
+        }
+    }
+    if (cache_mode) {
+        std::lock_guard<std::mutex> guard(mem_lock);
+        for (const auto& object : objects) {
+            clock.touch(object.oid);
+        }
+    }
+
+    const char* args_data = args ?
+        reinterpret_cast<const char*>(args->data()) : nullptr;
+    uint64_t args_size = args ? args->size() : 0;
+    if (!function(objects.data(), objects.size(), args_data, args_size,
+                result)) {
+        LOG<ERROR>("Function ", name, " failed");
+        return cirrus::ErrorCodes::kException;
+    }
+    return cirrus::ErrorCodes::kOk;
+}
+
+/**
+  * Gives a new version to an object written and logs the write, if the
+  * write-ahead log is enabled. The log record points to the object in the
+  * backend, so it is not copied.
+  * Must be called with mem_lock and the lock of the object held.
+  * @param oid the id of the object
+  * @param conn the connection that wrote the object, which is not told of
+  * the change and whose reply waits for the log record. nullptr if none
+  */
+void TCPServer::record_put(ObjectID oid, Connection* conn) {
+    ++last_version;
+    if (tracking_versions) {
+        versions[oid] = last_version;
+    }
+    if (!watchers.empty()) {
+        fire_watches(oid);
+    }
+    if (!subscriptions.empty()) {
+        notify_subscribers(oid, last_version, conn ? conn->fd : -1);
+    }
+    if (wal) {
+        uint64_t lsn = wal->append_put(oid, mem->lookup(oid).data);
+        if (conn) {
+            conn->wal_lsn = lsn;
+        }
+    }
+}
+
+/**
+  * Forgets the version of an object removed and logs the removal, if the
+  * write-ahead log is enabled.
+  * Must be called with mem_lock and the lock of the object held.
+  * @param oid the id of the object
+  * @param conn the connection whose reply waits for the log record,
+  * nullptr if none
+  */
+void TCPServer::record_remove(ObjectID oid, Connection* conn) {
+    if (tracking_versions) {
+        versions.erase(oid);
+    }
+    if (quotas.enabled()) {
+        quotas.release(oid);
+    }
+    if (!expirations.empty()) {
+        expirations.cancel(oid);
+    }
+    if (!expiring.empty()) {
+        expiring.erase(oid);
+    }
+    // Objects may be evicted by the writes of any connection, so every
+    // subscriber is told
+    if (!subscriptions.empty()) {
+        notify_subscribers(oid, 0, -1);
+    }
+    if (wal) {
+        uint64_t lsn = wal->append_remove(oid);
+        if (conn) {
+            conn->wal_lsn = lsn;
+        }
+    }
+}
+
+/**
+  * Starts tracking the version of every object, if not tracked yet.
+  * Must be called with mem_lock held.
+  */
+void TCPServer::track_versions() {
+    if (!tracking_versions) {
+        tracking_versions = true;
+        base_version = ++last_version;
+    }
+}
+
+/**
+  * Returns the version of an object.
+  * Must be called with mem_lock held.
+  * @param oid the id of the object
+  */
+uint64_t TCPServer::version(ObjectID oid) const {
+    if (!tracking_versions) {
+        return last_version;
+    }
+    auto it = versions.find(oid);
+    return it == versions.end() ? base_version : it->second;
+}
+
+/**
+  * Finds the objects written past the versions a client has.
+  * Must be called with mem_lock held.
+  * @param oids the ids of the objects
+  * @param known the version the client has of each object
+  * @param current set to the version of each object, 0 if it does not exist
+  * @return 1 for every object written past its version, 0 otherwise
+  */
+std::vector<int8_t> TCPServer::written_since(
+        const std::vector<ObjectID>& oids, const std::vector<uint64_t>& known,
+        std::vector<uint64_t>* current) const {
+    assert(tracking_versions);
+    std::vector<int8_t> statuses(oids.size());
+    current->resize(oids.size());
+    for (uint64_t i = 0; i < oids.size(); ++i) {
+        // Objects written since the start have a version, others may
+        // have been recovered
+        auto it = versions.find(oids[i]);
+        if (it != versions.end()) {
+            (*current)[i] = it->second;
+        } else {
+            (*current)[i] = mem->exists(oids[i]) ? base_version : 0;
+        }
+        statuses[i] = (*current)[i] > known[i];
+    }
+    return statuses;
+}
+
+/**
+  * Makes a request wait for any of a set of objects to be written. The
+  * watch belongs to the reactor thread of the connection, which sends the
+  * reply in complete_watches().
+  * Must be called with mem_lock held, from the thread of the connection.
+  * @param conn the connection of the request
+  * @param txn_id the id of the request
+  * @param oids the ids of the objects
+  * @param known the version the client has of each object
+  * @param timeout_ms time after which the request is answered anyway
+  */
+void TCPServer::add_watch(const Connection& conn, TxnID txn_id,
+        std::vector<ObjectID>&& oids, std::vector<uint64_t>&& known,
+        uint64_t timeout_ms) {
+    auto watch = std::make_shared<Watch>();
+    watch->fd = conn.fd;
+    watch->reactor = conn.reactor;
+    watch->txn_id = txn_id;
+    watch->oids = std::move(oids);
+    watch->versions = std::move(known);
+    watch->deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(std::min(timeout_ms, max_watch_timeout_ms));
+    for (const auto& oid : watch->oids) {
+        watchers.emplace(oid, watch);
+    }
+    watch_lists[conn.reactor].watches.push_back(std::move(watch));
+}
+
+/**
+  * Fires the watches on an object that was just written, and wakes up
+  * their reactor threads.
+  * Must be called with mem_lock held.
+  * @param oid the id of the object
+  */
+void TCPServer::fire_watches(ObjectID oid) {
+    uint64_t current = version(oid);
+    auto range = watchers.equal_range(oid);
+    for (auto it = range.first; it != range.second; ++it) {
+        Watch& watch = *it->second;
+        if (watch.fired) {
+            continue;
+        }
+        for (uint64_t i = 0; i < watch.oids.size(); ++i) {
+            if (watch.oids[i] == oid && current > watch.versions[i]) {
+                watch.fired = true;
+            }
+        }
+        int wake_fd = watch_lists[watch.reactor].wake_fd;
+        if (watch.fired && wake_fd != -1) {
+            uint64_t one = 1;
+            if (write(wake_fd, &one, sizeof(one)) == -1) {
+                LOG<ERROR>("Error waking up reactor ", watch.reactor);
+            }
+        }
+    }
+}
+
+/**
+  * Stops a watch from being fired by writes.
+  * Must be called with mem_lock held.
+  * @param watch the watch
+  */
+void TCPServer::unregister_watch(const std::shared_ptr<Watch>& watch) {
+    for (const auto& oid : watch->oids) {
+        auto range = watchers.equal_range(oid);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == watch) {
+                watchers.erase(it);
+                break;
+            }
+        }
+    }
+}
+
+/**
+  * Answers the watches of a reactor thread that fired or expired. The
+  * replies are queued, the caller has to make the connections wait for
+  * the socket to be writable.
+  * @param reactor the index of the reactor
+  * @param connections the connections owned by the reactor
+  * @return the fds of the connections with new replies
+  */
+std::vector<int> TCPServer::complete_watches(uint64_t reactor,
+        std::unordered_map<int, Connection>* connections) {
+    std::vector<int> fds;
+    auto& watches = watch_lists[reactor].watches;
+    if (watches.empty()) {
+        return fds;
+    }
+
+    struct Result {
+        std::shared_ptr<Watch> watch;
+        std::vector<int8_t> statuses;
+        std::vector<uint64_t> versions;
+    };
+    std::vector<Result> results;
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> guard(mem_lock);
+        for (auto it = watches.begin(); it != watches.end();) {
+            if (!(*it)->fired && (*it)->deadline > now) {
+                ++it;
+                continue;
+            }
+            Result result;
+            result.watch = std::move(*it);
+            result.statuses = written_since(result.watch->oids,
+                    result.watch->versions, &result.versions);
+            unregister_watch(result.watch);
+            results.push_back(std::move(result));
+            it = watches.erase(it);
+        }
+    }
+
+    flatbuffers::FlatBufferBuilder builder(initial_buffer_size);
+    for (auto& result : results) {
+        // Watches of closed connections are cancelled
+        Connection& conn = connections->at(result.watch->fd);
+        builder.Clear();
+        auto statuses_fb = builder.CreateVector(result.statuses);
+        auto versions_fb = builder.CreateVector(result.versions);
+        auto ack = message::TCPBladeMessage::CreateWatchAck(builder,
+                statuses_fb, versions_fb);
+        auto ack_msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                builder, result.watch->txn_id,
+                static_cast<int64_t>(cirrus::ErrorCodes::kOk),
+                message::TCPBladeMessage::Message_WatchAck, ack.Union());
+        builder.Finish(ack_msg);
+        if (queue_reply(conn, builder, {})) {
+            fds.push_back(conn.fd);
+        }
+    }
+    return fds;
+}
+
+/**
+  * Drops the watches, subscriptions and pending invalidations of a
+  * connection being closed.
+  * @param reactor the index of the reactor of the connection
+  * @param fd the fd of the connection
+  */
+void TCPServer::cancel_watches(uint64_t reactor, int fd) {
+    auto& watches = watch_lists[reactor].watches;
+    std::lock_guard<std::mutex> guard(mem_lock);
+    for (auto it = watches.begin(); it != watches.end();) {
+        if ((*it)->fd == fd) {
+            unregister_watch(*it);
+            it = watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = subscriptions.begin(); it != subscriptions.end();) {
+        if (it->second.fd == fd) {
+            it = subscriptions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    update_widest_subscription();
+    watch_lists[reactor].invalidations.erase(fd);
+}
+
+/**
+  * Subscribes a connection to the changes of a range of objects.
+  * Must be called with mem_lock held.
+  * @param conn the connection
+  * @param first the id of the first object
+  * @param last the id of the last object (inclusive)
+  */
+void TCPServer::subscribe(const Connection& conn, ObjectID first,
+        ObjectID last) {
+    subscriptions.emplace(first, Subscription{conn.fd, conn.reactor, last});
+    widest_subscription = std::max(widest_subscription, last - first);
+}
+
+/**
+  * Drops the subscriptions of a connection within a range of objects.
+  * Must be called with mem_lock held.
+  * @param conn the connection
+  * @param first the id of the first object
+  * @param last the id of the last object (inclusive)
+  */
+void TCPServer::unsubscribe(const Connection& conn, ObjectID first,
+        ObjectID last) {
+    for (auto it = subscriptions.lower_bound(first);
+            it != subscriptions.end() && it->first <= last;) {
+        if (it->second.fd == conn.fd && it->second.last <= last) {
+            it = subscriptions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    update_widest_subscription();
+}
+
+/**
+  * Recomputes the widest subscription once subscriptions are dropped.
+  * Must be called with mem_lock held.
+  */
+void TCPServer::update_widest_subscription() {
+    widest_subscription = 0;
+    for (const auto& subscription : subscriptions) {
+        widest_subscription = std::max(widest_subscription,
+                subscription.second.last - subscription.first);
+    }
+}
+
+/**
+  * Queues an invalidation for the connections subscribed to an object
+  * that changed, and wakes up their reactor threads. Invalidations are
+  * batched: the reactor pushes all those queued since its last wakeup in
+  * one message. Only the subscriptions starting at most
+  * widest_subscription ids below the object are looked at.
+  * Must be called with mem_lock held.
+  * @param oid the id of the object
+  * @param version the new version of the object, 0 if it was removed
+  * @param writer_fd fd of the connection that changed the object, which
+  * is not told. -1 to tell every connection
+  */
+void TCPServer::notify_subscribers(ObjectID oid, uint64_t version,
+        int writer_fd) {
+    ObjectID lowest_first = oid - std::min(oid, widest_subscription);
+    auto end = subscriptions.upper_bound(oid);
+    for (auto it = subscriptions.lower_bound(lowest_first); it != end; ++it) {
+        const Subscription& subscription = it->second;
+        if (subscription.fd == writer_fd || oid > subscription.last) {
+            continue;
+        }
+        auto& pending = watch_lists[subscription.reactor].invalidations;
+        bool wake = pending.empty();
+        Invalidations& invalidations = pending[subscription.fd];
+        // Overlapping subscriptions of a connection report a change once
+        if (!invalidations.oids.empty() &&
+            invalidations.oids.back() == oid &&
+            invalidations.versions.back() == version) {
+            continue;
+        }
+        invalidations.oids.push_back(oid);
+        invalidations.versions.push_back(version);
+
+        int wake_fd = watch_lists[subscription.reactor].wake_fd;
+        if (wake && wake_fd != -1) {
+            uint64_t one = 1;
+            if (write(wake_fd, &one, sizeof(one)) == -1) {
+                LOG<ERROR>("Error waking up reactor ", subscription.reactor);
+            }
+        }
+    }
+}
+
+/**
+  * Pushes the invalidations queued for the connections of a reactor
+  * thread. The messages are queued, the caller has to make the
+  * connections wait for the socket to be writable.
+  * @param reactor the index of the reactor
+  * @param connections the connections owned by the reactor
+  * @return the fds of the connections with new messages
+  */
+std::vector<int> TCPServer::send_invalidations(uint64_t reactor,
+        std::unordered_map<int, Connection>* connections) {
+    std::vector<int> fds;
+    std::unordered_map<int, Invalidations> pending;
+    {
+        std::lock_guard<std::mutex> guard(mem_lock);
+        pending.swap(watch_lists[reactor].invalidations);
+    }
+
+    flatbuffers::FlatBufferBuilder builder(initial_buffer_size);
+    for (auto& entry : pending) {
+        // Invalidations of closed connections are dropped
+        Connection& conn = connections->at(entry.first);
+        builder.Clear();
+        auto oids_fb = builder.CreateVector(entry.second.oids);
+        auto versions_fb = builder.CreateVector(entry.second.versions);
+        auto invalidate = message::TCPBladeMessage::CreateInvalidate(builder,
+                oids_fb, versions_fb);
+        auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(
+                builder, 0, static_cast<int64_t>(cirrus::ErrorCodes::kOk),
+                message::TCPBladeMessage::Message_Invalidate,
+                invalidate.Union());
+        builder.Finish(msg);
+        if (queue_reply(conn, builder, {})) {
+            fds.push_back(conn.fd);
+        }
+    }
+    return fds;
+}
+
+/**
+  * Computes how long a reactor thread can wait for events, up to the
+  * deadline of its first watch.
+  * @param reactor the index of the reactor
+  * @return the timeout, in milliseconds
+  */
+int TCPServer::wait_timeout(uint64_t reactor) const {
+    const auto& watches = watch_lists[reactor].watches;
+    if (watches.empty()) {
+        return timeout;
+    }
+    auto first = watches.front()->deadline;
+    for (const auto& watch : watches) {
+        first = std::min(first, watch->deadline);
+    }
+    // Rounded up, so that the watch expired when the thread wakes up
+    int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            first - std::chrono::steady_clock::now()).count() + 1;
+    return std::max<int64_t>(0, std::min<int64_t>(left, timeout));
+}
+
+/**
+  * Marks an object read as recently used, or counts a miss.
+  * Must be called with mem_lock held.
+  * @param oid the id of the object
+  * @param found whether the object exists
+  */
+void TCPServer::account_read(ObjectID oid, bool found) {
+    if (found) {
+        clock.touch(oid);
+        cache_counters.hits++;
+    } else {
+        cache_counters.misses++;
+    }
+}
+
+/**
+  * Evicts objects until an object fits in the pool. Objects being changed
+  * by other requests are not evicted, as their locks cannot be waited for
+  * with mem_lock held.
+  * Must be called with mem_lock and the lock of the object held.
+  * @param oid the id of the object, it is not evicted
+  * @param old_size the size of the object being replaced, 0 if none
+  * @param size the size of the object
+  * @param conn the connection of the request
+  */
+void TCPServer::evict(ObjectID oid, uint64_t old_size, uint64_t size,
+        Connection* conn) {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    std::vector<ObjectID> busy;
+    ObjectID victim;
+    while (curr_size - old_size + size > max_size &&
+           clock.next_victim(&victim, oid)) {
+        std::unique_lock<std::recursive_mutex> victim_guard(
+                object_lock(victim), std::try_to_lock);
+        if (!victim_guard.owns_lock()) {
+            busy.push_back(victim);
+            continue;
+        }
+        uint64_t victim_size;
+        if (mem->erase(victim, &victim_size)) {
+            curr_size -= victim_size;
+            bytes += victim_size;
+            count++;
+            record_remove(victim, conn);
+        }
+    }
+    for (const auto& busy_oid : busy) {
+        clock.insert(busy_oid);
+    }
+    cache_counters.evictions += count;
+    cache_counters.evicted_bytes += bytes;
+    LOG<INFO>("Evicted ", count, " objects (", bytes, " bytes). Total ",
+            "evictions: ", cache_counters.evictions,
+            " misses: ", cache_counters.misses);
+}
+
+/**
+  * Writes several objects and builds the reply, a WriteBulkAck.
+  * Must be called with the locks of the objects held.
+  * @param txn_id the id of the request
+  * @param oid_list the ids of the objects
+  * @param data_fb the objects, each one preceded by its size
+  * @param partial whether to try every object and report the status of
+  * each one, instead of failing at the first object that is not written
+  * @param ttl_ms TTL of the objects written, 0 if they do not expire
+  * @param conn the connection of the request
+  * @param builder empty builder for the reply
+  * @param error_code set to the error, if any. Partial writes report
+  * errors in the status of the objects instead, except malformed data.
+  * If already set, nothing is written
+  * @return whether all the objects were written
+  */
+bool TCPServer::write_bulk(TxnID txn_id, const std::vector<uint64_t>& oid_list,
+        const flatbuffers::Vector<int8_t>* data_fb, bool partial,
+        uint64_t ttl_ms, Connection* conn,
+        flatbuffers::FlatBufferBuilder& builder,
+        cirrus::ErrorCodes* error_code) {
+#ifdef PERF_LOG
+    TimerFunction write_time;
+#endif
+    // store_object() overwrites the objects that exist
+    // and accounts for the size change.
+    bool success = true;
+    std::vector<int8_t> statuses(oid_list.size(), 0);
+    std::vector<MemSlice> objects;
+    objects.reserve(oid_list.size());
+    uint64_t total_size = 0;
+    // Requests without data hold no objects
+    const char* data_ptr = nullptr;
+    const char* data_end = nullptr;
+    if (data_fb) {
+        data_ptr = reinterpret_cast<const char*>(data_fb->data());
+        data_end = data_ptr + data_fb->size();
+    }
+    for (uint64_t i = 0; i < oid_list.size(); ++i) {
+        // The sizes come from the client, objects past the end of the data
+        // make the whole request invalid
+        if (static_cast<uint64_t>(data_end - data_ptr) < sizeof(uint64_t)) {
+            *error_code = cirrus::ErrorCodes::kInvalidArgumentException;
+            break;
+        }
+        uint64_t obj_size =
+            ntohl(*reinterpret_cast<const uint64_t*>(data_ptr));
+        data_ptr += sizeof(uint64_t);
+        if (obj_size > static_cast<uint64_t>(data_end - data_ptr)) {
+            *error_code = cirrus::ErrorCodes::kInvalidArgumentException;
+            break;
+        }
+
+        LOG<INFO>("Writing object with size: " , obj_size);
+        objects.emplace_back(data_ptr, data_ptr + obj_size);
+        total_size += obj_size;
+        data_ptr += obj_size;  // advance cursor
+    }
+    if (*error_code != cirrus::ErrorCodes::kOk) {
+        LOG<ERROR>("Data of the objects malformed");
+        success = false;
+    }
+
+    QuotaManager::App* app = conn->app;
+    bool fits = false;
+    if (success) {
+        // The objects are reserved in the pool while they are stored
+        std::lock_guard<std::mutex> guard(mem_lock);
+        fits = curr_size + total_size <= max_size &&
+            (!app || quotas.fits(app, total_size));
+        if (fits) {
+            curr_size += total_size;
+        }
+    }
+    if (fits) {
+        // Service the write request by
+        // storing all the serialized objects at once
+        uint64_t old_bytes;
+        uint64_t stored = mem->put_bulk(oid_list, objects, &old_bytes);
+        std::lock_guard<std::mutex> guard(mem_lock);
+        for (uint64_t i = 0; i < oid_list.size(); ++i) {
+            if (i >= stored) {
+                curr_size -= objects[i].size();
+                continue;
+            }
+            if (cache_mode) {
+                clock.insert(oid_list[i]);
+            }
+            if (app) {
+                quotas.charge(app, oid_list[i], objects[i].size());
+            }
+            record_put(oid_list[i], conn);
+            set_ttl(oid_list[i], ttl_ms);
+            statuses[i] = 1;
+        }
+        curr_size -= old_bytes;
+        if (stored < oid_list.size()) {
+            LOG<ERROR>("Backend out of memory");
+            *error_code = cirrus::ErrorCodes::kServerMemoryErrorException;
+            success = false;
+        }
+    } else if (success) {
+        // Near capacity or the quota, objects replaced may make room
+        for (uint64_t i = 0; i < oid_list.size(); ++i) {
+            cirrus::ErrorCodes code = store_object(oid_list[i], objects[i],
+                    conn);
+            statuses[i] = code == cirrus::ErrorCodes::kOk;
+            if (code == cirrus::ErrorCodes::kOk) {
+                std::lock_guard<std::mutex> guard(mem_lock);
+                set_ttl(oid_list[i], ttl_ms);
+            } else {
+                *error_code = code;
+                success = false;
+                if (!partial) {
+                    break;
+                }
+            }
+        }
+    }
+
+    flatbuffers::Offset<flatbuffers::Vector<int8_t>> statuses_fb;
+    if (partial) {
+        statuses_fb = builder.CreateVector(statuses);
+        if (*error_code != cirrus::ErrorCodes::kInvalidArgumentException) {
+            *error_code = cirrus::ErrorCodes::kOk;
+        }
+    }
+
+    // Create and send ack
+    auto ack = message::TCPBladeMessage::CreateWriteBulkAck(builder, success,
+            statuses_fb);
+    auto ack_msg = message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+            txn_id,
+            static_cast<int64_t>(*error_code),
+            message::TCPBladeMessage::Message_WriteBulkAck,
+            ack.Union());
+    builder.Finish(ack_msg);
+#ifdef PERF_LOG
+    double write_mbps = data_fb->size() / (1024.0 * 1024) /
+        (write_time.getUsElapsed() / 1000000.0);
+    LOG<PERF>("TCPServer::write_bulk time (us): ",
+            write_time.getUsElapsed(),
+            " bw (MB/s): ", write_mbps,
+            " size: ", data_fb->size());
+#endif
+    return success;
+}
+
+/**
+  * Reads several objects and builds the reply, a ReadBulkAck.
+  * The reply data is made of the number of objects followed by the size
+  * and the content of every object. The objects are sent from the
+  * backend's memory and only the sizes are built here.
+  * Warning: No atomicity guarantees
+  * @param txn_id the id of the request
+  * @param oid_list the ids of the objects
+  * @param partial whether to send the objects found and the status of
+  * each one, instead of failing if any object is missing
+  * @param builder empty builder for the reply
+  * @param payload set to the data sent after the reply
+  * @param error_code set to the error, if any
+  * @return whether all the objects exist
+  */
+bool TCPServer::read_bulk(TxnID txn_id, const std::vector<uint64_t>& oid_list,
+        bool partial, flatbuffers::FlatBufferBuilder& builder,
+        std::vector<MemSlice>* payload, cirrus::ErrorCodes* error_code) {
+#ifdef PERF_LOG
+    TimerFunction read_time;
+#endif
+    bool success = true;
+    // number of objects to be transfered
+    uint32_t num_oids = oid_list.size();
+    std::vector<int8_t> statuses(partial ? num_oids : 0, 0);
+
+    // main header followed by the header of each object
+    auto headers = std::make_shared<std::vector<uint32_t>>(num_oids + 1);
+    (*headers)[0] = num_oids;
+    uint64_t data_size = sizeof(uint32_t);
+    auto results = mem->get_bulk(oid_list);
+    if (cache_mode) {
+        std::lock_guard<std::mutex> guard(mem_lock);
+        for (uint32_t i = 0; i < num_oids; ++i) {
+            account_read(oid_list[i], results[i].found);
+        }
+    }
+    for (uint32_t i = 0; i < num_oids; ++i) {
+        if (!results[i].found && !partial) {
+            success = false;
+            *error_code = cirrus::ErrorCodes::kNoSuchIDException;
+            LOG<ERROR>("Oid ", oid_list[i], " does not exist on server");
+            payload->clear();
+            break;
+        }
+
+        // Missing objects of partial reads are sent empty
+        MemSlice& obj = results[i].data;
+        if (partial) {
+            statuses[i] = results[i].found;
+            success = success && results[i].found;
+        }
+        (*headers)[i + 1] = htonl(obj.size());
+        data_size += sizeof(uint32_t) + obj.size();
+
+        // The main header goes out with the first object's header
+        const char* header_begin = reinterpret_cast<const char*>(
+                headers->data() + (i == 0 ? 0 : i + 1));
+        const char* header_end = reinterpret_cast<const char*>(
+                headers->data() + i + 2);
+        payload->emplace_back(headers, header_begin, header_end);
+        if (obj.size() > 0) {
+            payload->push_back(std::move(obj));
+        }
+    }
+    if (num_oids == 0) {
+        const char* header = reinterpret_cast<const char*>(headers->data());
+        payload->emplace_back(headers, header, header + sizeof(uint32_t));
+    }
+    uint64_t payload_size = payload->empty() ? 0 : data_size;
+    auto data_fb_vector = builder.CreateVector(std::vector<int8_t>());
+    flatbuffers::Offset<flatbuffers::Vector<int8_t>> statuses_fb;
+    if (partial) {
+        statuses_fb = builder.CreateVector(statuses);
+    }
+
+    LOG<INFO>("Server building readbulk response");
+    // Create and send ack
+    auto ack = message::TCPBladeMessage::CreateReadBulkAck(builder,
+            success, data_fb_vector, payload_size, statuses_fb);
+    auto ack_msg = message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+            txn_id,
+            static_cast<int64_t>(*error_code),
+            message::TCPBladeMessage::Message_ReadBulkAck,
+            ack.Union());
+    builder.Finish(ack_msg);
+    LOG<INFO>("Server done building response");
+#ifdef PERF_LOG
+    double read_mbps = data_size / (1024.0 * 1024) /
+        (read_time.getUsElapsed() / 1000000.0);
+    LOG<PERF>("TCPServer::read_bulk time (us): ",
+            read_time.getUsElapsed(),
+            " bw (MB/s): ", read_mbps,
+            " size: ", data_size);
+#endif
+    return success;
+}
+
+int64_t checksum(const std::vector<int8_t>& data) {
+    int64_t sum = 0;
+    for (const auto& d : data) {
+        sum += d;
+    }
+    return sum;
+}
+
+/**
+ * Process a message received on a connection. Extracts the flatbuffer from
+ * the buffer, acts depending on the type of the message and queues the reply.
+ * @param conn the connection the message was received on.
+ * @param buffer the message.
+ * @param size the size of the message.
+ * @param builder empty builder for the reply.
+ * @return false if the reply could not be sent.
+ */
+bool TCPServer::process(Connection& conn, const char* buffer, uint32_t size,
+        flatbuffers::FlatBufferBuilder& builder) {
+    LOG<INFO>("Processing socket: ", conn.fd);
+
+    // Extract the message from the buffer
+    auto msg = message::TCPBladeMessage::GetTCPBladeMessage(buffer);
+    TxnID txn_id = msg->txnid();
+
+    // Initialize the error code
+    cirrus::ErrorCodes error_code = cirrus::ErrorCodes::kOk;
+
+    LOG<INFO>("Server checking type of message");
+    // Data sent after the reply, without being copied into it
+    std::vector<MemSlice> payload;
+    // Reactor threads share the backend, which is thread safe. Requests
+    // take mem_lock for the bookkeeping of the server only, and the locks
+    // of the objects they change. Rates are checked under the lock of the
+    // application, mem_lock is only taken to charge memory.
+    if (quotas.enabled()) {
+        if (!conn.app) {
+            conn.app = quotas.getApp(0);
+        }
+        // Authenticating is always allowed, so that a connection can
+        // leave an application over its rate
+        if (msg->message_type() !=
+                message::TCPBladeMessage::Message_Authenticate &&
+            !quotas.admit(conn.app, size)) {
+            LOG<INFO>("Rejected request of socket ", conn.fd,
+                    " over the rate of its application");
+            return reject(conn, txn_id,
+                    cirrus::ErrorCodes::kRateLimitedException, builder);
+        }
+    }
+    // Check message type
+    bool success = true;
+    // Whether the reply is sent later, by complete_watches()
+    bool deferred = false;
+    switch (msg->message_type()) {
+        case message::TCPBladeMessage::Message_Write:
+            {
+#ifdef PERF_LOG
+                TimerFunction write_time;
+#endif
+                // store_object() overwrites the object if it exists
+                // and accounts for the size change.
+                ObjectID oid = msg->message_as_Write()->oid();
+                LOG<INFO>("Server processing WRITE request to oid: .", oid);
+
+                // Service the write request by
+                // storing the serialized object
+                auto data_fb = msg->message_as_Write()->data();
+                uint64_t current = 0;
+                {
+                    std::lock_guard<std::recursive_mutex> object_guard(
+                            object_lock(oid));
+                    error_code = store_object(oid, MemSlice(data_fb), &conn);
+                    success = error_code == cirrus::ErrorCodes::kOk;
+                    if (success) {
+                        std::lock_guard<std::mutex> mem_guard(mem_lock);
+                        set_ttl(oid, msg->message_as_Write()->ttl_ms());
+                        current = version(oid);
+                    }
+                }
+
+                // Create and send ack
                 auto ack = message::TCPBladeMessage::CreateWriteAck(builder,
-                                           oid, success);
+                                           oid, success, current);
                 auto ack_msg =
                      message::TCPBladeMessage::CreateTCPBladeMessage(builder,
                                     txn_id,
@@ -457,71 +2419,46 @@ bool TCPServer::process(int sock) {
             }
         case message::TCPBladeMessage::Message_WriteBulk:
             {
-#ifdef PERF_LOG
-                TimerFunction write_time;
-#endif
-                // first see if the object exists on the server.
-                // If so, overwrite it and account for the size change.
                 uint64_t num_oids = msg->message_as_WriteBulk()->num_oids();
                 auto oids = msg->message_as_WriteBulk()->oids();
-                auto data_fb = msg->message_as_WriteBulk()->data();
                 LOG<INFO>("Server processing WRITE-BULK request");
 
-                assert(num_oids = oids->size());
-
-                const char* data_ptr =
-                    reinterpret_cast<const char*>(data_fb->data());
-                for (const auto& oid : *oids) {
-                    if (mem->exists(oid)) {
-                        curr_size -= mem->size(oid);
-                    }
-
-                    uint64_t obj_size =
-                        ntohl(*reinterpret_cast<const uint64_t*>(data_ptr));
-                    data_ptr += sizeof(uint64_t);
-
-                    // Throw error if put would exceed size of the store
-                    if (curr_size + obj_size > pool_size) {
-                        LOG<ERROR>("Put would go over capacity on server. ",
-                                "Current size: ", curr_size,
-                                " Incoming size: ", data_fb->size(),
-                                " Pool size: ", pool_size);
-                        error_code =
-                            cirrus::ErrorCodes::kServerMemoryErrorException;
-                        success = false;
-                        break;
-                    } else {
-                        // Service the write request by
-                        // storing the serialized object
-                        LOG<INFO>("Writing object with size: " , obj_size);
-                        const char* begin = data_ptr;
-                        const char* end = data_ptr + obj_size;
-                        mem->put(oid, MemSlice(begin, end));
-
-                        curr_size += obj_size;
-                    }
+                assert(num_oids == oids->size());
 
-                    data_ptr += obj_size;  // advance cursor
+                std::vector<uint64_t> oid_list(oids->begin(), oids->end());
+                auto object_guards = lock_objects(oid_list);
+                success = write_bulk(txn_id, oid_list,
+                        msg->message_as_WriteBulk()->data(),
+                        msg->message_as_WriteBulk()->partial(),
+                        msg->message_as_WriteBulk()->ttl_ms(), &conn,
+                        builder, &error_code);
+                break;
+            }
+        case message::TCPBladeMessage::Message_WriteRange:
+            {
+                ObjectID first = msg->message_as_WriteRange()->first();
+                uint64_t num_oids = msg->message_as_WriteRange()->num_oids();
+                LOG<INFO>("Server processing WRITE-RANGE request from oid: ",
+                        first, " num oids: ", num_oids);
+
+                // Every object comes with its size, a request announcing
+                // more objects than its data can hold is rejected before
+                // the ids are listed
+                auto data_fb = msg->message_as_WriteRange()->data();
+                std::vector<uint64_t> oid_list;
+                if (!data_fb) {
+                    LOG<ERROR>("No data for ", num_oids, " objects");
+                    error_code = cirrus::ErrorCodes::kInvalidArgumentException;
+                } else if (num_oids > data_fb->size() / sizeof(uint64_t)) {
+                    LOG<ERROR>("Data too short for ", num_oids, " objects");
+                    error_code = cirrus::ErrorCodes::kInvalidArgumentException;
+                } else {
+                    oid_list.resize(num_oids);
+                    std::iota(oid_list.begin(), oid_list.end(), first);
                 }
-
-                // Create and send ack
-                auto ack = message::TCPBladeMessage::CreateWriteBulkAck(builder,
-                                           success);
-                auto ack_msg =
-                     message::TCPBladeMessage::CreateTCPBladeMessage(builder,
-                                 txn_id,
-                                 static_cast<int64_t>(error_code),
-                                 message::TCPBladeMessage::Message_WriteBulkAck,
-                                 ack.Union());
-                builder.Finish(ack_msg);
-#ifdef PERF_LOG
-                double write_mbps = data_fb->size() / (1024.0 * 1024) /
-                    (write_time.getUsElapsed() / 1000000.0);
-                LOG<PERF>("TCPServer::process write-bulk time (us): ",
-                        write_time.getUsElapsed(),
-                        " bw (MB/s): ", write_mbps,
-                        " size: ", data_fb->size());
-#endif
+                auto object_guards = lock_objects(oid_list);
+                success = write_bulk(txn_id, oid_list, data_fb, false, 0,
+                        &conn, builder, &error_code);
                 break;
             }
         case message::TCPBladeMessage::Message_Read:
@@ -536,28 +2473,40 @@ bool TCPServer::process(int sock) {
 
                 LOG<INFO>("Server extracted oid: ", oid);
 
-                // If the oid is not on the server, this operation has failed
+                // The version is taken before the object, so that it is
+                // never newer than the object sent
+                uint64_t current;
+                {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    current = version(oid);
+                }
 
-                if (!mem->exists(oid)) {
+                // If the oid is not on the server, this operation has failed
+                auto obj = mem->lookup(oid);
+                if (!obj.found) {
                     success = false;
                     error_code = cirrus::ErrorCodes::kNoSuchIDException;
                     LOG<ERROR>("Oid ", oid, " does not exist on server");
                 }
+                if (cache_mode) {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    account_read(oid, obj.found);
+                }
 
-                flatbuffers::Offset<flatbuffers::Vector<int8_t>> fb_vector;
+                // The object is sent straight from the backend's memory,
+                // after the flatbuffer
                 if (success) {
-                    // XXX Getting the item twice is inefficient
-                    fb_vector = builder.CreateVector(
-                            std::vector<int8_t>(mem->get(oid).get()));
-                } else {
-                    std::vector<int8_t> data;
-                    fb_vector = builder.CreateVector(data);
+                    payload.push_back(std::move(obj.data));
                 }
+                uint64_t payload_size = success ? payload.back().size() : 0;
+                auto fb_vector = builder.CreateVector(std::vector<int8_t>());
 
                 LOG<INFO>("Server building response");
                 // Create and send ack
                 auto ack = message::TCPBladeMessage::CreateReadAck(builder,
-                                            oid, success, fb_vector);
+                                            oid, success, fb_vector,
+                                            payload_size,
+                                            success ? current : 0);
                 auto ack_msg =
                     message::TCPBladeMessage::CreateTCPBladeMessage(builder,
                                     txn_id,
@@ -567,96 +2516,311 @@ bool TCPServer::process(int sock) {
                 builder.Finish(ack_msg);
                 LOG<INFO>("Server done building response");
 #ifdef PERF_LOG
-                double read_mbps = mem->size(oid) / (1024.0 * 1024) /
+                double read_mbps = payload_size / (1024.0 * 1024) /
                     (read_time.getUsElapsed() / 1000000.0);
                 LOG<PERF>("TCPServer::process read time (us): ",
                         read_time.getUsElapsed(),
                         " bw (MB/s): ", read_mbps,
-                        " size: ", mem->size(oid));
+                        " size: ", payload_size);
 #endif
                 break;
             }
-        case message::TCPBladeMessage::Message_ReadBulk:
+        case message::TCPBladeMessage::Message_ReadIfNewer:
             {
-                /** Read Bulk operation
-                  * We assume objects do not change size during this operation
-                  * Warning: No atomicity guarantees
-                  */
-#ifdef PERF_LOG
-                TimerFunction read_time;
-#endif
-                LOG<INFO>("Processing READ BULK request");
-                // number of objects to be transfered
-                uint32_t num_oids = msg->message_as_ReadBulk()->num_oids();
-                auto data_fb_oids = msg->message_as_ReadBulk()->oids();
+                ObjectID oid = msg->message_as_ReadIfNewer()->oid();
+                uint64_t known = msg->message_as_ReadIfNewer()->version();
+                LOG<INFO>("Processing READ IF NEWER request for oid: ", oid,
+                        " version: ", known);
+
+                // As for reads, the version is taken before the object
+                uint64_t current;
+                {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    track_versions();
+                    current = version(oid);
+                }
+                auto obj = mem->lookup(oid);
+                if (!obj.found) {
+                    success = false;
+                    error_code = cirrus::ErrorCodes::kNoSuchIDException;
+                    LOG<ERROR>("Oid ", oid, " does not exist on server");
+                    current = 0;
+                }
+                if (cache_mode) {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    account_read(oid, obj.found);
+                }
 
-                // first we figure out the total size to send back
-                uint32_t data_size = sizeof(uint32_t);  //< size of main header
-                for (const auto& oid : *data_fb_oids) {
-                    if (!mem->exists(oid)) {
-                        success = false;
-                        error_code = cirrus::ErrorCodes::kNoSuchIDException;
-                        LOG<ERROR>("Oid ", oid, " does not exist on server");
-                        break;
+                // Objects the client already has are not sent
+                bool not_modified = success && current <= known;
+                if (success && !not_modified) {
+                    payload.push_back(std::move(obj.data));
+                }
+                uint64_t payload_size = success && !not_modified ?
+                    payload.back().size() : 0;
+                auto fb_vector = builder.CreateVector(std::vector<int8_t>());
+                auto ack = message::TCPBladeMessage::CreateReadAck(builder,
+                                            oid, success, fb_vector,
+                                            payload_size, current,
+                                            not_modified);
+                auto ack_msg =
+                    message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                                    txn_id,
+                                    static_cast<int64_t>(error_code),
+                                    message::TCPBladeMessage::Message_ReadAck,
+                                    ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
+        case message::TCPBladeMessage::Message_CompareAndSwap:
+        case message::TCPBladeMessage::Message_FetchAdd:
+        case message::TCPBladeMessage::Message_Accumulate:
+            {
+                MemSlice data;
+                ObjectID oid;
+                std::unique_lock<std::recursive_mutex> object_guard;
+                if (msg->message_type() ==
+                    message::TCPBladeMessage::Message_CompareAndSwap) {
+                    auto cas = msg->message_as_CompareAndSwap();
+                    oid = cas->oid();
+                    object_guard =
+                        std::unique_lock<std::recursive_mutex>(
+                                object_lock(oid));
+                    LOG<INFO>("Processing COMPARE AND SWAP request for oid: ",
+                            oid);
+                    if (!cas->desired()) {
+                        LOG<ERROR>("Client sent a swap without an object");
+                        return false;
+                    }
+                    error_code = compare_and_swap(oid, cas->expected(),
+                            cas->expected_version(), cas->desired(),
+                            &success, &data, &conn);
+                } else if (msg->message_type() ==
+                           message::TCPBladeMessage::Message_FetchAdd) {
+                    auto add = msg->message_as_FetchAdd();
+                    oid = add->oid();
+                    object_guard =
+                        std::unique_lock<std::recursive_mutex>(
+                                object_lock(oid));
+                    LOG<INFO>("Processing FETCH ADD request for oid: ", oid);
+                    if (!add->operand()) {
+                        LOG<ERROR>("Client sent an add without an operand");
+                        return false;
+                    }
+                    error_code = add_vector(oid, add->type(), 1,
+                            add->operand(), add->fetch(), &data, &conn);
+                    success = error_code == cirrus::ErrorCodes::kOk;
+                } else {
+                    auto acc = msg->message_as_Accumulate();
+                    oid = acc->oid();
+                    object_guard =
+                        std::unique_lock<std::recursive_mutex>(
+                                object_lock(oid));
+                    LOG<INFO>("Processing ACCUMULATE request for oid: ", oid);
+                    if (!acc->operand()) {
+                        LOG<ERROR>("Client sent an add without an operand");
+                        return false;
                     }
+                    error_code = add_vector(oid, acc->type(), acc->scale(),
+                            acc->operand(), false, &data, &conn);
+                    success = error_code == cirrus::ErrorCodes::kOk;
+                }
+                bool exists = mem->exists(oid);
+                uint64_t current = 0;
+                if (exists) {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    current = version(oid);
+                }
+                object_guard.unlock();
 
-                    // size of an header containing size of object
-                    data_size += sizeof(uint32_t);
-                    // size of the data
-                    data_size += mem->size(oid);
+                // As with reads, the object is sent after the flatbuffer
+                uint64_t payload_size = data.size();
+                if (payload_size > 0) {
+                    payload.push_back(std::move(data));
+                }
+                auto fb_vector = builder.CreateVector(std::vector<int8_t>());
+                auto ack = message::TCPBladeMessage::CreateAtomicAck(builder,
+                        oid, success, current, fb_vector, payload_size);
+                auto ack_msg =
+                    message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                                    txn_id,
+                                    static_cast<int64_t>(error_code),
+                                    message::TCPBladeMessage::Message_AtomicAck,
+                                    ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
+        case message::TCPBladeMessage::Message_Watch:
+            {
+                auto oids_fb = msg->message_as_Watch()->oids();
+                auto versions_fb = msg->message_as_Watch()->versions();
+                uint64_t timeout_ms = msg->message_as_Watch()->timeout_ms();
+                if (!oids_fb || !versions_fb ||
+                    oids_fb->size() != versions_fb->size()) {
+                    LOG<ERROR>("Client sent a watch without a version for "
+                            "every object");
+                    return false;
+                }
+                LOG<INFO>("Processing WATCH request on ", oids_fb->size(),
+                        " oids, timeout (ms): ", timeout_ms);
+
+                std::vector<ObjectID> oids(oids_fb->begin(), oids_fb->end());
+                std::vector<uint64_t> known(versions_fb->begin(),
+                        versions_fb->end());
+                std::vector<uint64_t> current;
+                std::lock_guard<std::mutex> mem_guard(mem_lock);
+                track_versions();
+                auto statuses = written_since(oids, known, &current);
+                if (timeout_ms > 0 && std::find(statuses.begin(),
+                            statuses.end(), 1) == statuses.end()) {
+                    // Answered once an object is written
+                    add_watch(conn, txn_id, std::move(oids),
+                            std::move(known), timeout_ms);
+                    deferred = true;
+                    break;
                 }
 
-                flatbuffers::Offset<flatbuffers::Vector<int8_t>> data_fb_vector;
+                auto statuses_fb = builder.CreateVector(statuses);
+                auto current_fb = builder.CreateVector(current);
+                auto ack = message::TCPBladeMessage::CreateWatchAck(builder,
+                        statuses_fb, current_fb);
+                auto ack_msg =
+                    message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                                    txn_id,
+                                    static_cast<int64_t>(error_code),
+                                    message::TCPBladeMessage::Message_WatchAck,
+                                    ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
+        case message::TCPBladeMessage::Message_ReadPartial:
+            {
+                ObjectID oid = msg->message_as_ReadPartial()->oid();
+                uint64_t offset = msg->message_as_ReadPartial()->offset();
+                uint64_t length = msg->message_as_ReadPartial()->length();
+                LOG<INFO>("Processing READ PARTIAL request for oid: ", oid,
+                        " offset: ", offset, " length: ", length);
+
+                // As for reads, the version is taken before the object
+                uint64_t current;
+                {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    current = version(oid);
+                }
+                auto obj = mem->lookup(oid);
+                if (!obj.found) {
+                    success = false;
+                    error_code = cirrus::ErrorCodes::kNoSuchIDException;
+                    LOG<ERROR>("Oid ", oid, " does not exist on server");
+                } else if (offset > obj.data.size() ||
+                           length > obj.data.size() - offset) {
+                    success = false;
+                    error_code = cirrus::ErrorCodes::kOutOfRangeException;
+                    LOG<ERROR>("Read past the end of oid ", oid,
+                            " of size ", obj.data.size());
+                }
+                if (cache_mode) {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    account_read(oid, obj.found);
+                }
 
+                // Only the bytes asked for are sent, still from the
+                // backend's memory
+                if (success && length > 0) {
+                    payload.push_back(obj.data.sub(offset, length));
+                }
+                uint64_t payload_size = success ? length : 0;
+                auto fb_vector = builder.CreateVector(std::vector<int8_t>());
+                auto ack = message::TCPBladeMessage::CreateReadAck(builder,
+                                            oid, success, fb_vector,
+                                            payload_size,
+                                            success ? current : 0);
+                auto ack_msg =
+                    message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                                    txn_id,
+                                    static_cast<int64_t>(error_code),
+                                    message::TCPBladeMessage::Message_ReadAck,
+                                    ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
+        case message::TCPBladeMessage::Message_WritePartial:
+            {
+                ObjectID oid = msg->message_as_WritePartial()->oid();
+                uint64_t offset = msg->message_as_WritePartial()->offset();
+                auto data_fb = msg->message_as_WritePartial()->data();
+                LOG<INFO>("Processing WRITE PARTIAL request for oid: ", oid,
+                        " offset: ", offset, " length: ", data_fb->size());
+
+                // Objects do not grow, so the pool size does not change
+                std::unique_lock<std::recursive_mutex> object_guard(
+                        object_lock(oid));
+                uint64_t current = 0;
+                // The backend checks the bounds, with a single lookup
+                uint64_t size = 0;
+                if (!mem->write_at(oid, offset, MemSlice(data_fb), &size)) {
+                    success = false;
+                    error_code = cirrus::ErrorCodes::kNoSuchIDException;
+                    LOG<ERROR>("Oid ", oid, " does not exist on server");
+                } else if (offset > size || data_fb->size() > size - offset) {
+                    success = false;
+                    error_code = cirrus::ErrorCodes::kOutOfRangeException;
+                    LOG<ERROR>("Write past the end of oid ", oid,
+                            " of size ", size);
+                }
                 if (success) {
-                    int8_t* raw_mem;
-                    // build the flatbuffer vector with the right size
-                    data_fb_vector =
-                        builder.CreateUninitializedVector(data_size, &raw_mem);
-                    // for each oid to be transfered
-                    // we copy the size of the object
-                    // and the content to the buffer
-                    *reinterpret_cast<uint32_t*>(raw_mem) = num_oids;
-                    raw_mem += sizeof(uint32_t);
-                    for (uint32_t i = 0; i < num_oids; ++i) {
-                        auto oid = *(data_fb_oids->begin() + i);
-
-                        auto oid_data = mem->get(oid).get();
-                        uint32_t size = oid_data.size();
-                        uint32_t* data_ptr =
-                                         reinterpret_cast<uint32_t*>(raw_mem);
-                        *data_ptr++ = htonl(size);
-
-                        raw_mem = reinterpret_cast<int8_t*>(data_ptr);
-                        std::memcpy(raw_mem, oid_data.data(), size);
-                        raw_mem = reinterpret_cast<int8_t*>(
-                                reinterpret_cast<char*>(raw_mem) + size);
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    if (cache_mode) {
+                        clock.touch(oid);
                     }
-                } else {
-                    data_fb_vector = builder.CreateVector(
-                            std::vector<int8_t>());
+                    // The log holds whole objects
+                    record_put(oid, &conn);
+                    current = version(oid);
                 }
+                object_guard.unlock();
 
-                LOG<INFO>("Server building readbulk response");
-                // Create and send ack
-                auto ack = message::TCPBladeMessage::CreateReadBulkAck(builder,
-                                                      success, data_fb_vector);
+                auto ack = message::TCPBladeMessage::CreateWriteAck(builder,
+                                           oid, success, current);
                 auto ack_msg =
-                    message::TCPBladeMessage::CreateTCPBladeMessage(builder,
-                                  txn_id,
-                                  static_cast<int64_t>(error_code),
-                                  message::TCPBladeMessage::Message_ReadBulkAck,
-                                  ack.Union());
+                     message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                                    txn_id,
+                                    static_cast<int64_t>(error_code),
+                                    message::TCPBladeMessage::Message_WriteAck,
+                                    ack.Union());
                 builder.Finish(ack_msg);
-                LOG<INFO>("Server done building response");
-#ifdef PERF_LOG
-                double read_mbps = data_size / (1024.0 * 1024) /
-                    (read_time.getUsElapsed() / 1000000.0);
-                LOG<PERF>("TCPServer::process readbulk time (us): ",
-                        read_time.getUsElapsed(),
-                        " bw (MB/s): ", read_mbps,
-                        " size: ", entry_itr->second.size());
-#endif
+                break;
+            }
+        case message::TCPBladeMessage::Message_ReadBulk:
+            {
+                LOG<INFO>("Processing READ BULK request");
+                auto data_fb_oids = msg->message_as_ReadBulk()->oids();
+                std::vector<uint64_t> oid_list(data_fb_oids->begin(),
+                        data_fb_oids->end());
+                success = read_bulk(txn_id, oid_list,
+                        msg->message_as_ReadBulk()->partial(), builder,
+                        &payload, &error_code);
+                break;
+            }
+        case message::TCPBladeMessage::Message_ReadRange:
+            {
+                ObjectID first = msg->message_as_ReadRange()->first();
+                ObjectID last = msg->message_as_ReadRange()->last();
+                LOG<INFO>("Processing READ RANGE request from oid: ", first,
+                        " to oid: ", last);
+
+                // Every id of the range is read, so wide ranges are
+                // rejected before the ids are listed
+                std::vector<uint64_t> oid_list;
+                if (first <= last && last - first >= max_range_size) {
+                    LOG<ERROR>("Range of ", last - first, " ids too wide");
+                    error_code = cirrus::ErrorCodes::kInvalidArgumentException;
+                } else if (first <= last) {
+                    oid_list.resize(last - first + 1);
+                    std::iota(oid_list.begin(), oid_list.end(), first);
+                }
+                success = read_bulk(txn_id, oid_list, false, builder,
+                        &payload, &error_code) &&
+                    error_code == cirrus::ErrorCodes::kOk;
                 break;
             }
         case message::TCPBladeMessage::Message_Remove:
@@ -664,12 +2828,20 @@ bool TCPServer::process(int sock) {
                 LOG<INFO>("Processing REMOVE request");
                 ObjectID oid = msg->message_as_Remove()->oid();
 
-                success = false;
                 // Remove the object if it exists on the server.
-                if (mem->exists(oid)) {
-                    curr_size -= mem->size(oid);
-                    mem->delet(oid);
-                    success = true;
+                {
+                    std::lock_guard<std::recursive_mutex> object_guard(
+                            object_lock(oid));
+                    uint64_t old_size;
+                    success = mem->erase(oid, &old_size);
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    if (success) {
+                        curr_size -= old_size;
+                        record_remove(oid, &conn);
+                    }
+                    if (cache_mode) {
+                        clock.remove(oid);
+                    }
                 }
                 // Create and send ack
                 auto ack = message::TCPBladeMessage::CreateWriteAck(builder,
@@ -683,46 +2855,229 @@ bool TCPServer::process(int sock) {
                 builder.Finish(ack_msg);
                 break;
             }
+        case message::TCPBladeMessage::Message_Call:
+            {
+                auto call = msg->message_as_Call();
+                if (!call->name()) {
+                    LOG<ERROR>("Client sent a call without a function name");
+                    return false;
+                }
+                LOG<INFO>("Processing CALL request of function: ",
+                        call->name()->str(), " from oid: ", call->first(),
+                        " to oid: ", call->last());
+
+                std::string result;
+                error_code = call_function(call->name()->str(),
+                        call->first(), call->last(), call->args(), &result);
+                success = error_code == cirrus::ErrorCodes::kOk;
+
+                // Only the result goes back, after the flatbuffer as the
+                // objects of reads
+                uint64_t payload_size = success ? result.size() : 0;
+                if (payload_size > 0) {
+                    payload.push_back(MemSlice(std::move(result)));
+                }
+                auto fb_vector = builder.CreateVector(std::vector<int8_t>());
+                auto ack = message::TCPBladeMessage::CreateReadAck(builder,
+                        call->first(), success, fb_vector, payload_size);
+                auto ack_msg =
+                    message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                                    txn_id,
+                                    static_cast<int64_t>(error_code),
+                                    message::TCPBladeMessage::Message_ReadAck,
+                                    ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
+        case message::TCPBladeMessage::Message_Subscribe:
+            {
+                auto sub = msg->message_as_Subscribe();
+                LOG<INFO>("Processing ",
+                        sub->unsubscribe() ? "UNSUBSCRIBE" : "SUBSCRIBE",
+                        " request from oid: ", sub->first(),
+                        " to oid: ", sub->last());
+                if (sub->first() > sub->last()) {
+                    success = false;
+                    error_code = cirrus::ErrorCodes::kOutOfRangeException;
+                } else if (sub->unsubscribe()) {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    unsubscribe(conn, sub->first(), sub->last());
+                } else {
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    subscribe(conn, sub->first(), sub->last());
+                }
+
+                auto ack = message::TCPBladeMessage::CreateSubscribeAck(
+                        builder, success);
+                auto ack_msg =
+                   message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                               txn_id,
+                               static_cast<int64_t>(error_code),
+                               message::TCPBladeMessage::Message_SubscribeAck,
+                               ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
+        case message::TCPBladeMessage::Message_Authenticate:
+            {
+                auto auth = msg->message_as_Authenticate();
+                AppId app_id = auth->app_id();
+                LOG<INFO>("Processing AUTHENTICATE request of socket: ",
+                        conn.fd, " app: ", app_id);
+                // Application 0 is open to every client, the others only
+                // to the clients that know their key
+                std::string key = auth->key() ? auth->key()->str() : "";
+                if (app_id != 0 && !(authenticator.allowApplication(app_id) &&
+                            authenticator.checkKey(app_id, key))) {
+                    LOG<ERROR>("Wrong key for app ", app_id,
+                            " from socket ", conn.fd);
+                    success = false;
+                    error_code = cirrus::ErrorCodes::kAuthenticationException;
+                } else if (quotas.enabled()) {
+                    conn.app = quotas.getApp(app_id);
+                }
+
+                auto ack = message::TCPBladeMessage::CreateAuthenticateAck(
+                        builder, success);
+                auto ack_msg =
+                   message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                            txn_id,
+                            static_cast<int64_t>(error_code),
+                            message::TCPBladeMessage::Message_AuthenticateAck,
+                            ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
+        case message::TCPBladeMessage::Message_CacheStats:
+            {
+                LOG<INFO>("Processing CACHE STATS request of socket: ",
+                        conn.fd);
+                CacheStats stats = cache_stats();
+                auto ack = message::TCPBladeMessage::CreateCacheStatsAck(
+                        builder, stats.hits, stats.misses, stats.evictions,
+                        stats.evicted_bytes);
+                auto ack_msg =
+                   message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                            txn_id,
+                            static_cast<int64_t>(error_code),
+                            message::TCPBladeMessage::Message_CacheStatsAck,
+                            ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
+        case message::TCPBladeMessage::Message_MemoryStats:
+            {
+                StorageBackend::MemoryStats stats = {0, 0, 0};
+                bool supported = mem->memory_stats(&stats);
+                LOG<INFO>("Processing MEMORY STATS request of socket: ",
+                        conn.fd, " bytes used: ", stats.bytes_used,
+                        " requested: ", stats.bytes_requested,
+                        " fragmentation: ", stats.fragmentation);
+                auto ack = message::TCPBladeMessage::CreateMemoryStatsAck(
+                        builder, supported, stats.bytes_used,
+                        stats.bytes_requested, stats.fragmentation);
+                auto ack_msg =
+                   message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                            txn_id,
+                            static_cast<int64_t>(error_code),
+                            message::TCPBladeMessage::Message_MemoryStatsAck,
+                            ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
+        case message::TCPBladeMessage::Message_RemoveRange:
+            {
+                ObjectID first = msg->message_as_RemoveRange()->first();
+                ObjectID last = msg->message_as_RemoveRange()->last();
+                LOG<INFO>("Processing REMOVE RANGE request from oid: ", first,
+                        " to oid: ", last);
+
+                // The ids removed are needed to forget their versions, log
+                // them and stop tracking them. They are only known once
+                // removed, so the locks of every id of the range are taken
+                std::vector<uint64_t> erased;
+                uint64_t old_bytes;
+                uint64_t num_removed;
+                {
+                    auto object_guards = lock_object_range(first, last);
+                    num_removed = mem->erase_range(first, last, &old_bytes,
+                            &erased);
+                    std::lock_guard<std::mutex> mem_guard(mem_lock);
+                    curr_size -= old_bytes;
+                    for (const auto& oid : erased) {
+                        record_remove(oid, &conn);
+                        if (cache_mode) {
+                            clock.remove(oid);
+                        }
+                    }
+                }
+
+                // Create and send ack
+                auto ack = message::TCPBladeMessage::CreateRemoveRangeAck(
+                        builder, num_removed, success);
+                auto ack_msg =
+                   message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+                               txn_id,
+                               static_cast<int64_t>(error_code),
+                               message::TCPBladeMessage::Message_RemoveRangeAck,
+                               ack.Union());
+                builder.Finish(ack_msg);
+                break;
+            }
         default:
             LOG<ERROR>("Unknown message", " type:", msg->message_type());
             throw cirrus::Exception("Unknown message "
                                     "type received from client.");
             break;
     }
-
-    int message_size = builder.GetSize();
-    // Convert size to network order and send
-    uint32_t network_order_size = htonl(message_size);
-    if (send_all(sock, &network_order_size, sizeof(uint32_t), 0) == -1) {
-        LOG<ERROR>("Server error sending message back to client. "
-            "Possible client died");
-        return false;
+    if (conn.app && !deferred) {
+        // Large replies are paid for by the next requests
+        uint64_t reply_size = builder.GetSize();
+        for (const auto& slice : payload) {
+            reply_size += slice.size();
+        }
+        quotas.chargeBandwidth(conn.app, reply_size);
+    }
+    if (deferred) {
+        return true;
     }
 
-    LOG<INFO>("Server sent size.");
     LOG<INFO>("On server error code is: ", static_cast<int64_t>(error_code));
-    // Send main message
 #ifdef PERF_LOG
     TimerFunction reply_time;
 #endif
-    if (send_all(sock, builder.GetBufferPointer(), message_size, 0)
-        != message_size) {
-        LOG<ERROR>("Server error sending message back to client. "
-            "Possible client died");
+    if (!queue_reply(conn, builder, std::move(payload))) {
         return false;
     }
 #ifdef PERF_LOG
-    double reply_mbps = message_size / (1024.0 * 1024) /
-        (reply_time.getUsElapsed() / 1000000.0);
     LOG<PERF>("TCPServer::process reply time (us): ",
-            reply_time.getUsElapsed(),
-            " bw (MB/s): ", reply_mbps);
+            reply_time.getUsElapsed());
 #endif
 
-    LOG<INFO>("Server sent ack of size: ", message_size);
     LOG<INFO>("Server done processing message from client");
     return true;
 }
 
+/**
+ * Replies to a request that is not run with an error.
+ * @param conn the connection the request was received on.
+ * @param txn_id the id of the request.
+ * @param error_code the reason the request is rejected.
+ * @param builder empty builder for the reply.
+ * @return false if the reply could not be sent.
+ */
+bool TCPServer::reject(Connection& conn, TxnID txn_id,
+        cirrus::ErrorCodes error_code,
+        flatbuffers::FlatBufferBuilder& builder) {
+    auto rejected = message::TCPBladeMessage::CreateRejected(builder);
+    auto msg = message::TCPBladeMessage::CreateTCPBladeMessage(builder,
+            txn_id,
+            static_cast<int64_t>(error_code),
+            message::TCPBladeMessage::Message_Rejected,
+            rejected.Union());
+    builder.Finish(msg);
+    return queue_reply(conn, builder, std::vector<MemSlice>());
+}
+
 
 }  // namespace cirrus
@@ -2,16 +2,34 @@
 #define SRC_SERVER_TCPSERVER_H_
 
 #include <poll.h>
+#include <array>
+#include <deque>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include "common/Exception.h"
+#include "common/schemas/TCPBladeMessage_generated.h"
 #include "server/Server.h"
 #include "server/MemoryBackend.h"
+#include "server/ClockEvictionPolicy.h"
+#include "server/WriteAheadLog.h"
+#include "server/FunctionRegistry.h"
+#include "server/TimingWheel.h"
+#include "server/QuotaManager.h"
+#include "authentication/KeyAuthenticator.h"
 
 namespace cirrus {
 
 using ObjectID = uint64_t;
+using TxnID = uint64_t;
 /**
   * This class serves as a remote store that allows connection from
   * clients over TCP.
@@ -23,19 +41,255 @@ class TCPServer : public Server {
             int port, uint64_t pool_size_,
             const std::string& backend = "Memory",
             const std::string& storage_path = "/tmp/cirrus_storage/",
-            uint64_t max_fds = 100);
-    ~TCPServer() = default;
+            uint64_t max_fds = 100,
+            uint64_t num_threads = 1);
+    ~TCPServer();
 
     virtual void init();
 
     virtual void loop();
 
+    /**
+      * Makes replies of at least bytes be sent with MSG_ZEROCOPY, where
+      * the kernel supports it. Must be called before init().
+      * @param bytes minimum size of a send to use MSG_ZEROCOPY. 0 disables
+      * MSG_ZEROCOPY (the default).
+      */
+    void set_zerocopy_threshold(uint64_t bytes);
+
+    void set_huge_pages(bool enable);
+
+    void set_watermarks(double high, double low);
+
+    void set_cache_mode(bool enable);
+
+    void set_snapshot_interval(uint64_t seconds);
+
+    void set_wal(bool enable);
+
+    void set_inline_threshold(uint64_t bytes);
+
+    void load_plugin(const std::string& path);
+
+    void set_default_quota(const QuotaManager::Limits& limits);
+
+    void set_quota(AppId app_id, const QuotaManager::Limits& limits);
+
+    void set_app_key(AppId app_id, const std::string& key);
+
+    /** Activity of the server when running as a cache. */
+    struct CacheStats {
+        uint64_t hits = 0;           //< reads of objects found
+        uint64_t misses = 0;         //< reads of objects not found
+        uint64_t evictions = 0;      //< objects evicted
+        uint64_t evicted_bytes = 0;  //< bytes of the objects evicted
+    };
+
+    CacheStats cache_stats();
+
  private:
-    bool process(int sock);
+    /**
+      * State of a client connection. Sockets are non blocking: requests
+      * are read and replies are sent incrementally, as far as the socket
+      * allows, and resumed on the next event. Every request already
+      * received is processed on a wakeup and the replies are sent together.
+      */
+    struct Connection {
+        Connection(int fd, uint64_t reactor) : fd(fd), reactor(reactor) {}
+
+        /** Whether there are replies not yet sent to the client. */
+        bool write_pending() const {
+            return !out_queue.empty();
+        }
+
+        /** The fd of the client's socket. */
+        int fd;
+        /** Index of the reactor thread serving the connection. */
+        uint64_t reactor;
+        /**
+          * Data read from the socket. Requests not yet processed are in
+          * [in_begin, in_end). Not initialized as it is always overwritten
+          * by the data read.
+          */
+        std::unique_ptr<char[]> in_buf;
+        /** Size of in_buf. */
+        uint64_t in_capacity = 0;
+        /** Offset of the first byte not yet processed. */
+        uint64_t in_begin = 0;
+        /** Offset of the end of the data read. */
+        uint64_t in_end = 0;
+        /**
+          * Replies the socket did not accept yet. Slices may point to the
+          * backend's memory and keep it alive until it is sent.
+          */
+        std::deque<MemSlice> out_queue;
+        /** Bytes of the first slice of out_queue already sent. */
+        uint64_t out_offset = 0;
+        /** Bytes in out_queue not yet sent. */
+        uint64_t out_size = 0;
+        /**
+          * Block the replies are copied into. Consecutive replies end up
+          * next to each other and are sent as one slice.
+          */
+        std::shared_ptr<std::vector<char>> out_block;
+        /** Whether the last slice of out_queue ends at the end of out_block. */
+        bool out_block_tail = false;
+        /** Whether large sends use MSG_ZEROCOPY. */
+        bool zerocopy = false;
+        /** Id the kernel gives to the next MSG_ZEROCOPY send. */
+        uint32_t zerocopy_next_id = 0;
+        /**
+          * Data of the MSG_ZEROCOPY sends the kernel may still read from,
+          * by send id. Released when the kernel reports the send completed.
+          */
+        std::map<uint32_t, std::vector<MemSlice>> zerocopy_inflight;
+        /** Whether the reactor waits for the socket to be writable. */
+        bool want_write = false;
+        /**
+          * Sequence number of the last log record of the requests of the
+          * connection. Replies are only sent once it is durable.
+          */
+        uint64_t wal_lsn = 0;
+        /**
+          * Application of the client, whose quotas apply to its requests.
+          * nullptr while quotas are not used. Only used by the thread of
+          * the connection.
+          */
+        QuotaManager::App* app = nullptr;
+    };
+
+    /**
+      * A request waiting for any of a set of objects to be written past
+      * a version, or for its deadline.
+      */
+    struct Watch {
+        /** The connection of the request. */
+        int fd;
+        uint64_t reactor;
+        TxnID txn_id;
+        /** The objects and the versions the client has of them. */
+        std::vector<ObjectID> oids;
+        std::vector<uint64_t> versions;
+        std::chrono::steady_clock::time_point deadline;
+        /** Set, with mem_lock held, once an object is written. */
+        bool fired = false;
+    };
+
+    /**
+      * A connection subscribed to the changes of a range of objects. The
+      * first id of the range is the key of the subscription.
+      */
+    struct Subscription {
+        int fd;
+        uint64_t reactor;
+        ObjectID last;
+    };
 
-    ssize_t send_all(int, const void*, size_t, int);
-    ssize_t read_all(int sock, void*, size_t len);
-    bool read_from_client(std::vector<char>&, int, uint64_t&);
+    /** Changes of objects not yet pushed to a connection. */
+    struct Invalidations {
+        std::vector<ObjectID> oids;
+        std::vector<uint64_t> versions;
+    };
+
+    /** Watches of the connections of a reactor thread. */
+    struct WatchList {
+        /**
+          * eventfd the reactor waits on, written when one of its watches
+          * fires. -1 for the poll() loop, where writes happen on the
+          * thread that owns the watches.
+          */
+        int wake_fd = -1;
+        /** Only accessed by the reactor thread. */
+        std::vector<std::shared_ptr<Watch>> watches;
+        /**
+          * Invalidations to push to the connections of the reactor, by fd.
+          * Guarded by mem_lock.
+          */
+        std::unordered_map<int, Invalidations> invalidations;
+    };
+
+    int create_listen_socket();
+    void reactor_loop(int listen_sock, uint64_t reactor);
+    void accept_connections(int epoll_fd, int listen_sock, uint64_t reactor,
+            std::unordered_map<int, Connection>* connections);
+
+    void enable_zerocopy(Connection& conn);
+    bool handle_events(Connection& conn, bool readable, bool writable,
+            bool error);
+    bool handle_error(Connection& conn);
+    bool reap_zerocopy(Connection& conn);
+    bool handle_read(Connection& conn);
+    void reserve_input(Connection& conn);
+    bool process_requests(Connection& conn,
+            flatbuffers::FlatBufferBuilder& builder);
+    bool flush(Connection& conn);
+    bool queue_reply(Connection& conn,
+            const flatbuffers::FlatBufferBuilder& builder,
+            std::vector<MemSlice>&& payload);
+    bool process(Connection& conn, const char* buffer, uint32_t size,
+            flatbuffers::FlatBufferBuilder& builder);
+    bool reject(Connection& conn, TxnID txn_id,
+            cirrus::ErrorCodes error_code,
+            flatbuffers::FlatBufferBuilder& builder);
+    std::recursive_mutex& object_lock(ObjectID oid);
+    std::vector<std::unique_lock<std::recursive_mutex>> lock_objects(
+            const std::vector<ObjectID>& oids);
+    std::vector<std::unique_lock<std::recursive_mutex>> lock_object_range(
+            ObjectID first, ObjectID last);
+    std::vector<std::unique_lock<std::recursive_mutex>> lock_all_objects();
+    cirrus::ErrorCodes store_object(ObjectID oid, const MemSlice& data,
+            Connection* conn);
+    cirrus::ErrorCodes compare_and_swap(ObjectID oid,
+            const flatbuffers::Vector<int8_t>* expected,
+            uint64_t expected_version,
+            const flatbuffers::Vector<int8_t>* desired,
+            bool* swapped, MemSlice* current, Connection* conn);
+    cirrus::ErrorCodes add_vector(ObjectID oid,
+            message::TCPBladeMessage::AddType type, double scale,
+            const flatbuffers::Vector<int8_t>* operand, bool fetch,
+            MemSlice* previous, Connection* conn);
+    cirrus::ErrorCodes call_function(const std::string& name,
+            ObjectID first, ObjectID last,
+            const flatbuffers::Vector<int8_t>* args, std::string* result);
+    bool write_bulk(TxnID txn_id, const std::vector<uint64_t>& oid_list,
+            const flatbuffers::Vector<int8_t>* data_fb, bool partial,
+            uint64_t ttl_ms, Connection* conn,
+            flatbuffers::FlatBufferBuilder& builder,
+            cirrus::ErrorCodes* error_code);
+    bool read_bulk(TxnID txn_id, const std::vector<uint64_t>& oid_list,
+            bool partial, flatbuffers::FlatBufferBuilder& builder,
+            std::vector<MemSlice>* payload, cirrus::ErrorCodes* error_code);
+    std::string snapshot_file() const;
+    void recover();
+    void snapshot_loop();
+    void set_ttl(ObjectID oid, uint64_t ttl_ms);
+    uint64_t elapsed_ms() const;
+    void expiry_loop();
+    void record_put(ObjectID oid, Connection* conn);
+    void record_remove(ObjectID oid, Connection* conn);
+    void track_versions();
+    uint64_t version(ObjectID oid) const;
+    std::vector<int8_t> written_since(const std::vector<ObjectID>& oids,
+            const std::vector<uint64_t>& known,
+            std::vector<uint64_t>* current) const;
+    void add_watch(const Connection& conn, TxnID txn_id,
+            std::vector<ObjectID>&& oids, std::vector<uint64_t>&& known,
+            uint64_t timeout_ms);
+    void fire_watches(ObjectID oid);
+    void unregister_watch(const std::shared_ptr<Watch>& watch);
+    std::vector<int> complete_watches(uint64_t reactor,
+            std::unordered_map<int, Connection>* connections);
+    void cancel_watches(uint64_t reactor, int fd);
+    void subscribe(const Connection& conn, ObjectID first, ObjectID last);
+    void unsubscribe(const Connection& conn, ObjectID first, ObjectID last);
+    void update_widest_subscription();
+    void notify_subscribers(ObjectID oid, uint64_t version, int writer_fd);
+    std::vector<int> send_invalidations(uint64_t reactor,
+            std::unordered_map<int, Connection>* connections);
+    int wait_timeout(uint64_t reactor) const;
+    void account_read(ObjectID oid, bool found);
+    void evict(ObjectID oid, uint64_t old_size, uint64_t size,
+            Connection* conn);
 
     bool testRemove(struct pollfd x);
 
@@ -50,9 +304,165 @@ class TCPServer : public Server {
     /** Number of bytes currently in the pool. */
     uint64_t curr_size = 0;
 
+    /**
+     * Number of bytes above which writes are rejected. pool_size, unless
+     * the backend spills objects to disk.
+     */
+    uint64_t max_size;
+
+    /** Type of backend: "Memory", "Slab", "Storage", "Log" or "Tiered". */
+    std::string backend_type;
+    /**
+     * Path to disk storage. Used when backend is "Storage", "Log" or
+     * "Tiered".
+     */
+    std::string storage_path;
+    /** Whether the Slab backend uses huge pages. */
+    bool huge_pages = false;
+    /**
+     * Fractions of pool_size between which the Tiered backend demotes
+     * objects to disk.
+     */
+    double high_watermark = 0.9;
+    double low_watermark = 0.7;
+
+    /** Whether a full pool evicts objects instead of rejecting writes. */
+    bool cache_mode = false;
+    /** Picks the objects to evict, in cache mode. */
+    ClockEvictionPolicy clock;
+    CacheStats cache_counters;
+
+    /**
+      * Seconds between snapshots of the Memory backend. 0 if disabled, or
+      * only taken to truncate the write-ahead log.
+      */
+    uint64_t snapshot_interval = 0;
+    std::thread snapshot_thread;
+    bool terminate_snapshots = false;
+    std::mutex snapshot_lock;
+    std::condition_variable snapshot_cv;
+
+    /**
+      * Deadlines of the objects written with a TTL, in milliseconds since
+      * start_time. Guarded by mem_lock.
+      */
+    TimingWheel expirations;
+    /**
+      * Objects whose TTL elapsed, until the expiry thread removes them.
+      * Writes that set a new TTL take objects out. Guarded by mem_lock.
+      */
+    std::unordered_set<ObjectID> expiring;
+    std::chrono::steady_clock::time_point start_time;
+    /**
+      * Thread that removes the objects whose TTL elapsed, started by the
+      * first write with a TTL. Guarded by mem_lock until the server stops.
+      */
+    std::thread expiry_thread;
+    bool terminate_expiry = false;
+    std::mutex expiry_lock;
+    std::condition_variable expiry_cv;
+
+    /** Largest objects kept in the index of the Memory backend. */
+    uint64_t inline_threshold = MemoryBackend::max_inline_size;
+
+    /** Functions of the plugins loaded, run on objects for clients. */
+    FunctionRegistry functions;
+
+    /** Whether the Memory backend logs writes. */
+    bool use_wal = false;
+    /** Log of the writes, if enabled. */
+    std::unique_ptr<WriteAheadLog> wal;
+
+    /**
+      * Whether the version of every object is tracked. Only needed once a
+      * client compares versions (ReadIfNewer, Watch or a compare-and-swap
+      * on a version), until then every object has the last version given.
+      */
+    bool tracking_versions = false;
+    /**
+      * Version of every object written since versions are tracked. Each
+      * write gives the object the next version, so versions only grow.
+      */
+    std::unordered_map<ObjectID, uint64_t> versions;
+    /**
+      * Version of the objects not written since versions are tracked.
+      * Above every version given before, so that clients holding them see
+      * the objects as newer. The first one is taken from the clock, so
+      * that it is above the versions given before a restart.
+      */
+    uint64_t base_version = 0;
+    /** Last version given. */
+    uint64_t last_version = 0;
+
+    /** Watches waiting on each object. Guarded by mem_lock. */
+    std::unordered_multimap<ObjectID, std::shared_ptr<Watch>> watchers;
+    /** Watches of each reactor thread, one for the poll() loop. */
+    std::vector<WatchList> watch_lists;
+    /**
+      * Subscriptions of the connections, by the first id of their range.
+      * Guarded by mem_lock.
+      */
+    std::multimap<ObjectID, Subscription> subscriptions;
+    /**
+      * Largest last - first of the subscriptions. Only subscriptions whose
+      * first id is that close below an object can hold it. Guarded by
+      * mem_lock.
+      */
+    ObjectID widest_subscription = 0;
+    /**
+      * Quotas of the applications. The memory charged to them is guarded
+      * by mem_lock, their rates have locks of their own.
+      */
+    QuotaManager quotas;
+    /** Keys of the applications. Only read once the server runs. */
+    KeyAuthenticator authenticator;
+
     /** Max number of sockets open at once. */
     const uint64_t max_fds;
 
+    /** Minimum size of a send to use MSG_ZEROCOPY. 0 if disabled. */
+    uint64_t zerocopy_threshold = 0;
+
+    /**
+     * Number of reactor threads. With a single thread the server runs the
+     * poll() loop. Otherwise every thread runs its own epoll loop over its
+     * own listening socket and connections.
+     */
+    const uint64_t num_threads;
+
+    /**
+     * Listening sockets of the reactor threads. They all bind the same
+     * port with SO_REUSEPORT so the kernel spreads accepts across them.
+     */
+    std::vector<int> reactor_socks_;
+
+    /** Threads running reactor_loop(), one per reactor socket. */
+    std::vector<std::thread> reactors_;
+
+    /** Number of client connections open across all reactor threads. */
+    std::atomic<uint64_t> num_connections = {0};
+
+    /**
+     * Guards the state of the server shared by the reactor threads:
+     * curr_size, versions, the clock, watches, subscriptions, TTLs and
+     * the memory charged to quotas. Backends are thread safe and are called without it, so it
+     * is only held for the bookkeeping of a request. Log records are
+     * appended with it held, in the order of the versions.
+     */
+    std::mutex mem_lock;
+
+    /** log2 of the number of object locks. */
+    static constexpr uint64_t object_lock_bits = 10;
+    /**
+     * Serialize the requests that change the same object, so that a
+     * change and its bookkeeping are not interleaved with another change
+     * of the object, and so that atomic operations are atomic. Objects
+     * are spread over the locks by hashing their ids. Taken before
+     * mem_lock, and never waited for with mem_lock held. Recursive, so
+     * that a request can take the locks of objects that share one.
+     */
+    std::array<std::recursive_mutex, 1 << object_lock_bits> object_locks;
+
     /**
      * Index that the next socket accepted should have in the
      * array of struct pollfds.
@@ -73,6 +483,9 @@ class TCPServer : public Server {
      */
     std::vector<struct pollfd> fds = std::vector<struct pollfd>(max_fds);
 
+    /** Connections served by the poll() loop, indexed by fd. */
+    std::unordered_map<int, Connection> connections;
+
     /**
       * Memory interface
       */
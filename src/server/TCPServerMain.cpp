@@ -1,5 +1,8 @@
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
 #include "server/TCPServer.h"
 #include "utils/logging.h"
 
@@ -12,11 +15,116 @@ void print_arguments() {
     std::cout
         << "Error: ./tcpservermain"
         << " [pool_size=10] [backend_type=Memory]"
+        << " [storage_path=/tmp/cirrus_storage] [num_threads=1]"
+        << " [--option=value ...]"
         << std::endl
         << " pool_size in MB" << std::endl
+        << " backend_type is Memory, Slab, Storage, Log or Tiered" << std::endl
+        << " options:" << std::endl
+        << "  --zerocopy_threshold=bytes send replies of at least bytes"
+        << " with MSG_ZEROCOPY (0 disables)" << std::endl
+        << "  --huge_pages=1 back the Slab backend with huge pages"
+        << std::endl
+        << "  --high_watermark=percent --low_watermark=percent of pool_size"
+        << " between which the Tiered backend moves objects to disk"
+        << std::endl
+        << "  --cache_mode=1 evict least recently used objects when the"
+        << " pool is full instead of rejecting writes" << std::endl
+        << "  --snapshot_interval=seconds snapshot the Memory backend to"
+        << " storage_path and reload it on start (0 disables)" << std::endl
+        << "  --wal=1 log the writes to the Memory backend in storage_path"
+        << " and replay them on start. Without snapshot_interval, a"
+        << " snapshot is taken when the log outgrows pool_size" << std::endl
+        << "  --inline_threshold=bytes keep objects of up to bytes (at most "
+        << cirrus::MemoryBackend::max_inline_size
+        << ") in the index of the Memory backend" << std::endl
+        << "  --plugin=path load the functions of a plugin, which clients"
+        << " can run on objects (can be repeated)" << std::endl
+        << "  --app_memory=MB --app_requests=per_second"
+        << " --app_bandwidth=MB_per_second limits of every application"
+        << " (0 for no limit)" << std::endl
+        << "  --quota=app_id:MB:per_second:MB_per_second limits of one"
+        << " application (can be repeated)" << std::endl
+        << "  --app_key=app_id:key key clients authenticate with to act as"
+        << " an application other than 0 (can be repeated)" << std::endl
         << std::endl;
 }
 
+/**
+ * Parses an option given as --name=value.
+ * @param arg the argument
+ * @param name the name of the option
+ * @param value where the value is stored
+ * @return true if arg is a well formed option called name
+ */
+static bool parse_option(const std::string& arg, const std::string& name,
+        uint64_t* value) {
+    std::string prefix = "--" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    std::istringstream iss(arg.substr(prefix.size()));
+    return static_cast<bool>(iss >> *value);
+}
+
+/**
+ * Parses an option given as --name=value, whose value is a string.
+ * @param arg the argument
+ * @param name the name of the option
+ * @param values where the value is added
+ * @return true if arg is a well formed option called name
+ */
+static bool parse_option(const std::string& arg, const std::string& name,
+        std::vector<std::string>* values) {
+    std::string prefix = "--" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0 ||
+        arg.size() == prefix.size()) {
+        return false;
+    }
+    values->push_back(arg.substr(prefix.size()));
+    return true;
+}
+
+/**
+ * Parses the limits of an application, given as
+ * app_id:memory:requests:bandwidth with sizes in MB.
+ * @param quota the limits
+ * @param app_id where the application is stored
+ * @param limits where the limits are stored
+ * @return true if quota is well formed
+ */
+static bool parse_quota(const std::string& quota, cirrus::AppId* app_id,
+        cirrus::QuotaManager::Limits* limits) {
+    std::istringstream iss(quota);
+    char sep1, sep2, sep3;
+    if (!(iss >> *app_id >> sep1 >> limits->memory >> sep2 >>
+                limits->requests_per_s >> sep3 >> limits->bytes_per_s) ||
+        sep1 != ':' || sep2 != ':' || sep3 != ':' || !iss.eof()) {
+        return false;
+    }
+    limits->memory *= MB;
+    limits->bytes_per_s *= MB;
+    return true;
+}
+
+/**
+ * Parses the key of an application, given as app_id:key.
+ * @param app_key the application and its key
+ * @param app_id where the application is stored
+ * @param key where the key is stored
+ * @return true if app_key is well formed
+ */
+static bool parse_app_key(const std::string& app_key, cirrus::AppId* app_id,
+        std::string* key) {
+    std::istringstream iss(app_key);
+    char sep;
+    if (!(iss >> *app_id >> sep) || sep != ':' || !std::getline(iss, *key) ||
+        key->empty()) {
+        return false;
+    }
+    return true;
+}
+
 /**
  * Starts a TCP based key value store server. Accepts the pool size as
  * a command line argument. This specifies how large a memory pool will be
@@ -26,8 +134,58 @@ auto main(int argc, char *argv[]) -> int {
     uint64_t pool_size = 10 * GB;
     std::string backend_type = "Memory";
     std::string storage_path = "/tmp/cirrus_storage";
+    uint64_t num_threads = 1;
+    uint64_t zerocopy_threshold = 0;
+    uint64_t huge_pages = 0;
+    uint64_t high_watermark = 90;
+    uint64_t low_watermark = 70;
+    uint64_t cache_mode = 0;
+    uint64_t snapshot_interval = 0;
+    uint64_t wal = 0;
+    uint64_t inline_threshold = cirrus::MemoryBackend::max_inline_size;
+    std::vector<std::string> plugins;
+    cirrus::QuotaManager::Limits default_limits;
+    std::vector<std::string> quotas;
+    std::vector<std::string> app_keys;
+
+    // Options come after the positional arguments
+    while (argc > 1 && strncmp(argv[argc - 1], "--", 2) == 0) {
+        std::string arg = argv[argc - 1];
+        if (!parse_option(arg, "zerocopy_threshold", &zerocopy_threshold) &&
+            !parse_option(arg, "huge_pages", &huge_pages) &&
+            !parse_option(arg, "high_watermark", &high_watermark) &&
+            !parse_option(arg, "low_watermark", &low_watermark) &&
+            !parse_option(arg, "cache_mode", &cache_mode) &&
+            !parse_option(arg, "snapshot_interval", &snapshot_interval) &&
+            !parse_option(arg, "wal", &wal) &&
+            !parse_option(arg, "inline_threshold", &inline_threshold) &&
+            !parse_option(arg, "plugin", &plugins) &&
+            !parse_option(arg, "app_memory", &default_limits.memory) &&
+            !parse_option(arg, "app_requests",
+                &default_limits.requests_per_s) &&
+            !parse_option(arg, "app_bandwidth",
+                &default_limits.bytes_per_s) &&
+            !parse_option(arg, "quota", &quotas) &&
+            !parse_option(arg, "app_key", &app_keys)) {
+            print_arguments();
+            throw std::runtime_error("Wrong option: " + arg);
+        }
+        argc--;
+    }
 
     switch (argc) {
+        case 5:
+            {
+                std::istringstream iss(argv[4]);
+                if (!(iss >> num_threads) || num_threads == 0) {
+                    std::cout << "Number of threads in invalid format."
+                        << std::endl;
+                    return -1;
+                }
+#if __GNUC__ >= 7
+                [[fallthrough]];
+#endif
+            }
         case 4:
             {
                 storage_path = argv[3];
@@ -37,7 +195,9 @@ auto main(int argc, char *argv[]) -> int {
             }
         case 3:
             {
-                if (strcmp(argv[2], "Memory") && strcmp(argv[2], "Storage")) {
+                if (strcmp(argv[2], "Memory") && strcmp(argv[2], "Storage") &&
+                    strcmp(argv[2], "Slab") && strcmp(argv[2], "Log") &&
+                    strcmp(argv[2], "Tiered")) {
                     throw std::runtime_error("Wrong backend type");
                 }
                 backend_type = argv[2];
@@ -68,9 +228,42 @@ auto main(int argc, char *argv[]) -> int {
     // Instantiate the server
     cirrus::LOG<cirrus::INFO>(
             "Starting TCPServer in port: ", port,
-            " with memory: ", pool_size);
+            " with memory: ", pool_size,
+            " threads: ", num_threads);
     cirrus::TCPServer server(port, pool_size, backend_type,
-                             storage_path, max_fds);
+                             storage_path, max_fds, num_threads);
+    server.set_zerocopy_threshold(zerocopy_threshold);
+    server.set_huge_pages(huge_pages != 0);
+    server.set_watermarks(high_watermark / 100.0, low_watermark / 100.0);
+    server.set_cache_mode(cache_mode != 0);
+    server.set_snapshot_interval(snapshot_interval);
+    server.set_wal(wal != 0);
+    server.set_inline_threshold(inline_threshold);
+    // Options were parsed from the last one, plugins load in command order
+    for (auto it = plugins.rbegin(); it != plugins.rend(); ++it) {
+        server.load_plugin(*it);
+    }
+    default_limits.memory *= MB;
+    default_limits.bytes_per_s *= MB;
+    server.set_default_quota(default_limits);
+    for (const auto& quota : quotas) {
+        cirrus::AppId app_id;
+        cirrus::QuotaManager::Limits limits;
+        if (!parse_quota(quota, &app_id, &limits)) {
+            print_arguments();
+            throw std::runtime_error("Wrong quota: " + quota);
+        }
+        server.set_quota(app_id, limits);
+    }
+    for (const auto& app_key : app_keys) {
+        cirrus::AppId app_id;
+        std::string key;
+        if (!parse_app_key(app_key, &app_id, &key)) {
+            print_arguments();
+            throw std::runtime_error("Wrong application key: " + app_key);
+        }
+        server.set_app_key(app_id, key);
+    }
     // Initialize the server
     server.init();
     // Loop the server and listen for clients. Act on requests
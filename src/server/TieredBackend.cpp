@@ -0,0 +1,381 @@
+#include "server/TieredBackend.h"
+
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include "utils/logging.h"
+
+namespace cirrus {
+
+TieredBackend::TieredBackend(std::unique_ptr<StorageBackend> hot,
+        std::unique_ptr<StorageBackend> cold, uint64_t capacity,
+        double high_watermark, double low_watermark) :
+    hot(std::move(hot)), cold(std::move(cold)), capacity(capacity),
+    high_watermark(high_watermark * capacity),
+    low_watermark(low_watermark * capacity) {
+    if (low_watermark > high_watermark || high_watermark > 1) {
+        throw std::runtime_error("Wrong watermarks for TieredBackend");
+    }
+}
+
+TieredBackend::~TieredBackend() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        terminate = true;
+    }
+    demotion_cv.notify_all();
+    room_cv.notify_all();
+    if (demoter.joinable()) {
+        demoter.join();
+    }
+}
+
+/**
+  * Initializes the tiers and indexes the objects the cold tier kept from
+  * a previous run.
+  */
+void TieredBackend::init() {
+    hot->init();
+    cold->init();
+
+    std::vector<uint64_t> oids;
+    if (!cold->list_range(0, std::numeric_limits<uint64_t>::max(), &oids)) {
+        throw std::runtime_error("Cold tier of TieredBackend cannot list "
+                "its objects");
+    }
+    for (const auto& oid : oids) {
+        Entry& entry = index[oid];
+        entry.size = cold->size(oid);
+        entry.hot = false;
+        entry.version = ++last_version;
+        counters.cold_objects++;
+        counters.cold_bytes += entry.size;
+    }
+    LOG<INFO>("Indexed ", oids.size(), " objects of the cold tier");
+
+    demoter = std::thread(&TieredBackend::demotion_loop, this);
+}
+
+/**
+  * Deletes an object from the cold tier without the lock. The object must
+  * already be out of the index or in the hot tier, it is not demoted again
+  * until the delete is done.
+  * @param oid the id of the object
+  * @param guard holds the lock, released during the delete
+  */
+void TieredBackend::delete_cold(uint64_t oid,
+        std::unique_lock<std::mutex>* guard) const {
+    cold_deletes[oid]++;
+    guard->unlock();
+    cold->delet(oid);
+    guard->lock();
+    auto it = cold_deletes.find(oid);
+    if (--it->second == 0) {
+        cold_deletes.erase(it);
+    }
+}
+
+/**
+  * Waits for the demotion thread to make room in the hot tier.
+  * @param oid the id of the object that needs room
+  * @param size the size of the object
+  * @param guard holds the lock, released while waiting
+  * @return true if the object fits in the hot tier
+  */
+bool TieredBackend::make_room(uint64_t oid, uint64_t size,
+        std::unique_lock<std::mutex>* guard) const {
+    while (counters.hot_bytes + size > capacity && !lru.empty() &&
+           !terminate) {
+        uint64_t demotions = counters.demotions;
+        room_wanted = true;
+        demotion_cv.notify_one();
+        room_cv.wait(*guard);
+        if (counters.demotions == demotions &&
+            counters.hot_bytes + size > capacity) {
+            LOG<ERROR>("No room made in the hot tier for object ", oid);
+            break;
+        }
+    }
+    return counters.hot_bytes + size <= capacity;
+}
+
+/**
+  * Moves the least recently used object of the hot tier to the cold tier.
+  * The object is copied without the lock, it stays in the hot tier until
+  * the copy is done. If it is written or erased in the meantime, the copy
+  * is dropped. Objects still being deleted from the cold tier are skipped.
+  * Only called by the demotion thread.
+  * @param guard holds the lock, released during the copy
+  * @return true if an object was demoted or dropped
+  */
+bool TieredBackend::demote_one(std::unique_lock<std::mutex>* guard) {
+    auto victim = lru.rbegin();
+    while (victim != lru.rend() && cold_deletes.count(*victim)) {
+        ++victim;
+    }
+    if (victim == lru.rend()) {
+        return false;
+    }
+
+    uint64_t oid = *victim;
+    MemSlice data = hot->get(oid);
+    demoting = true;
+    demoting_oid = oid;
+    demotion_cancelled = false;
+
+    guard->unlock();
+    bool stored = cold->put(oid, data);
+    guard->lock();
+
+    demoting = false;
+    if (!stored) {
+        LOG<ERROR>("Cold tier failed to store object ", oid);
+        return false;
+    }
+    if (demotion_cancelled) {
+        // The copy is older than the object, or the object is gone
+        delete_cold(oid, guard);
+        return true;
+    }
+    hot->delet(oid);
+
+    Entry& entry = index.at(oid);
+    lru.erase(entry.lru);
+    entry.hot = false;
+    entry.version = ++last_version;
+    counters.hot_objects--;
+    counters.hot_bytes -= entry.size;
+    counters.cold_objects++;
+    counters.cold_bytes += entry.size;
+    counters.demotions++;
+    return true;
+}
+
+/**
+  * Loop run by the demotion thread. Woken up when the hot tier goes above
+  * the high watermark.
+  */
+void TieredBackend::demotion_loop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (!terminate) {
+        demotion_cv.wait(guard, [this] {
+            return terminate || counters.hot_bytes > high_watermark ||
+                room_wanted;
+        });
+        room_wanted = false;
+
+        uint64_t demoted = 0;
+        while (!terminate && counters.hot_bytes > low_watermark &&
+               demote_one(&guard)) {
+            demoted++;
+            room_cv.notify_all();
+        }
+        // Writes waiting for room give up if none was made
+        room_cv.notify_all();
+        LOG<INFO>("Demoted ", demoted, " objects to the cold tier");
+    }
+}
+
+bool TieredBackend::put(uint64_t oid, const MemSlice& data) {
+    uint64_t old_size;
+    return upsert(oid, data, &old_size);
+}
+
+bool TieredBackend::exists(uint64_t oid) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return index.find(oid) != index.end();
+}
+
+MemSlice TieredBackend::get(uint64_t oid) const {
+    LookupResult result = lookup(oid);
+    if (!result.found) {
+        throw std::runtime_error(
+                "TieredBackend get() called on nonexistent id");
+    }
+
+    return result.data;
+}
+
+bool TieredBackend::delet(uint64_t oid) {
+    uint64_t old_size;
+    return erase(oid, &old_size);
+}
+
+uint64_t TieredBackend::size(uint64_t oid) const {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(oid);
+    if (it == index.end()) {
+        return 0;
+    }
+
+    return it->second.size;
+}
+
+/**
+  * Reads an object. Objects of the cold tier are read without the lock and
+  * promoted if they did not change in the meantime and fit in the hot tier.
+  */
+StorageBackend::LookupResult TieredBackend::lookup(uint64_t oid) const {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        auto it = index.find(oid);
+        if (it == index.end()) {
+            return {false, MemSlice()};
+        }
+
+        Entry& entry = it->second;
+        if (entry.hot) {
+            lru.splice(lru.begin(), lru, entry.lru);
+            return {true, hot->get(oid)};
+        }
+
+        uint64_t version = entry.version;
+        uint64_t size = entry.size;
+        guard.unlock();
+        LookupResult result = cold->lookup(oid);
+        guard.lock();
+
+        it = index.find(oid);
+        if (it == index.end() || it->second.version != version) {
+            // Written, erased or promoted by someone else during the read
+            if (result.found) {
+                return result;
+            }
+            continue;
+        }
+        if (!result.found) {
+            LOG<ERROR>("Cold tier lost object ", oid);
+            return {false, MemSlice()};
+        }
+
+        // The demotion thread makes room if needed, as for writes
+        if (!make_room(oid, size, &guard)) {
+            return result;
+        }
+        it = index.find(oid);
+        if (it == index.end() || it->second.version != version ||
+            !hot->put(oid, result.data)) {
+            return result;
+        }
+
+        Entry& promoted = it->second;
+        promoted.hot = true;
+        promoted.lru = lru.insert(lru.begin(), oid);
+        promoted.version = ++last_version;
+        counters.cold_objects--;
+        counters.cold_bytes -= size;
+        counters.hot_objects++;
+        counters.hot_bytes += size;
+        counters.promotions++;
+        if (counters.hot_bytes > high_watermark) {
+            demotion_cv.notify_one();
+        }
+        delete_cold(oid, &guard);
+        return result;
+    }
+}
+
+bool TieredBackend::upsert(uint64_t oid, const MemSlice& data,
+        uint64_t* old_size) {
+    std::unique_lock<std::mutex> guard(lock);
+    // The demotion thread is behind, wait for it to make room
+    make_room(oid, data.size(), &guard);
+    if (demoting && demoting_oid == oid) {
+        demotion_cancelled = true;
+    }
+
+    uint64_t hot_old_size;
+    if (!hot->upsert(oid, data, &hot_old_size)) {
+        return false;
+    }
+
+    auto res = index.emplace(oid, Entry());
+    Entry& entry = res.first->second;
+    bool was_cold = !res.second && !entry.hot;
+    if (res.second) {
+        *old_size = 0;
+    } else if (entry.hot) {
+        *old_size = entry.size;
+        counters.hot_objects--;
+        counters.hot_bytes -= entry.size;
+        lru.erase(entry.lru);
+    } else {
+        *old_size = entry.size;
+        counters.cold_objects--;
+        counters.cold_bytes -= entry.size;
+    }
+
+    entry.size = data.size();
+    entry.hot = true;
+    entry.lru = lru.insert(lru.begin(), oid);
+    entry.version = ++last_version;
+    counters.hot_objects++;
+    counters.hot_bytes += entry.size;
+    if (counters.hot_bytes > high_watermark) {
+        demotion_cv.notify_one();
+    }
+    if (was_cold) {
+        // The old copy is deleted after the index is updated
+        delete_cold(oid, &guard);
+    }
+    return true;
+}
+
+bool TieredBackend::erase(uint64_t oid, uint64_t* old_size) {
+    std::unique_lock<std::mutex> guard(lock);
+    auto it = index.find(oid);
+    if (it == index.end()) {
+        return false;
+    }
+
+    Entry& entry = it->second;
+    *old_size = entry.size;
+    if (demoting && demoting_oid == oid) {
+        demotion_cancelled = true;
+    }
+    if (entry.hot) {
+        hot->delet(oid);
+        lru.erase(entry.lru);
+        counters.hot_objects--;
+        counters.hot_bytes -= entry.size;
+        index.erase(it);
+    } else {
+        counters.cold_objects--;
+        counters.cold_bytes -= entry.size;
+        index.erase(it);
+        delete_cold(oid, &guard);
+    }
+    return true;
+}
+
+bool TieredBackend::list_range(uint64_t first, uint64_t last,
+        std::vector<uint64_t>* oids) const {
+    std::lock_guard<std::mutex> guard(lock);
+    list_index_range(index, first, last, oids);
+    return true;
+}
+
+/**
+  * Reports the memory of both tiers. A tier that does not track its memory
+  * counts the bytes of its objects.
+  */
+bool TieredBackend::memory_stats(MemoryStats* stats) const {
+    Stats tiers = this->stats();
+    MemoryStats hot_stats = {tiers.hot_bytes, tiers.hot_bytes, 0};
+    MemoryStats cold_stats = {tiers.cold_bytes, tiers.cold_bytes, 0};
+    hot->memory_stats(&hot_stats);
+    cold->memory_stats(&cold_stats);
+
+    stats->bytes_used = hot_stats.bytes_used + cold_stats.bytes_used;
+    stats->bytes_requested = tiers.hot_bytes + tiers.cold_bytes;
+    stats->fragmentation = stats->bytes_used == 0 ? 0 :
+        1 - static_cast<double>(stats->bytes_requested) / stats->bytes_used;
+    return true;
+}
+
+TieredBackend::Stats TieredBackend::stats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+}
+
+}  // namespace cirrus
@@ -0,0 +1,144 @@
+#ifndef SRC_SERVER_TIEREDBACKEND_H_
+#define SRC_SERVER_TIEREDBACKEND_H_
+
+#include "StorageBackend.h"
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace cirrus {
+
+/**
+  * Key-value store made of a fast (hot) tier, usually memory, in front of
+  * a large (cold) tier, usually disk.
+  * Objects are written to the hot tier. When the hot tier goes above
+  * the high watermark, a background thread demotes the least recently used
+  * objects to the cold tier until it is back under the low watermark.
+  * Objects read from the cold tier are promoted back to the hot tier, if
+  * they fit in it. A write that does not fit in the hot tier waits for the
+  * background thread to make room, so the cold tier is never written by
+  * requests.
+  * The cold tier is only used without the lock, so that requests on the
+  * hot tier do not wait for its I/O.
+  * On init() the objects of the cold tier are indexed again, the objects
+  * of the hot tier are lost if it is not persistent.
+  */
+class TieredBackend : public StorageBackend {
+ public:
+    /** Usage of the tiers. */
+    struct Stats {
+        uint64_t hot_objects;   //< number of objects in the hot tier
+        uint64_t hot_bytes;     //< bytes of the objects in the hot tier
+        uint64_t cold_objects;  //< number of objects in the cold tier
+        uint64_t cold_bytes;    //< bytes of the objects in the cold tier
+        uint64_t demotions;     //< objects moved to the cold tier
+        uint64_t promotions;    //< objects moved to the hot tier
+    };
+
+    /**
+      * Constructor.
+      * @param hot the hot tier
+      * @param cold the cold tier
+      * @param capacity bytes of objects the hot tier can hold
+      * @param high_watermark fraction of capacity above which objects
+      * are demoted in the background
+      * @param low_watermark fraction of capacity background demotions
+      * bring the hot tier down to
+      */
+    TieredBackend(std::unique_ptr<StorageBackend> hot,
+            std::unique_ptr<StorageBackend> cold, uint64_t capacity,
+            double high_watermark = 0.9, double low_watermark = 0.7);
+    virtual ~TieredBackend();
+
+    void init() override;
+    bool put(uint64_t oid, const MemSlice& data) override;
+    bool exists(uint64_t oid) const override;
+    MemSlice get(uint64_t oid) const override;
+    bool delet(uint64_t oid) override;
+    uint64_t size(uint64_t oid) const override;
+    LookupResult lookup(uint64_t oid) const override;
+    bool upsert(uint64_t oid, const MemSlice& data,
+            uint64_t* old_size) override;
+    bool erase(uint64_t oid, uint64_t* old_size) override;
+    bool list_range(uint64_t first, uint64_t last,
+            std::vector<uint64_t>* oids) const override;
+    bool memory_stats(MemoryStats* stats) const override;
+
+    /**
+      * Get the usage of the tiers
+      * @return Stats
+      */
+    Stats stats() const;
+
+ private:
+    /** Where an object is. */
+    struct Entry {
+        uint64_t size;
+        bool hot;
+        /** Position in lru, if hot. */
+        std::list<uint64_t>::iterator lru;
+        /**
+          * Changed whenever the object is written or moves, so that work
+          * done without the lock is only committed if the object is the
+          * same.
+          */
+        uint64_t version;
+    };
+
+    bool demote_one(std::unique_lock<std::mutex>* guard);
+    void demotion_loop();
+    bool make_room(uint64_t oid, uint64_t size,
+            std::unique_lock<std::mutex>* guard) const;
+    void delete_cold(uint64_t oid, std::unique_lock<std::mutex>* guard) const;
+
+    std::unique_ptr<StorageBackend> hot;
+    std::unique_ptr<StorageBackend> cold;
+
+    const uint64_t capacity;
+    const uint64_t high_watermark;  //< in bytes
+    const uint64_t low_watermark;   //< in bytes
+
+    // lookup() promotes objects, so it changes the index
+    mutable std::unordered_map<uint64_t, Entry> index;
+    /** Ids of the objects in the hot tier, most recently used first. */
+    mutable std::list<uint64_t> lru;
+    mutable Stats counters = {0, 0, 0, 0, 0, 0};
+    /** Last version given to an entry. */
+    mutable uint64_t last_version = 0;
+    /**
+      * Objects being deleted from the cold tier, with the number of
+      * deletes. They are not demoted until the deletes are done.
+      */
+    mutable std::unordered_map<uint64_t, uint64_t> cold_deletes;
+
+    /**
+      * Protects the index, the hot tier and the state of the cold tier.
+      * The cold tier is used without it: demotions copy the object while it
+      * stays in the hot tier, promotions read it while it stays in the cold
+      * tier, and both commit only if the object did not change.
+      */
+    mutable std::mutex lock;
+
+    /** Whether an object is being copied to the cold tier. */
+    bool demoting = false;
+    /** Id of the object being copied to the cold tier. */
+    uint64_t demoting_oid = 0;
+    /** Whether the object was written or erased during its copy. */
+    bool demotion_cancelled = false;
+    /** Whether a write or promotion waits for room in the hot tier. */
+    mutable bool room_wanted = false;
+
+    std::thread demoter;
+    std::atomic<bool> terminate = {false};
+    mutable std::condition_variable demotion_cv;
+    /** Signaled when demotions make room in the hot tier. */
+    mutable std::condition_variable room_cv;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_TIEREDBACKEND_H_
@@ -0,0 +1,68 @@
+#include "server/TimingWheel.h"
+
+#include <algorithm>
+
+namespace cirrus {
+
+TimingWheel::TimingWheel(uint64_t tick_ms, uint64_t num_slots) :
+    tick_ms(tick_ms), slots(num_slots) {}
+
+void TimingWheel::schedule(uint64_t oid, uint64_t deadline_ms) {
+    // Rounded up, so that objects never expire early. Deadlines already
+    // passed expire on the next tick
+    uint64_t tick = std::max(current_tick,
+            (deadline_ms + tick_ms - 1) / tick_ms);
+    deadlines[oid] = tick;
+    slots[tick % slots.size()].push_back({oid, tick});
+}
+
+void TimingWheel::cancel(uint64_t oid) {
+    deadlines.erase(oid);
+}
+
+void TimingWheel::advance(uint64_t now_ms, uint64_t max,
+        std::vector<uint64_t>* expired) {
+    uint64_t now_tick = now_ms / tick_ms;
+    uint64_t limit = expired->size() + max;
+    while (current_tick <= now_tick) {
+        if (deadlines.empty()) {
+            // Nothing to expire, the slots only hold stale entries
+            for (auto& slot : slots) {
+                slot.clear();
+            }
+            current_tick = now_tick + 1;
+            return;
+        }
+
+        auto& slot = slots[current_tick % slots.size()];
+        uint64_t kept = 0;
+        uint64_t i = 0;
+        for (; i < slot.size() && expired->size() < limit; ++i) {
+            const Entry& entry = slot[i];
+            auto it = deadlines.find(entry.oid);
+            if (it == deadlines.end() || it->second != entry.tick) {
+                // Cancelled or rescheduled
+                continue;
+            }
+            if (entry.tick > current_tick) {
+                // Due on a later revolution
+                slot[kept++] = entry;
+                continue;
+            }
+            expired->push_back(entry.oid);
+            deadlines.erase(it);
+        }
+        // Entries not looked at are kept for the next call
+        for (; i < slot.size(); ++i) {
+            slot[kept++] = slot[i];
+        }
+        slot.resize(kept);
+
+        if (expired->size() >= limit) {
+            return;
+        }
+        ++current_tick;
+    }
+}
+
+}  // namespace cirrus
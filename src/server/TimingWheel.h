@@ -0,0 +1,77 @@
+#ifndef SRC_SERVER_TIMINGWHEEL_H_
+#define SRC_SERVER_TIMINGWHEEL_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace cirrus {
+
+/**
+  * Deadlines of objects, kept in a hashed timing wheel. Time is split in
+  * ticks and every tick maps to a slot of the wheel, so scheduling and
+  * expiring an object take constant time, without scanning every
+  * deadline. Deadlines further than a revolution of the wheel stay in
+  * their slot until their tick comes.
+  * Cancelled or rescheduled deadlines are dropped lazily, when their slot
+  * comes up.
+  * Not thread safe.
+  */
+class TimingWheel {
+ public:
+    /**
+      * Constructor.
+      * @param tick_ms length of a tick, in milliseconds. Objects expire
+      * up to a tick after their deadline
+      * @param num_slots number of slots of the wheel
+      */
+    TimingWheel(uint64_t tick_ms, uint64_t num_slots);
+
+    /**
+      * Sets the deadline of an object, replacing its previous one.
+      * @param oid the id of the object
+      * @param deadline_ms the deadline, in milliseconds since the time the
+      * wheel was created with
+      */
+    void schedule(uint64_t oid, uint64_t deadline_ms);
+
+    /**
+      * Clears the deadline of an object, if any.
+      * @param oid the id of the object
+      */
+    void cancel(uint64_t oid);
+
+    /**
+      * Moves the wheel up to a time and collects the objects whose deadline
+      * passed. Their deadlines are cleared.
+      * @param now_ms the time, in milliseconds
+      * @param max the most objects collected. The wheel stops at the
+      * first tick with more, to be resumed by the next call
+      * @param expired where the ids of the objects are appended
+      */
+    void advance(uint64_t now_ms, uint64_t max,
+            std::vector<uint64_t>* expired);
+
+    /** Whether no object has a deadline. */
+    bool empty() const {
+        return deadlines.empty();
+    }
+
+ private:
+    struct Entry {
+        uint64_t oid;
+        uint64_t tick;
+    };
+
+    uint64_t tick_ms;
+    /** Entries of every slot, the slot of a tick is tick % slots.size(). */
+    std::vector<std::vector<Entry>> slots;
+    /** Tick of the deadline of every object. */
+    std::unordered_map<uint64_t, uint64_t> deadlines;
+    /** Next tick to expire. */
+    uint64_t current_tick = 0;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_TIMINGWHEEL_H_
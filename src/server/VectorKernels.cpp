@@ -0,0 +1,46 @@
+#include "server/VectorKernels.h"
+
+#include <cstring>
+
+namespace cirrus {
+
+// Elements are loaded and stored with memcpy, which the compiler turns
+// into unaligned vector loads and stores
+
+__attribute__((target_clones("avx2", "default")))
+void add_uint64(char* __restrict dst, const char* __restrict src,
+        uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t a, b;
+        std::memcpy(&a, dst + i * sizeof(a), sizeof(a));
+        std::memcpy(&b, src + i * sizeof(b), sizeof(b));
+        a += b;
+        std::memcpy(dst + i * sizeof(a), &a, sizeof(a));
+    }
+}
+
+__attribute__((target_clones("avx2", "default")))
+void axpy_double(char* __restrict dst, const char* __restrict src,
+        double scale, uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+        double a, b;
+        std::memcpy(&a, dst + i * sizeof(a), sizeof(a));
+        std::memcpy(&b, src + i * sizeof(b), sizeof(b));
+        a += scale * b;
+        std::memcpy(dst + i * sizeof(a), &a, sizeof(a));
+    }
+}
+
+__attribute__((target_clones("avx2", "default")))
+void axpy_float(char* __restrict dst, const char* __restrict src,
+        float scale, uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+        float a, b;
+        std::memcpy(&a, dst + i * sizeof(a), sizeof(a));
+        std::memcpy(&b, src + i * sizeof(b), sizeof(b));
+        a += scale * b;
+        std::memcpy(dst + i * sizeof(a), &a, sizeof(a));
+    }
+}
+
+}  // namespace cirrus
@@ -0,0 +1,44 @@
+#ifndef SRC_SERVER_VECTORKERNELS_H_
+#define SRC_SERVER_VECTORKERNELS_H_
+
+#include <cstdint>
+
+namespace cirrus {
+
+/**
+  * Element-wise operations on the vectors stored in objects, used by the
+  * server's atomic operations. Objects and operands are not aligned, so
+  * the kernels take raw bytes. They are built for AVX2 as well, picked at
+  * load time on CPUs that have it.
+  * dst and src must not overlap.
+  */
+
+/**
+  * dst[i] += src[i], on 64 bit unsigned integers. Wraps around.
+  * @param dst the vector updated
+  * @param src the vector added
+  * @param n the number of elements
+  */
+void add_uint64(char* dst, const char* src, uint64_t n);
+
+/**
+  * dst[i] += scale * src[i], on doubles.
+  * @param dst the vector updated
+  * @param src the vector added
+  * @param scale the factor src is multiplied by
+  * @param n the number of elements
+  */
+void axpy_double(char* dst, const char* src, double scale, uint64_t n);
+
+/**
+  * dst[i] += scale * src[i], on floats.
+  * @param dst the vector updated
+  * @param src the vector added
+  * @param scale the factor src is multiplied by
+  * @param n the number of elements
+  */
+void axpy_float(char* dst, const char* src, float scale, uint64_t n);
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_VECTORKERNELS_H_
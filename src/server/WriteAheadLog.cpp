@@ -0,0 +1,286 @@
+#include "server/WriteAheadLog.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cinttypes>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "utils/Crc32.h"
+#include "utils/logging.h"
+
+namespace cirrus {
+
+static const uint32_t record_magic = 0x4c415743;  // "CWAL"
+static const char file_prefix[] = "memory.wal.";
+
+WriteAheadLog::WriteAheadLog(const std::string& path) : path(path) {}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (fd >= 0) {
+        write_pending();
+        close(fd);
+    }
+}
+
+std::string WriteAheadLog::file(uint64_t generation) const {
+    return path + "/" + file_prefix + std::to_string(generation);
+}
+
+/**
+  * Lists the generations found in the log directory.
+  * @return the generations, oldest first
+  */
+std::vector<uint64_t> WriteAheadLog::generations() const {
+    std::vector<uint64_t> result;
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        throw std::runtime_error("Error opening log directory " + path);
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        uint64_t gen;
+        int consumed = 0;
+        if (sscanf(entry->d_name, "memory.wal.%" SCNu64 "%n",
+                    &gen, &consumed) == 1 &&
+            entry->d_name[consumed] == '\0') {
+            result.push_back(gen);
+        }
+    }
+    closedir(dir);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/**
+  * Creates the file of the current generation. The directory is synced,
+  * so that the file is still there after a crash.
+  */
+void WriteAheadLog::create_generation() {
+    fd = ::open(file(generation).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Error creating log " + file(generation));
+    }
+    int dir_fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0 || fsync(dir_fd) != 0) {
+        if (dir_fd >= 0) {
+            close(dir_fd);
+        }
+        throw std::runtime_error("Error syncing log directory " + path);
+    }
+    close(dir_fd);
+}
+
+void WriteAheadLog::open(const ReplayFunction& apply) {
+    auto gens = generations();
+    for (const auto& gen : gens) {
+        replay(gen, apply);
+    }
+
+    // A crash may have left a partial record at the end of the last
+    // generation, so appends always go to a new one
+    generation = gens.empty() ? 0 : gens.back() + 1;
+    create_generation();
+}
+
+/**
+  * Computes the CRC of a record.
+  * @param header the header of the record, its crc is ignored
+  * @param data the data of the record, header.size bytes
+  * @return the CRC
+  */
+uint32_t WriteAheadLog::checksum(RecordHeader header, const char* data) {
+    header.crc = 0;
+    uint32_t crc = crc32c(&header, sizeof(header));
+    return crc32c(data, header.size, crc);
+}
+
+/**
+  * Replays the records of a generation. Stops at the first record that is
+  * not complete or is corrupted.
+  */
+void WriteAheadLog::replay(uint64_t gen, const ReplayFunction& apply) const {
+    std::string name = file(gen);
+    int log_fd = ::open(name.c_str(), O_RDONLY);
+    if (log_fd < 0) {
+        throw std::runtime_error("Error opening log " + name);
+    }
+    struct stat st;
+    if (fstat(log_fd, &st) != 0) {
+        close(log_fd);
+        throw std::runtime_error("Error reading log " + name);
+    }
+    uint64_t size = st.st_size;
+    if (size == 0) {
+        close(log_fd);
+        return;
+    }
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, log_fd, 0);
+    close(log_fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Error mapping log " + name);
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const char* base = static_cast<const char*>(map);
+    uint64_t offset = 0;
+    uint64_t count = 0;
+    while (size - offset >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        std::memcpy(&header, base + offset, sizeof(header));
+        offset += sizeof(header);
+        if (header.magic != record_magic || header.size > size - offset) {
+            LOG<ERROR>("Log ", name, " ends with a partial record");
+            break;
+        }
+        if (header.crc != checksum(header, base + offset)) {
+            LOG<ERROR>("Log ", name, " has a corrupted record after ",
+                    count, " records, the rest is ignored");
+            break;
+        }
+
+        if (header.type == kPut) {
+            MemSlice data(base + offset, base + offset + header.size);
+            apply(header.oid, &data);
+        } else {
+            apply(header.oid, nullptr);
+        }
+        offset += header.size;
+        count++;
+    }
+    munmap(map, size);
+    LOG<INFO>("Replayed ", count, " records from ", name);
+}
+
+uint64_t WriteAheadLog::append_put(uint64_t oid, const MemSlice& data) {
+    return append({{record_magic, kPut, oid, data.size(), 0, 0}, data});
+}
+
+uint64_t WriteAheadLog::append_remove(uint64_t oid) {
+    return append({{record_magic, kRemove, oid, 0, 0, 0}, MemSlice()});
+}
+
+uint64_t WriteAheadLog::append(const Record& record) {
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_back(record);
+    generation_bytes += sizeof(RecordHeader) + record.header.size;
+    return ++appended;
+}
+
+/**
+  * Writes records to a log file, without syncing it. The CRC of the
+  * records is computed here, outside the lock of the log.
+  * @return false if the file could not be written
+  */
+bool WriteAheadLog::write(int log_fd, std::vector<Record>* records) const {
+    struct iovec iov[IOV_MAX];
+    uint64_t next = 0;
+    while (next < records->size()) {
+        int iovcnt = 0;
+        uint64_t total = 0;
+        for (; next < records->size() && iovcnt + 2 <= IOV_MAX; ++next) {
+            Record& record = (*records)[next];
+            record.header.crc = checksum(record.header, record.data.data());
+            iov[iovcnt].iov_base = &record.header;
+            iov[iovcnt].iov_len = sizeof(RecordHeader);
+            iovcnt++;
+            if (record.data.size() > 0) {
+                iov[iovcnt].iov_base = const_cast<char*>(record.data.data());
+                iov[iovcnt].iov_len = record.data.size();
+                iovcnt++;
+            }
+            total += sizeof(RecordHeader) + record.data.size();
+        }
+
+        // Short writes only happen on errors such as a full disk
+        ssize_t written = writev(log_fd, iov, iovcnt);
+        if (written != static_cast<ssize_t>(total)) {
+            LOG<ERROR>("Error writing log: ", strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WriteAheadLog::sync(uint64_t lsn) {
+    if (durable >= lsn) {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    while (durable < lsn && !failed) {
+        if (syncing) {
+            // The sync in progress may not cover lsn, check again after it
+            sync_cv.wait(guard);
+            continue;
+        }
+
+        // Write everything appended so far
+        syncing = true;
+        std::vector<Record> batch;
+        batch.swap(pending);
+        uint64_t batch_lsn = appended;
+        guard.unlock();
+
+        bool ok = write(fd, &batch) && fdatasync(fd) == 0;
+
+        guard.lock();
+        syncing = false;
+        if (ok) {
+            durable = batch_lsn;
+        } else {
+            failed = true;
+        }
+        sync_cv.notify_all();
+    }
+    return !failed;
+}
+
+/**
+  * Writes and syncs the records appended so far.
+  * Must be called with lock held and no sync in progress.
+  */
+bool WriteAheadLog::write_pending() {
+    bool ok = !failed && write(fd, &pending) && fdatasync(fd) == 0;
+    if (ok) {
+        durable = appended;
+    } else {
+        failed = true;
+    }
+    pending.clear();
+    return ok;
+}
+
+uint64_t WriteAheadLog::rotate() {
+    std::unique_lock<std::mutex> guard(lock);
+    sync_cv.wait(guard, [this] { return !syncing; });
+    if (!write_pending()) {
+        throw std::runtime_error("Error writing log " + file(generation));
+    }
+    close(fd);
+
+    generation++;
+    generation_bytes = 0;
+    try {
+        create_generation();
+    } catch (const std::runtime_error&) {
+        failed = true;
+        throw;
+    }
+    return generation - 1;
+}
+
+void WriteAheadLog::remove_until(uint64_t last) {
+    for (const auto& gen : generations()) {
+        if (gen <= last) {
+            unlink(file(gen).c_str());
+        }
+    }
+}
+
+}  // namespace cirrus
@@ -0,0 +1,160 @@
+#ifndef SRC_SERVER_WRITEAHEADLOG_H_
+#define SRC_SERVER_WRITEAHEADLOG_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "flatbuffers/flatbuffers.h"
+#include "server/MemSlice.h"
+
+namespace cirrus {
+
+/**
+  * Log of the writes and removes applied to a backend, used to recover
+  * them after a restart.
+  * Records are appended in memory and written out by sync(), which makes
+  * every record appended so far durable with a single fdatasync(). Threads
+  * calling sync() while another one is syncing wait for it and are
+  * covered by the next sync (group commit).
+  * The log is a sequence of files, called generations. rotate() starts a
+  * new generation, so that older ones can be removed once a snapshot
+  * covers them.
+  * Every record carries a CRC, computed when it is written rather than
+  * when it is appended. Replay stops at the first record of a generation
+  * that is partial or whose CRC does not match.
+  */
+class WriteAheadLog {
+ public:
+    /**
+      * Called for every record replayed.
+      * @param oid the id of the object
+      * @param data the data written, nullptr for a remove
+      */
+    using ReplayFunction =
+        std::function<void(uint64_t oid, const MemSlice* data)>;
+
+    /**
+      * Constructor.
+      * @param path directory of the log files
+      */
+    explicit WriteAheadLog(const std::string& path);
+    ~WriteAheadLog();
+
+    /**
+      * Replays the records of the existing generations, oldest first,
+      * and starts a new generation.
+      * @param apply function called for every record
+      */
+    void open(const ReplayFunction& apply);
+
+    /**
+      * Appends a write.
+      * @param oid the id of the object
+      * @param data the data of the object. It must not change until
+      * the record is synced
+      * @return the sequence number of the record
+      */
+    uint64_t append_put(uint64_t oid, const MemSlice& data);
+
+    /**
+      * Appends a remove.
+      * @param oid the id of the object
+      * @return the sequence number of the record
+      */
+    uint64_t append_remove(uint64_t oid);
+
+    /**
+      * Makes records durable.
+      * @param lsn sequence number of the last record that must be durable
+      * @return false if the log could not be written
+      */
+    bool sync(uint64_t lsn);
+
+    /**
+      * @return sequence number up to which records are durable
+      */
+    uint64_t durable_lsn() const {
+        return durable;
+    }
+
+    /**
+      * @return bytes of the records appended to the current generation
+      */
+    uint64_t generation_size() const {
+        return generation_bytes;
+    }
+
+    /**
+      * Syncs the records appended so far and starts a new generation.
+      * @return the generation that was ended
+      */
+    uint64_t rotate();
+
+    /**
+      * Removes generations that are no longer needed.
+      * @param generation the last generation to remove
+      */
+    void remove_until(uint64_t generation);
+
+ private:
+    /** Header of every record. The data of a write follows it. */
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t type;  //< kPut or kRemove
+        uint64_t oid;
+        uint64_t size;  //< size of the data
+        /** CRC-32C of the header, with crc set to 0, and of the data. */
+        uint32_t crc;
+        uint32_t padding;
+    };
+
+    enum RecordType : uint32_t {
+        kPut = 1,
+        kRemove = 2
+    };
+
+    /** Record appended but not written yet. */
+    struct Record {
+        RecordHeader header;
+        MemSlice data;
+    };
+
+    std::string file(uint64_t generation) const;
+    std::vector<uint64_t> generations() const;
+    void create_generation();
+    void replay(uint64_t generation, const ReplayFunction& apply) const;
+    uint64_t append(const Record& record);
+    static uint32_t checksum(RecordHeader header, const char* data);
+    bool write(int log_fd, std::vector<Record>* records) const;
+    bool write_pending();
+
+    std::string path;
+
+    /** File of the current generation. */
+    int fd = -1;
+    uint64_t generation = 0;
+
+    /** Records appended but not written yet. */
+    std::vector<Record> pending;
+    /** Sequence number of the last record appended. */
+    uint64_t appended = 0;
+    /** Sequence number of the last record durable. */
+    std::atomic<uint64_t> durable = {0};
+    /** Bytes of the records appended to the current generation. */
+    std::atomic<uint64_t> generation_bytes = {0};
+    /** Whether a thread is writing records. */
+    bool syncing = false;
+    /** Whether writing the log failed. */
+    bool failed = false;
+
+    std::mutex lock;
+    std::condition_variable sync_cv;
+};
+
+}  // namespace cirrus
+
+#endif  // SRC_SERVER_WRITEAHEADLOG_H_
@@ -0,0 +1,40 @@
+#include "utils/Crc32.h"
+
+#include <array>
+
+namespace cirrus {
+
+namespace {
+
+/** Reversed polynomial of CRC-32C. */
+const uint32_t crc32c_poly = 0x82f63b78;
+
+/** CRC of every byte value, built on first use. */
+const std::array<uint32_t, 256>& crc32c_table() {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (crc & 1 ? crc32c_poly : 0);
+            }
+            t[i] = crc;
+        }
+        return t;
+    }();
+    return table;
+}
+
+}  // namespace
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+    const auto& table = crc32c_table();
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+}  // namespace cirrus
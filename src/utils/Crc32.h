@@ -0,0 +1,21 @@
+#ifndef SRC_UTILS_CRC32_H_
+#define SRC_UTILS_CRC32_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cirrus {
+
+/**
+  * Computes the CRC-32C (Castagnoli) of a buffer. Calls can be chained to
+  * compute the CRC of several buffers as if they were one.
+  * @param data the buffer
+  * @param size the size of the buffer
+  * @param crc the CRC of the buffers before this one, 0 if none
+  * @return the CRC of the buffers so far
+  */
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+}  // namespace cirrus
+
+#endif  // SRC_UTILS_CRC32_H_
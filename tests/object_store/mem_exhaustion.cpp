@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 
 #include "object_store/FullBladeObjectStore.h"
@@ -12,6 +13,7 @@ const char PORT[] = "12345";
 const char *IP;
 static const uint32_t SIZE = 1024*1024;  // One MB
 static const uint64_t MILLION = 1000000;
+static const uint64_t HUNDRED = 100;
 bool use_rdma_client;
 
 /**
@@ -73,11 +75,70 @@ void test_exhaustion_remove() {
     store.put(i, d);
 }
 
-auto main(int argc, char *argv[]) -> int {
-    std::cout << "Runing exhaustion test" << std::endl;
+/**
+ * This test ensures that a server running as a cache evicts objects to
+ * make room instead of failing writes when it is full, and that it
+ * reports the evictions in its statistics.
+ * This test assumes that the server does not have enough room to store
+ * one hundred objects of one MB each.
+ */
+void test_eviction() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<cirrus::Dummy<SIZE>> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<cirrus::Dummy<SIZE>>
+        store(IP, PORT, client.get(),
+                serializer,
+                cirrus::deserializer_simple<cirrus::Dummy<SIZE>,
+                    sizeof(cirrus::Dummy<SIZE>)>);
 
+    std::cout << "Putting one hundred objects" << std::endl;
+    for (uint64_t i = 0; i < HUNDRED; ++i) {
+        struct cirrus::Dummy<SIZE> d(i);
+        store.put(i, d);
+    }
+
+    // The last object written is the most recently used
+    if (store.get(HUNDRED - 1).id != static_cast<int>(HUNDRED - 1)) {
+        throw std::runtime_error("Wrong value read");
+    }
+
+    // The first object written is the least recently used
+    bool evicted = false;
+    try {
+        store.get(0);
+    } catch (const cirrus::NoSuchIDException& e) {
+        evicted = true;
+    }
+    if (!evicted) {
+        throw std::runtime_error("Object was not evicted");
+    }
+
+    cirrus::CacheStats stats = client->cache_stats_async().getCacheStats();
+    std::cout << "Hits: " << stats.hits << " misses: " << stats.misses
+        << " evictions: " << stats.evictions << std::endl;
+    if (stats.hits != 1 || stats.misses != 1) {
+        throw std::runtime_error("Wrong number of hits or misses");
+    }
+    if (stats.evictions == 0 || stats.evictions >= HUNDRED ||
+        stats.evicted_bytes < stats.evictions * SIZE) {
+        throw std::runtime_error("Wrong number of evictions");
+    }
+}
+
+auto main(int argc, char *argv[]) -> int {
     use_rdma_client = cirrus::test_internal::ParseMode(argc, argv);
     IP = cirrus::test_internal::ParseIP(argc, argv);
+
+    // The server runs as a cache: writes evict objects instead of failing
+    if (argc >= 4 && strcmp(argv[3], "--cache_mode=1") == 0) {
+        std::cout << "Runing cache mode test" << std::endl;
+        test_eviction();
+        std::cout << "Test successful" << std::endl;
+        return 0;
+    }
+
+    std::cout << "Runing exhaustion test" << std::endl;
     test_exhaustion_remove();
     try {
         test_exhaustion();
@@ -578,6 +578,54 @@ void test_cache_put_local_copy() {
     }
 }
 
+/**
+ * This test ensures that a cache subscribed to the store drops the objects
+ * other clients write or remove.
+ */
+void test_invalidation() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    std::unique_ptr<cirrus::BladeClient> other_client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<int> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT, client.get(),
+            serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+    cirrus::ostore::FullBladeObjectStoreTempl<int> other_store(IP, PORT,
+            other_client.get(), serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+
+    cirrus::LRAddedEvictionPolicy policy(10);
+    cirrus::CacheManager<int> cm(&store, &policy, 10);
+    cm.subscribe(0, 9);
+    cm.put(5, 1);
+    if (cm.get(5) != 1) {
+        throw std::runtime_error("Wrong value after put");
+    }
+
+    // Invalidations arrive asynchronously
+    other_store.put(5, 2);
+    int ret = cm.get(5);
+    for (int i = 0; i < 500 && ret != 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ret = cm.get(5);
+    }
+    if (ret != 2) {
+        throw std::runtime_error("Cached object was not invalidated");
+    }
+
+    other_store.remove(5);
+    for (int i = 0; i < 500; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        try {
+            cm.get(5);
+        } catch (const cirrus::NoSuchIDException& e) {
+            return;
+        }
+    }
+    throw std::runtime_error("Removed object was not invalidated");
+}
+
 auto main(int argc, char *argv[]) -> int {
     use_rdma_client = cirrus::test_internal::ParseMode(argc, argv);
     IP = cirrus::test_internal::ParseIP(argc, argv);
@@ -635,6 +683,10 @@ auto main(int argc, char *argv[]) -> int {
     test_deferred_writes();
     test_linear_prefetch();
     test_custom_prefetch();
+    // The RDMA client has no subscriptions
+    if (!use_rdma_client) {
+        test_invalidation();
+    }
     std::cout << "Test successful" << std::endl;
     return 0;
 }
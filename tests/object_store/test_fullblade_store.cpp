@@ -3,9 +3,12 @@
 #include <algorithm>
 #include <cstdint>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <cctype>
 #include <memory>
+#include <thread>
+#include <chrono>
 
 #include "object_store/FullBladeObjectStore.h"
 #include "tests/object_store/object_store_internal.h"
@@ -309,6 +312,59 @@ void test_remove_bulk() {
     }
 }
 
+/**
+ * Tests that removeBulk removes every object of a range much wider than
+ * the number of objects in it, and leaves the objects around it. The last
+ * range covers every id, it only completes if the backend finds the
+ * objects without probing every id. Also tests that reads of ranges that
+ * wide are rejected.
+ */
+void test_remove_bulk_sparse() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<int> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT, client.get(),
+            serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+    const cirrus::ObjectID first = 1000;
+    const cirrus::ObjectID last = 10000000;
+    std::vector<cirrus::ObjectID> oids = {first - 1, first, first + 7,
+        last / 2, last, last + 1};
+    for (const auto& oid : oids) {
+        store.put(oid, 42);
+    }
+
+    store.removeBulk(first, last);
+    for (const auto& oid : oids) {
+        bool removed = false;
+        try {
+            store.get(oid);
+        } catch (const cirrus::NoSuchIDException& e) {
+            removed = true;
+        }
+        if (removed != (oid >= first && oid <= last)) {
+            std::cout << "Wrong state of id " << oid << " after removeBulk"
+                << std::endl;
+            throw std::runtime_error("Wrong objects removed by removeBulk.");
+        }
+    }
+
+    try {
+        client->read_sync_range(0,
+                std::numeric_limits<cirrus::ObjectID>::max());
+        throw std::runtime_error("Read of every id did not throw");
+    } catch (const cirrus::InvalidArgumentException& e) {
+    }
+    store.removeBulk(0, std::numeric_limits<cirrus::ObjectID>::max());
+    for (const auto& oid : {first - 1, last + 1}) {
+        try {
+            store.get(oid);
+            throw std::runtime_error("Object left by removeBulk of every id");
+        } catch (const cirrus::NoSuchIDException& e) {
+        }
+    }
+}
+
 /**
  * This test tests the remove method. It ensures that you cannot "get"
  * an item if it has been removed from the store.
@@ -348,6 +404,273 @@ void test_variable_sizes() {
     }
 }
 
+/**
+ * Tests that partial puts and gets only touch the bytes given, and that
+ * they fail past the end of the object.
+ */
+void test_partial() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    SerializerVariableSimple serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT, client.get(),
+            serializer,
+            deserializer_variable_simple);
+
+    // Six 6s, the first three are then overwritten with 3s
+    store.put(1, 6);
+    store.put_partial(1, 0, 3);
+    if (store.get_partial(1, 0, 3 * sizeof(int)) != 3) {
+        throw std::runtime_error("Incorrect value returned");
+    }
+    auto ptr_pair = client->read_sync_partial(1, 3 * sizeof(int),
+            3 * sizeof(int));
+    const int* ints = reinterpret_cast<const int*>(ptr_pair.first.get());
+    if (ptr_pair.second != 3 * sizeof(int) ||
+        ints[0] != 6 || ints[1] != 6 || ints[2] != 6) {
+        throw std::runtime_error("Partial put changed other bytes");
+    }
+
+    try {
+        store.get_partial(1, 5 * sizeof(int), 2 * sizeof(int));
+        throw std::runtime_error("Read past the end of the object");
+    } catch (const cirrus::OutOfRangeException& e) {
+    }
+    try {
+        store.put_partial(1, 4 * sizeof(int), 3);
+        throw std::runtime_error("Write past the end of the object");
+    } catch (const cirrus::OutOfRangeException& e) {
+    }
+}
+
+/**
+ * Tests that get_if_newer only returns objects written since the version
+ * given, and that every put gives a newer version.
+ */
+void test_if_newer() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<int> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT, client.get(),
+            serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+
+    store.put(1, 7);
+    uint64_t version = 0;
+    int value = 0;
+    if (!store.get_if_newer(1, &version, &value) || value != 7) {
+        throw std::runtime_error("Object not returned on first read");
+    }
+    uint64_t first_version = version;
+    if (store.get_if_newer(1, &version, &value)) {
+        throw std::runtime_error("Object returned without being modified");
+    }
+
+    store.put(1, 8);
+    if (!store.get_if_newer(1, &version, &value) || value != 8 ||
+        version <= first_version) {
+        throw std::runtime_error("Modified object not returned");
+    }
+}
+
+/**
+ * Tests that a watch times out when nothing is written, and returns once
+ * another client writes one of the objects.
+ */
+void test_watch() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<int> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT, client.get(),
+            serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+
+    store.put(1, 1);
+    store.put(2, 2);
+    std::vector<cirrus::ObjectID> oids = {1, 2};
+    std::vector<uint64_t> versions(2, 0);
+    int value;
+    store.get_if_newer(1, &versions[0], &value);
+    store.get_if_newer(2, &versions[1], &value);
+
+    std::vector<bool> written = store.watch(oids, versions, 100);
+    if (written[0] || written[1]) {
+        throw std::runtime_error("Watch returned without a write");
+    }
+
+    std::thread writer([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::unique_ptr<cirrus::BladeClient> writer_client =
+            cirrus::test_internal::GetClient(use_rdma_client);
+        cirrus::serializer_simple<int> writer_serializer;
+        cirrus::ostore::FullBladeObjectStoreTempl<int> writer_store(IP, PORT,
+                writer_client.get(), writer_serializer,
+                cirrus::deserializer_simple<int, sizeof(int)>);
+        writer_store.put(2, 3);
+    });
+    written = store.watch(oids, versions, 10000);
+    writer.join();
+    if (written[0] || !written[1]) {
+        throw std::runtime_error("Watch did not return the object written");
+    }
+    if (!store.get_if_newer(2, &versions[1], &value) || value != 3) {
+        throw std::runtime_error("Incorrect value returned");
+    }
+}
+
+/**
+ * Tests that compare and swap only replaces objects that match, and that
+ * fetch add adds to counters and vectors of doubles.
+ */
+void test_atomics() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<int> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT, client.get(),
+            serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+
+    store.put(1, 5);
+    if (!store.compare_and_swap(1, 5, 6) || store.compare_and_swap(1, 5, 7) ||
+        store.get(1) != 6) {
+        throw std::runtime_error("Incorrect compare and swap");
+    }
+    uint64_t version = 0;
+    int value;
+    store.get_if_newer(1, &version, &value);
+    if (!store.compare_and_swap_version(1, version, 8) ||
+        store.compare_and_swap_version(1, version, 9) || store.get(1) != 8) {
+        throw std::runtime_error("Incorrect compare and swap of version");
+    }
+
+    // Counters start at 0
+    store.removeBulk(100, 101);
+    if (client->fetch_add(100, 3) != 0 || client->fetch_add(100, 4) != 3 ||
+        client->fetch_add(100, 0) != 7) {
+        throw std::runtime_error("Incorrect fetch add");
+    }
+    std::vector<double> operand = {1.5, -2};
+    client->fetch_add_async(101, operand, false).get();
+    client->fetch_add_async(101, operand, false).get();
+    auto ptr_pair = client->read_sync(101);
+    const double* sum = reinterpret_cast<const double*>(ptr_pair.first.get());
+    if (ptr_pair.second != 2 * sizeof(double) || sum[0] != 3 || sum[1] != -4) {
+        throw std::runtime_error("Incorrect fetch add of doubles");
+    }
+}
+
+/**
+ * Tests that gradients accumulated by several clients are summed on the
+ * server, scaled.
+ */
+void test_accumulate() {
+    const int num_clients = 4;
+    const cirrus::ObjectID oid = 200;
+    const uint64_t size = 1000;
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    client->connect(IP, PORT);
+    client->remove(oid);
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < num_clients; ++i) {
+        workers.emplace_back([i, oid, size]() {
+            std::unique_ptr<cirrus::BladeClient> worker_client =
+                cirrus::test_internal::GetClient(use_rdma_client);
+            worker_client->connect(IP, PORT);
+            std::vector<double> gradient(size, i + 1);
+            worker_client->accumulate_async(oid, gradient, 0.5).get();
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // 0.5 * (1 + 2 + 3 + 4)
+    auto ptr_pair = client->read_sync(oid);
+    const double* sum = reinterpret_cast<const double*>(ptr_pair.first.get());
+    if (ptr_pair.second != size * sizeof(double)) {
+        throw std::runtime_error("Incorrect size of accumulated vector");
+    }
+    for (uint64_t i = 0; i < size; ++i) {
+        if (sum[i] != 5) {
+            throw std::runtime_error("Incorrect accumulated value");
+        }
+    }
+}
+
+/**
+ * Tests that the memory statistics of the server, for backends that track
+ * their memory, account for the objects written.
+ */
+void test_memory_stats() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    SerializerVariableSimple serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT,
+            client.get(), serializer, deserializer_variable_simple);
+    const cirrus::ObjectID first = 5000;
+    const int num_objects = 100;
+    const int value = 1000;
+
+    cirrus::MemoryStats before = client->memory_stats_async().getMemoryStats();
+    if (!before.supported) {
+        std::cout << "The backend does not track its memory" << std::endl;
+        return;
+    }
+
+    for (int i = 0; i < num_objects; ++i) {
+        store.put(first + i, value);
+    }
+    cirrus::MemoryStats after = client->memory_stats_async().getMemoryStats();
+    std::cout << "Bytes used: " << after.bytes_used
+        << " requested: " << after.bytes_requested
+        << " fragmentation: " << after.fragmentation << std::endl;
+    if (after.bytes_requested < before.bytes_requested +
+            num_objects * serializer.size(value)) {
+        throw std::runtime_error("Objects written not accounted for");
+    }
+    if (after.bytes_used < after.bytes_requested) {
+        throw std::runtime_error("More bytes requested than used");
+    }
+    if (after.fragmentation < 0 || after.fragmentation >= 1) {
+        throw std::runtime_error("Fragmentation out of range");
+    }
+    store.removeBulk(first, first + num_objects - 1);
+}
+
+/**
+ * Tests that objects written with a TTL are removed once it passes, and
+ * that writing them again without a TTL keeps them.
+ */
+void test_ttl() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<int> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT, client.get(),
+            serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+
+    // The TTLs leave room for a slow server both ways
+    store.put(300, 1, 2000);
+    store.put(301, 2, 2000);
+    store.put(302, 3, 2000);
+    store.put(302, 4);
+    if (store.get(300) != 1) {
+        throw std::runtime_error("Object removed before its TTL");
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(4000));
+    std::vector<cirrus::ObjectID> oids = {300, 301, 302};
+    std::vector<bool> found;
+    std::vector<int> values = store.get_bulk_fast(oids, &found);
+    if (found[0] || found[1]) {
+        throw std::runtime_error("Object not removed after its TTL");
+    }
+    if (!found[2] || values[2] != 4) {
+        throw std::runtime_error("Object written again without TTL removed");
+    }
+}
+
 /**
  * This test ensures that error messages that would normally be generated
  * during a get are still received during a get bulk.
@@ -456,6 +779,30 @@ auto main(int argc, char *argv[]) -> int {
     }
     std::cout << "test remove bulk" << std::endl;
     test_remove_bulk();
+    // The RDMA client removes ranges one object at a time
+    if (!use_rdma_client) {
+        test_remove_bulk_sparse();
+    }
+    // Partial reads and writes are only implemented over TCP
+    if (!use_rdma_client) {
+        std::cout << "test partial" << std::endl;
+        test_partial();
+    }
+    // The RDMA client keeps no versions and has no atomic operations
+    if (!use_rdma_client) {
+        std::cout << "test if newer" << std::endl;
+        test_if_newer();
+        std::cout << "test watch" << std::endl;
+        test_watch();
+        std::cout << "test atomics" << std::endl;
+        test_atomics();
+        std::cout << "test accumulate" << std::endl;
+        test_accumulate();
+        std::cout << "test ttl" << std::endl;
+        test_ttl();
+        std::cout << "test memory stats" << std::endl;
+        test_memory_stats();
+    }
     std::cout << "test shared client" << std::endl;
     test_shared_client();
     std::cout << "test variable sizes" << std::endl;
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "tests/object_store/object_store_internal.h"
+#include "common/Exception.h"
+#include "client/BladeClient.h"
+
+// TODO(Tyler): Remove hardcoded IP and PORT
+const char PORT[] = "12345";
+const char *IP;
+bool use_rdma_client;
+
+/**
+ * Writes a vector of doubles under an id that does not exist, by adding
+ * it to zeros.
+ */
+void put_doubles(cirrus::BladeClient* client, cirrus::ObjectID oid,
+        const std::vector<double>& values) {
+    client->accumulate_async(oid, values, 1).get();
+}
+
+/**
+ * Tests that functions run on the objects of a range that exist, and that
+ * only their result comes back.
+ * Assumes the server loaded the plugin of test_plugin.cpp.
+ */
+void test_call() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    client->connect(IP, PORT);
+
+    client->remove_range(0, 100);
+    put_doubles(client.get(), 10, {1, 2, 3});
+    put_doubles(client.get(), 12, {4});
+    put_doubles(client.get(), 20, {100});
+
+    std::string result = client->call_sync("ids", 10, 19, "");
+    std::vector<cirrus::ObjectID> oids(result.size() / sizeof(uint64_t));
+    std::memcpy(oids.data(), result.data(), result.size());
+    if (oids != std::vector<cirrus::ObjectID>{10, 12}) {
+        throw std::runtime_error("Function got the wrong objects");
+    }
+
+    double scale = 0.5;
+    result = client->call_sync("sum", 10, 19,
+            std::string(reinterpret_cast<const char*>(&scale),
+                sizeof(scale)));
+    double sum;
+    if (result.size() != sizeof(sum)) {
+        throw std::runtime_error("Wrong size of the result");
+    }
+    std::memcpy(&sum, result.data(), sizeof(sum));
+    if (sum != 5) {
+        throw std::runtime_error("Wrong result");
+    }
+
+    // A single object
+    result = client->call_sync("sum", 20, 20, "");
+    std::memcpy(&sum, result.data(), sizeof(sum));
+    if (sum != 100) {
+        throw std::runtime_error("Wrong result of a single object");
+    }
+
+    // Every id, only the objects stored are passed to the function
+    result = client->call_sync("ids", 0,
+            std::numeric_limits<cirrus::ObjectID>::max(), "");
+    oids.resize(result.size() / sizeof(uint64_t));
+    std::memcpy(oids.data(), result.data(), result.size());
+    if (oids != std::vector<cirrus::ObjectID>{10, 12, 20}) {
+        throw std::runtime_error("Function got the wrong objects of every id");
+    }
+}
+
+/**
+ * Tests that calls to functions that do not exist or fail throw.
+ */
+void test_call_errors() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    client->connect(IP, PORT);
+
+    try {
+        client->call_sync("missing", 0, 10, "");
+        throw std::runtime_error("Missing function did not throw");
+    } catch (const cirrus::NoSuchFunctionException& e) {
+    }
+
+    try {
+        client->call_sync("fail", 0, 10, "");
+        throw std::runtime_error("Failed function did not throw");
+    } catch (const cirrus::NoSuchFunctionException& e) {
+        throw std::runtime_error("Failed function reported as missing");
+    } catch (const cirrus::Exception& e) {
+    }
+
+    try {
+        client->call_sync("sum", 10, 0, "");
+        throw std::runtime_error("Inverted range did not throw");
+    } catch (const cirrus::OutOfRangeException& e) {
+    }
+}
+
+auto main(int argc, char *argv[]) -> int {
+    std::cout << "Running functions test" << std::endl;
+
+    use_rdma_client = cirrus::test_internal::ParseMode(argc, argv);
+    IP = cirrus::test_internal::ParseIP(argc, argv);
+    test_call();
+    test_call_errors();
+    std::cout << "Test successful" << std::endl;
+    return 0;
+}
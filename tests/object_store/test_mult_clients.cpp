@@ -1,12 +1,15 @@
 #include <stdlib.h>
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <cctype>
 #include <thread>
 #include <memory>
 #include <random>
 #include <atomic>
+#include <mutex>
+#include <vector>
 
 #include "object_store/FullBladeObjectStore.h"
 #include "tests/object_store/object_store_internal.h"
@@ -77,10 +80,80 @@ void test_multiple_clients() {
     std::cout << "Test successful" << std::endl;
 }
 
+/**
+ * Checks that updates of the same objects by multiple clients at once are
+ * not lost: every fetch add of a counter sees a different value, and
+ * objects written by every client are read back whole. With several
+ * reactor threads the requests run on the server at the same time.
+ */
+void test_concurrent_updates() {
+    std::cout << "Concurrent updates test" << std::endl;
+
+    const int num_adds = 200;
+    const cirrus::ObjectID counter = 1000;
+    const cirrus::ObjectID shared_first = 1001;
+    const cirrus::ObjectID shared_last = 1010;
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    client->connect(IP, PORT);
+    client->remove(counter);
+
+    std::mutex seen_lock;
+    std::vector<uint64_t> seen;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < N_THREADS; ++i) {
+        threads.emplace_back([i, &seen_lock, &seen]() {
+            std::unique_ptr<cirrus::BladeClient> client =
+                cirrus::test_internal::GetClient(use_rdma_client);
+            cirrus::serializer_simple<cirrus::Dummy<SIZE>> serializer;
+            cirrus::ostore::FullBladeObjectStoreTempl<cirrus::Dummy<SIZE>>
+                store(IP, PORT, client.get(),
+                      serializer,
+                      cirrus::deserializer_simple<cirrus::Dummy<SIZE>,
+                          sizeof(cirrus::Dummy<SIZE>)>);
+            cirrus::Dummy<SIZE> mine(i);
+            std::memset(mine.data, i, SIZE);
+            std::vector<uint64_t> previous;
+            for (int j = 0; j < num_adds; ++j) {
+                previous.push_back(client->fetch_add(counter, 1));
+
+                // Every client writes the same objects
+                cirrus::ObjectID oid = shared_first +
+                    j % (shared_last - shared_first + 1);
+                store.put(oid, mine);
+                cirrus::Dummy<SIZE> d = store.get(oid);
+                if (d.id < 0 || d.id >= N_THREADS || d.data[0] != d.id ||
+                    d.data[SIZE - 1] != d.id) {
+                    throw std::runtime_error("Torn object returned.");
+                }
+            }
+            std::lock_guard<std::mutex> guard(seen_lock);
+            seen.insert(seen.end(), previous.begin(), previous.end());
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::sort(seen.begin(), seen.end());
+    for (uint64_t i = 0; i < seen.size(); ++i) {
+        if (seen[i] != i) {
+            throw std::runtime_error("Concurrent fetch adds were lost.");
+        }
+    }
+    if (client->fetch_add(counter, 0) != seen.size()) {
+        throw std::runtime_error("Wrong counter value.");
+    }
+    std::cout << "Test successful" << std::endl;
+}
+
 auto main(int argc, char *argv[]) -> int {
     use_rdma_client = cirrus::test_internal::ParseMode(argc, argv);
     IP = cirrus::test_internal::ParseIP(argc, argv);
     test_multiple_clients();
+    if (!use_rdma_client) {
+        test_concurrent_updates();
+    }
 
     return 0;
 }
@@ -0,0 +1,68 @@
+#include <cstring>
+#include <string>
+#include "server/NearDataFunction.h"
+
+/**
+ * Plugin of the server loaded by test_functions.
+ */
+
+/**
+ * Sums the doubles of every object, multiplied by the double given as
+ * argument, if any. The result is a double.
+ */
+static bool sum(const cirrus::NearDataObject* objects, uint64_t num_objects,
+        const char* args, uint64_t args_size, std::string* result) {
+    double scale = 1;
+    if (args_size == sizeof(scale)) {
+        std::memcpy(&scale, args, sizeof(scale));
+    } else if (args_size != 0) {
+        return false;
+    }
+
+    double total = 0;
+    for (uint64_t i = 0; i < num_objects; ++i) {
+        for (uint64_t j = 0; j + sizeof(double) <= objects[i].size;
+                j += sizeof(double)) {
+            double value;
+            std::memcpy(&value, objects[i].data + j, sizeof(value));
+            total += value;
+        }
+    }
+    total *= scale;
+    result->assign(reinterpret_cast<const char*>(&total), sizeof(total));
+    return true;
+}
+
+/**
+ * Returns the ids of the objects, to check which objects a function gets.
+ */
+static bool ids(const cirrus::NearDataObject* objects, uint64_t num_objects,
+        const char* /* args */, uint64_t /* args_size */,
+        std::string* result) {
+    for (uint64_t i = 0; i < num_objects; ++i) {
+        result->append(reinterpret_cast<const char*>(&objects[i].oid),
+                sizeof(objects[i].oid));
+    }
+    return true;
+}
+
+/**
+ * Always fails.
+ */
+static bool fail(const cirrus::NearDataObject* /* objects */,
+        uint64_t /* num_objects */, const char* /* args */,
+        uint64_t /* args_size */, std::string* /* result */) {
+    return false;
+}
+
+static const cirrus::NearDataFunctionEntry functions[] = {
+    {"sum", sum},
+    {"ids", ids},
+    {"fail", fail},
+};
+
+extern "C" const cirrus::NearDataFunctionEntry* cirrus_near_data_functions(
+        uint64_t* count) {
+    *count = sizeof(functions) / sizeof(functions[0]);
+    return functions;
+}
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <chrono>
+
+#include "object_store/FullBladeObjectStore.h"
+#include "tests/object_store/object_store_internal.h"
+#include "common/Exception.h"
+#include "client/BladeClient.h"
+
+// TODO(Tyler): Remove hardcoded IP and PORT
+const char PORT[] = "12345";
+const char *IP;
+static const uint32_t SIZE = 250 * 1024;
+bool use_rdma_client;
+
+/**
+ * Tests that an application cannot store more than its memory quota, that
+ * removing its objects gives the memory back, and that objects are
+ * charged to the application that wrote them last.
+ * Assumes the server limits application 1 to 1 MB and application 3 has
+ * no limits.
+ */
+void test_memory_quota() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<cirrus::Dummy<SIZE>> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<cirrus::Dummy<SIZE>>
+        store(IP, PORT, client.get(),
+                serializer,
+                cirrus::deserializer_simple<cirrus::Dummy<SIZE>,
+                    sizeof(cirrus::Dummy<SIZE>)>);
+    client->authenticate_async(1, "key1").get();
+    store.removeBulk(0, 10);
+    struct cirrus::Dummy<SIZE> d(42);
+
+    // Four objects fit in 1 MB
+    for (cirrus::ObjectID oid = 0; oid < 4; ++oid) {
+        store.put(oid, d);
+    }
+    try {
+        store.put(4, d);
+        throw std::runtime_error("Put over the memory quota did not throw");
+    } catch (const cirrus::QuotaExceededException& e) {
+    }
+    // Objects replaced do not count twice
+    store.put(0, d);
+    store.remove(1);
+    store.put(4, d);
+
+    // Once another application writes an object it is charged for it
+    std::unique_ptr<cirrus::BladeClient> other_client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::ostore::FullBladeObjectStoreTempl<cirrus::Dummy<SIZE>>
+        other_store(IP, PORT, other_client.get(),
+                serializer,
+                cirrus::deserializer_simple<cirrus::Dummy<SIZE>,
+                    sizeof(cirrus::Dummy<SIZE>)>);
+    other_client->authenticate_async(3, "key3").get();
+    other_store.put(0, d);
+    store.put(5, d);
+    for (cirrus::ObjectID oid = 6; oid < 10; ++oid) {
+        other_store.put(oid, d);
+    }
+}
+
+/**
+ * Tests that requests over the rate of an application are rejected until
+ * the rate allows them again, without affecting other applications.
+ * Assumes the server limits application 2 to 20 requests per second.
+ */
+void test_rate_limit() {
+    const int num_requests = 100;
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<int> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT, client.get(),
+            serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+    client->authenticate_async(2, "key2").get();
+
+    int rejected = 0;
+    for (int i = 0; i < num_requests; ++i) {
+        try {
+            store.put(100, i);
+        } catch (const cirrus::RateLimitedException& e) {
+            rejected++;
+        }
+    }
+    std::cout << rejected << " requests rejected" << std::endl;
+    if (rejected == 0 || rejected == num_requests) {
+        throw std::runtime_error("Requests not limited to the rate");
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    store.put(100, 1);
+
+    // Clients that do not authenticate have no limits
+    std::unique_ptr<cirrus::BladeClient> other_client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::ostore::FullBladeObjectStoreTempl<int> other_store(IP, PORT,
+            other_client.get(), serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+    for (int i = 0; i < num_requests; ++i) {
+        other_store.put(101, i);
+    }
+}
+
+/**
+ * Tests that clients cannot act as an application without its key, and
+ * that a client whose key is not accepted stays in application 0.
+ * Assumes the server limits application 2 to 20 requests per second and
+ * application 4 is not registered.
+ */
+void test_authentication() {
+    const int num_requests = 100;
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<int> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT, client.get(),
+            serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+
+    try {
+        client->authenticate_async(2, "key1").get();
+        throw std::runtime_error("Wrong key accepted");
+    } catch (const cirrus::AuthenticationException& e) {
+    }
+    try {
+        client->authenticate_async(4, "key4").get();
+        throw std::runtime_error("Application not registered accepted");
+    } catch (const cirrus::AuthenticationException& e) {
+    }
+    client->authenticate_async(0, "").get();
+
+    // The rate of application 2 does not apply
+    for (int i = 0; i < num_requests; ++i) {
+        store.put(102, i);
+    }
+}
+
+auto main(int argc, char *argv[]) -> int {
+    std::cout << "Running quota test" << std::endl;
+
+    use_rdma_client = cirrus::test_internal::ParseMode(argc, argv);
+    IP = cirrus::test_internal::ParseIP(argc, argv);
+    test_memory_quota();
+    test_rate_limit();
+    test_authentication();
+    std::cout << "Test successful" << std::endl;
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <cstring>
+#include <string>
+
+#include "object_store/FullBladeObjectStore.h"
+#include "tests/object_store/object_store_internal.h"
+#include "common/Exception.h"
+#include "client/BladeClient.h"
+
+// TODO(Tyler): Remove hardcoded IP and PORT
+const char PORT[] = "12345";
+const char *IP;
+bool use_rdma_client;
+
+static const cirrus::ObjectID num_objects = 100;
+/** Written last, so that its log record is the one the runner damages. */
+static const cirrus::ObjectID last_oid = 1000;
+
+/**
+ * Writes the objects checked by check_objects(), then last_oid.
+ */
+void write_objects(cirrus::ostore::FullBladeObjectStoreTempl<int>* store) {
+    for (cirrus::ObjectID oid = 0; oid < num_objects; ++oid) {
+        store->put(oid, oid * 3);
+    }
+    store->removeBulk(10, 19);
+    store->put(5, 1000);
+    store->put(last_oid, 42);
+}
+
+/**
+ * Checks the objects written by write_objects() came back after the
+ * restart, then writes last_oid again for the next restart.
+ * @param damaged whether the log record of last_oid was damaged, so that
+ * last_oid must not come back
+ */
+void check_objects(cirrus::ostore::FullBladeObjectStoreTempl<int>* store,
+        bool damaged) {
+    for (cirrus::ObjectID oid = 0; oid < num_objects; ++oid) {
+        bool removed = oid >= 10 && oid <= 19;
+        int expected = oid == 5 ? 1000 : oid * 3;
+        try {
+            if (store->get(oid) != expected || removed) {
+                throw std::runtime_error("Wrong object after restart");
+            }
+        } catch (const cirrus::NoSuchIDException& e) {
+            if (!removed) {
+                throw std::runtime_error("Object lost after restart");
+            }
+        }
+    }
+    bool found = true;
+    try {
+        store->get(last_oid);
+    } catch (const cirrus::NoSuchIDException& e) {
+        found = false;
+    }
+    if (found == damaged) {
+        throw std::runtime_error(damaged ? "Damaged record replayed" :
+                "Last object lost after restart");
+    }
+    store->put(last_oid, 42);
+}
+
+/**
+ * Tests that the objects of a server come back after it restarts.
+ * Run with "write" before the first start and with "check" after every
+ * restart, or "check_damaged" if the last log record written before the
+ * restart was cut or corrupted, so that it must not be replayed.
+ */
+auto main(int argc, char *argv[]) -> int {
+    std::cout << "Running restart test" << std::endl;
+
+    use_rdma_client = cirrus::test_internal::ParseMode(argc, argv);
+    IP = cirrus::test_internal::ParseIP(argc, argv);
+    if (argc < 4) {
+        throw std::runtime_error("Usage: ./test_restart <--tcp | --rdma> "
+                "<ip> <write | check | check_damaged>");
+    }
+
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<int> serializer;
+    cirrus::ostore::FullBladeObjectStoreTempl<int> store(IP, PORT,
+            client.get(), serializer,
+            cirrus::deserializer_simple<int, sizeof(int)>);
+    if (strcmp(argv[3], "write") == 0) {
+        write_objects(&store);
+    } else {
+        check_objects(&store, strcmp(argv[3], "check_damaged") == 0);
+    }
+    std::cout << "Test successful" << std::endl;
+    return 0;
+}
@@ -123,12 +123,62 @@ void test_write_bulk() {
     delete[] mem;
 }
 
+/**
+  * Tests that partial bulk reads return the objects that exist and report
+  * the ones that do not, instead of failing.
+  */
+void test_partial_bulk() {
+    std::unique_ptr<cirrus::BladeClient> client =
+        cirrus::test_internal::GetClient(use_rdma_client);
+    cirrus::serializer_simple<cirrus::ObjectID> serializer;
+
+    cirrus::ostore::FullBladeObjectStoreTempl<cirrus::ObjectID> store(
+            IP, PORT,
+            client.get(),
+            serializer,
+            cirrus::deserializer_simple<cirrus::ObjectID,
+                                        sizeof(cirrus::ObjectID)>);
+
+    // Only the even ids of the range are written
+    const cirrus::ObjectID first = 1000;
+    std::vector<cirrus::ObjectID> ids;
+    std::vector<cirrus::ObjectID> even_ids;
+    for (cirrus::ObjectID oid = first; oid < first + 10; oid++) {
+        ids.push_back(oid);
+        if (oid % 2 == 0) {
+            even_ids.push_back(oid);
+        }
+    }
+    store.removeBulk(first, first + 9);
+
+    std::vector<bool> stored;
+    store.put_bulk_fast(even_ids, even_ids, &stored);
+    if (stored != std::vector<bool>(even_ids.size(), true)) {
+        throw std::runtime_error("Objects not stored with put_bulk_fast");
+    }
+
+    std::vector<bool> found;
+    auto data = store.get_bulk_fast(ids, &found);
+    if (found.size() != ids.size() || data.size() != ids.size()) {
+        throw std::runtime_error("Wrong number of objects with get_bulk_fast");
+    }
+    for (uint64_t i = 0; i < ids.size(); ++i) {
+        if (found[i] != (ids[i] % 2 == 0)) {
+            throw std::runtime_error("Wrong status with get_bulk_fast");
+        }
+        if (found[i] && data[i] != ids[i]) {
+            throw std::runtime_error("Wrong data received with get_bulk_fast");
+        }
+    }
+}
+
 auto main(int argc, char *argv[]) -> int {
     use_rdma_client = cirrus::test_internal::ParseMode(argc, argv);
     IP = cirrus::test_internal::ParseIP(argc, argv);
     std::cout << "Test starting" << std::endl;
     test_read_bulk();
     test_write_bulk();
+    test_partial_bulk();
     std::cout << "Test successful" << std::endl;
     return 0;
 }
@@ -0,0 +1,13 @@
+#!/usr/bin/env python3
+
+import sys
+import subprocess
+import time
+import test_runner
+
+# Set name of test to run
+testPath = "./tests/object_store/test_functions"
+# Plugin whose functions the test calls
+pluginPath = "./tests/object_store/libtest_plugin.so"
+# Call script to run the test
+test_runner.runPluginTCP(testPath, pluginPath)
@@ -0,0 +1,15 @@
+#!/usr/bin/env python3
+
+import sys
+import subprocess
+import time
+import test_runner
+
+# Set name of test to run
+testPath = "./tests/object_store/test_quota"
+# Application 1 may store 1 MB, application 2 send 20 requests per second
+quotas = ["1:1:0:0", "2:0:20:0"]
+# Clients act as applications 1 to 3 with these keys
+app_keys = ["1:key1", "2:key2", "3:key3"]
+# Call script to run the test
+test_runner.runQuotaTCP(testPath, quotas, app_keys)
@@ -26,9 +26,10 @@ def get_test_ip():
 
 # A function that will launch a test of a given name and return its exit
 # status. Will automatically start and kill the server before and after
-# the test.
+# the test. num_threads sets the number of reactor threads of the server.
+# backend sets the backend of the server when storage is not used.
 # NOTE: all pathnames start from the top directory where make check is run
-def runTestTCP(testPath):
+def runTestTCP(testPath, num_threads = 1, backend = "Memory"):
 
     # Launch the server in the background
     print("Running test", testPath)
@@ -40,7 +41,14 @@ def runTestTCP(testPath):
         remove_nonvolatile_storage(storage_path);
         server = subprocess.Popen(
                 ["./src/server/tcpservermain", str(half_gig),
-                 "Storage", storage_path])
+                 "Storage", storage_path, str(num_threads)])
+    elif num_threads > 1 or backend != "Memory":
+        print("Using", backend, "backend with", num_threads, "threads")
+        if backend in ("Log", "Tiered"):
+            remove_nonvolatile_storage(storage_path);
+        server = subprocess.Popen(
+                ["./src/server/tcpservermain", str(20 * half_gig),
+                 backend, storage_path, str(num_threads)])
     else:
         print("Using memory backend")
         server = subprocess.Popen(["./src/server/tcpservermain"])
@@ -61,7 +69,7 @@ def runTestTCP(testPath):
     rc = child.returncode
 
     server.kill()
-    if use_storage():
+    if use_storage() or backend in ("Log", "Tiered"):
         remove_nonvolatile_storage(storage_path);
     sys.exit(rc)
 
@@ -92,19 +100,49 @@ def runTestRDMA(testPath):
     server.kill()
     sys.exit(rc)
 
-def runExhaustionTCP(testPath):
+# The options are given to both the server and the test, e.g. to run the
+# server as a cache
+def runExhaustionTCP(testPath, options = []):
     # Launch the server in the background
     print("Running test", testPath)
     # Sleep to give the server from the previous test time to close
     time.sleep(1)
     
     limit_size = 20
-    server = subprocess.Popen(["./src/server/tcpservermain", str(limit_size)])
+    server = subprocess.Popen(["./src/server/tcpservermain", str(limit_size)]
+                              + options)
     # Sleep to give server time to start
     print("Started server, sleeping.")
     time.sleep(2)
     print("Sleep finished, launching client.")
 
+    child = subprocess.Popen([testPath, "--tcp", get_test_ip()] + options,
+                             stdout=subprocess.PIPE)
+
+    # Print the output from the child
+    for line in child.stdout:
+        print(line.decode(), end='')
+
+    streamdata = child.communicate()[0]
+    rc = child.returncode
+
+    server.kill()
+    sys.exit(rc)
+
+# Same as runTestTCP, but the server loads the functions of a plugin
+def runPluginTCP(testPath, pluginPath):
+    # Launch the server in the background
+    print("Running test", testPath)
+    # Sleep to give the server from the previous test time to close
+    time.sleep(1)
+
+    server = subprocess.Popen(["./src/server/tcpservermain",
+                               "--plugin=" + pluginPath])
+    # Sleep to give server time to start
+    print("Started server, sleeping.")
+    time.sleep(3)
+    print("Sleep finished, launching client.")
+
     child = subprocess.Popen([testPath, "--tcp", get_test_ip()],
                              stdout=subprocess.PIPE)
 
@@ -118,6 +156,100 @@ def runExhaustionTCP(testPath):
     server.kill()
     sys.exit(rc)
 
+# Same as runTestTCP, but the server enforces the quotas of applications,
+# each one given as app_id:MB:requests_per_second:MB_per_second. Clients
+# authenticate with the keys of the applications, given as app_id:key
+def runQuotaTCP(testPath, quotas, app_keys):
+    # Launch the server in the background
+    print("Running test", testPath)
+    # Sleep to give the server from the previous test time to close
+    time.sleep(1)
+
+    server = subprocess.Popen(["./src/server/tcpservermain"] +
+                              ["--quota=" + quota for quota in quotas] +
+                              ["--app_key=" + key for key in app_keys])
+    # Sleep to give server time to start
+    print("Started server, sleeping.")
+    time.sleep(3)
+    print("Sleep finished, launching client.")
+
+    child = subprocess.Popen([testPath, "--tcp", get_test_ip()],
+                             stdout=subprocess.PIPE)
+
+    # Print the output from the child
+    for line in child.stdout:
+        print(line.decode(), end='')
+
+    streamdata = child.communicate()[0]
+    rc = child.returncode
+
+    server.kill()
+    sys.exit(rc)
+
+# Cuts or corrupts the last record of the newest write-ahead log file
+def damage_last_log(damage):
+    logs = [name for name in os.listdir(storage_path)
+            if name.startswith("memory.wal.")]
+    newest = max(logs, key = lambda name: int(name.split(".")[-1]))
+    path = os.path.join(storage_path, newest)
+    size = os.path.getsize(path)
+    print("Damaging", path, "with", damage)
+    with open(path, "r+b") as log:
+        if damage == "truncate":
+            log.truncate(size - 1)
+        else:
+            log.seek(size - 1)
+            last = log.read(1)
+            log.seek(size - 1)
+            log.write(bytes([last[0] ^ 0xff]))
+
+# Runs a test across restarts of the server, which recovers its objects
+# with the given options. The test is run with "write" before the first
+# restart and with "check" after each one. Before each restart the last
+# record of the write-ahead log is damaged as given in damages, and the
+# test is then run with "check_damaged". None in damages means no damage.
+# The server is given settle_time seconds after each run, e.g. to take a
+# snapshot.
+def runRestartTCP(testPath, options, damages, settle_time = 0):
+    print("Running test", testPath)
+    # Sleep to give the server from the previous test time to close
+    time.sleep(1)
+    remove_nonvolatile_storage(storage_path)
+    os.makedirs(storage_path)
+
+    rc = 0
+    for phase, damage in [("write", None)] + [("check", d) for d in damages]:
+        if damage:
+            damage_last_log(damage)
+            phase = "check_damaged"
+        server = subprocess.Popen(["./src/server/tcpservermain",
+                                   str(half_gig), "Memory", storage_path] +
+                                  options)
+        # Sleep to give server time to start
+        print("Started server, sleeping.")
+        time.sleep(3)
+        print("Sleep finished, launching client for", phase)
+
+        child = subprocess.Popen([testPath, "--tcp", get_test_ip(), phase],
+                                 stdout=subprocess.PIPE)
+
+        # Print the output from the child
+        for line in child.stdout:
+            print(line.decode(), end = '')
+
+        streamdata = child.communicate()[0]
+        rc = child.returncode
+
+        # The server is killed without a chance to clean up, as in a crash
+        time.sleep(settle_time)
+        server.kill()
+        server.wait()
+        if rc != 0:
+            break
+
+    remove_nonvolatile_storage(storage_path)
+    sys.exit(rc)
+
 def runExhaustionRDMA(testPath):
     # Launch the server in the background
     print("Starting server.")
@@ -0,0 +1,13 @@
+#!/usr/bin/env python3
+
+import sys
+import subprocess
+import time
+import test_runner
+
+# Set name of test to run
+testPath = "./tests/object_store/test_restart"
+# The server reloads its objects from the snapshot taken every second,
+# which is given 3 seconds to be taken before each restart
+test_runner.runRestartTCP(testPath, ["--snapshot_interval=1"],
+                          [None, None], 3)
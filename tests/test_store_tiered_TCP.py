@@ -0,0 +1,11 @@
+#!/usr/bin/env python3
+
+import sys
+import subprocess
+import time
+import test_runner
+
+# Set name of test to run
+testPath = "./tests/object_store/test_fullblade_store"
+# Call script to run the test against the Tiered backend
+test_runner.runTestTCP(testPath, 1, "Tiered")
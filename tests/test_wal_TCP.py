@@ -0,0 +1,11 @@
+#!/usr/bin/env python3
+
+import sys
+import subprocess
+import time
+import test_runner
+
+# Set name of test to run
+testPath = "./tests/object_store/test_restart"
+# The server replays its write-ahead log after a corrupted and a cut record
+test_runner.runRestartTCP(testPath, ["--wal=1"], ["corrupt", "truncate"])